@@ -0,0 +1,135 @@
+//
+// # Common
+//
+// Helpers shared by the native baselines, mirroring `bench/stats.js` so both report the same numbers the same way.
+//
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zmq.h>
+
+typedef struct {
+  const char *role;
+  const char *pattern;
+  const char *endpoint;
+  size_t size;
+  int frames;
+  int count;
+} config_t;
+
+typedef struct {
+  double *values;
+  int length;
+  int capacity;
+} samples_t;
+
+// Returns the current monotonic time in nanoseconds, from the same clock as `process.hrtime`.
+static uint64_t now(void) {
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Writes the current time into the first 8 bytes of `data`, in the same format as `stats.stamp`.
+static void stamp(unsigned char *data) {
+  uint64_t time = now();
+  uint32_t seconds = (uint32_t)(time / 1000000000);
+  uint32_t nanoseconds = (uint32_t)(time % 1000000000);
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    data[i] = (unsigned char)(seconds >> (24 - i * 8));
+    data[4 + i] = (unsigned char)(nanoseconds >> (24 - i * 8));
+  }
+}
+
+// Returns the nanoseconds since `data` was stamped.
+static double elapsed(const unsigned char *data) {
+  uint32_t seconds = 0;
+  uint32_t nanoseconds = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    seconds = (seconds << 8) | data[i];
+    nanoseconds = (nanoseconds << 8) | data[4 + i];
+  }
+
+  return (double)now() - ((double)seconds * 1e9 + nanoseconds);
+}
+
+static void parse_args(int argc, char *argv[], config_t *config) {
+  if (argc != 7) {
+    fprintf(stderr, "Usage: %s ROLE PATTERN ENDPOINT SIZE FRAMES COUNT\n", argv[0]);
+    exit(1);
+  }
+
+  config->role = argv[1];
+  config->pattern = argv[2];
+  config->endpoint = argv[3];
+  config->size = (size_t)atoi(argv[4]);
+  config->frames = atoi(argv[5]);
+  config->count = atoi(argv[6]);
+}
+
+static void samples_init(samples_t *samples, int capacity) {
+  samples->values = malloc(sizeof(double) * (capacity > 0 ? capacity : 1));
+  samples->length = 0;
+  samples->capacity = capacity;
+}
+
+static void samples_add(samples_t *samples, double value) {
+  if (samples->length < samples->capacity) {
+    samples->values[samples->length++] = value;
+  }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Returns the `p`th percentile in microseconds, rounded like `stats.summarize`. The samples must be sorted.
+static double percentile(samples_t *samples, double p) {
+  int index = (int)(samples->length * p);
+
+  if (index > samples->length - 1) {
+    index = samples->length - 1;
+  }
+
+  return (double)(int64_t)(samples->values[index] / 10 + 0.5) / 100;
+}
+
+// Prints a result line in the same schema as the Node benchmarks.
+static void print_result(const char *bench, config_t *config, int received, double seconds, samples_t *samples) {
+  printf("{\"bench\":\"%s\",\"pattern\":\"%s\",\"transport\":\"%.*s\",\"size\":%lu,\"frames\":%d,\"count\":%d,"
+         "\"received\":%d,\"seconds\":%f,\"msgsPerSec\":%.0f,\"mbPerSec\":%.2f,\"latency\":",
+         bench, config->pattern, (int)(strstr(config->endpoint, "://") - config->endpoint), config->endpoint,
+         (unsigned long)config->size, config->frames, config->count, received, seconds, received / seconds,
+         (double)received * config->size * config->frames / seconds / 1e6);
+
+  if (samples->length == 0) {
+    printf("null}\n");
+  } else {
+    qsort(samples->values, samples->length, sizeof(double), compare_doubles);
+    printf("{\"samples\":%d,\"p50\":%.2f,\"p99\":%.2f,\"p999\":%.2f,\"max\":%.2f}}\n", samples->length,
+           percentile(samples, 0.5), percentile(samples, 0.99), percentile(samples, 0.999), percentile(samples, 1));
+  }
+
+  fflush(stdout);
+}
+
+static void print_ready(void) {
+  printf("{\"ready\":true}\n");
+  fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,101 @@
+//
+// # Latency
+//
+// The native counterpart to `bench/latency.js`, using libzmq directly.
+//
+//     ./lat ROLE PATTERN ENDPOINT SIZE FRAMES COUNT
+//
+#include <pthread.h>
+
+#include "common.h"
+
+static void *context;
+static config_t config;
+
+static void *server(void *arg) {
+  void *socket = arg;
+  zmq_msg_t msg;
+
+  zmq_msg_init(&msg);
+
+  // Runs until the context is terminated (or the process is killed).
+  while (zmq_msg_recv(&msg, socket, 0) != -1) {
+    if (zmq_msg_send(&msg, socket, zmq_msg_more(&msg) ? ZMQ_SNDMORE : 0) == -1) {
+      break;
+    }
+  }
+
+  zmq_msg_close(&msg);
+
+  return NULL;
+}
+
+static void client(void *socket) {
+  samples_t samples;
+  zmq_msg_t msg;
+  unsigned char *data = calloc(config.size > 0 ? config.size : 1, 1);
+  uint64_t start;
+  uint64_t sent;
+  int i;
+  int j;
+
+  samples_init(&samples, config.count);
+  zmq_connect(socket, config.endpoint);
+  start = now();
+
+  for (i = 0; i < config.count; i++) {
+    sent = now();
+
+    for (j = 0; j < config.frames; j++) {
+      zmq_msg_init_size(&msg, config.size);
+      memcpy(zmq_msg_data(&msg), data, config.size);
+      zmq_msg_send(&msg, socket, j < config.frames - 1 ? ZMQ_SNDMORE : 0);
+    }
+
+    zmq_msg_init(&msg);
+
+    do {
+      zmq_msg_recv(&msg, socket, 0);
+    } while (zmq_msg_more(&msg));
+
+    zmq_msg_close(&msg);
+    samples_add(&samples, (double)(now() - sent));
+  }
+
+  print_result("latency", &config, config.count, (now() - start) / 1e9, &samples);
+  free(data);
+}
+
+int main(int argc, char *argv[]) {
+  int dealer = 0;
+  void *in = NULL;
+  void *out = NULL;
+  pthread_t thread;
+
+  parse_args(argc, argv, &config);
+  context = zmq_ctx_new();
+  dealer = strcmp(config.pattern, "dealer-router") == 0;
+
+  if (strcmp(config.role, "sender") != 0) {
+    in = zmq_socket(context, dealer ? ZMQ_ROUTER : ZMQ_REP);
+    zmq_bind(in, config.endpoint);
+  }
+
+  if (strcmp(config.role, "receiver") != 0) {
+    out = zmq_socket(context, dealer ? ZMQ_DEALER : ZMQ_REQ);
+  }
+
+  if (strcmp(config.role, "both") == 0) {
+    pthread_create(&thread, NULL, server, in);
+    client(out);
+    // The server thread is still blocked in zmq_msg_recv, and goes down with the process.
+    return 0;
+  } else if (in) {
+    print_ready();
+    server(in);
+  } else {
+    client(out);
+  }
+
+  return 0;
+}
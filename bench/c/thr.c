@@ -0,0 +1,148 @@
+//
+// # Throughput
+//
+// The native counterpart to `bench/throughput.js`, using libzmq directly.
+//
+//     ./thr ROLE PATTERN ENDPOINT SIZE FRAMES COUNT
+//
+#include <pthread.h>
+
+#include "common.h"
+
+// PUB/SUB drops messages rather than pushing back, so the receiver gives up once messages stop arriving.
+#define IDLE_TIMEOUT 1000
+
+static void *context;
+static config_t config;
+
+static void *receiver(void *arg) {
+  void *socket = arg;
+  samples_t samples;
+  zmq_msg_t msg;
+  int received = 0;
+  uint64_t start = 0;
+  uint64_t last = 0;
+  zmq_pollitem_t items[] = { { socket, 0, ZMQ_POLLIN, 0 } };
+
+  samples_init(&samples, config.count);
+  zmq_msg_init(&msg);
+
+  while (received < config.count) {
+    if (zmq_poll(items, 1, start ? IDLE_TIMEOUT : -1) == 0) {
+      break;
+    }
+
+    while (zmq_msg_recv(&msg, socket, ZMQ_DONTWAIT) != -1) {
+      if (zmq_msg_more(&msg)) {
+        continue;
+      }
+
+      if (!start) {
+        start = now();
+      }
+
+      if (zmq_msg_size(&msg) >= 8) {
+        samples_add(&samples, elapsed(zmq_msg_data(&msg)));
+      }
+
+      last = now();
+
+      if (++received >= config.count) {
+        break;
+      }
+    }
+  }
+
+  zmq_msg_close(&msg);
+  print_result("throughput", &config, received, (last - start) / 1e9, &samples);
+
+  return NULL;
+}
+
+static void *sender(void *arg) {
+  void *socket = arg;
+  zmq_msg_t msg;
+  unsigned char *data = calloc(config.size > 8 ? config.size : 8, 1);
+  int i;
+  int j;
+
+  zmq_connect(socket, config.endpoint);
+
+  if (strcmp(config.pattern, "pub-sub") == 0) {
+    // Subscriptions take a moment to reach the publisher, and anything published before then is lost.
+    struct timespec delay = { 0, 500000000 };
+    nanosleep(&delay, NULL);
+  }
+
+  for (i = 0; i < config.count; i++) {
+    for (j = 0; j < config.frames; j++) {
+      if (j == config.frames - 1 && config.size >= 8) {
+        stamp(data);
+      }
+
+      zmq_msg_init_size(&msg, config.size);
+      memcpy(zmq_msg_data(&msg), data, config.size);
+      zmq_msg_send(&msg, socket, j < config.frames - 1 ? ZMQ_SNDMORE : 0);
+    }
+  }
+
+  free(data);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  int receiverType = ZMQ_PULL;
+  int senderType = ZMQ_PUSH;
+  void *in = NULL;
+  void *out = NULL;
+  pthread_t thread;
+
+  parse_args(argc, argv, &config);
+  context = zmq_ctx_new();
+
+  if (strcmp(config.pattern, "pub-sub") == 0) {
+    receiverType = ZMQ_SUB;
+    senderType = ZMQ_PUB;
+  } else if (strcmp(config.pattern, "dealer-router") == 0) {
+    receiverType = ZMQ_ROUTER;
+    senderType = ZMQ_DEALER;
+  }
+
+  if (strcmp(config.role, "sender") != 0) {
+    in = zmq_socket(context, receiverType);
+
+    if (receiverType == ZMQ_SUB) {
+      zmq_setsockopt(in, ZMQ_SUBSCRIBE, "", 0);
+    }
+
+    zmq_bind(in, config.endpoint);
+  }
+
+  if (strcmp(config.role, "receiver") != 0) {
+    out = zmq_socket(context, senderType);
+  }
+
+  if (strcmp(config.role, "both") == 0) {
+    pthread_create(&thread, NULL, sender, out);
+    receiver(in);
+    pthread_join(thread, NULL);
+  } else if (in) {
+    print_ready();
+    receiver(in);
+  } else {
+    sender(out);
+  }
+
+  if (in) {
+    zmq_close(in);
+  }
+
+  if (out) {
+    zmq_close(out);
+  }
+
+  zmq_ctx_destroy(context);
+
+  return 0;
+}
@@ -0,0 +1,198 @@
+//
+// # Latency
+//
+// Measures round-trip latency by bouncing one message at a time between a client and a server. Each message is
+// `frames` frames of `size` bytes; the server echoes every message back unchanged.
+//
+// Run directly, both sockets live in this process:
+//
+//     node bench/latency [PATTERN] [TRANSPORT] [SIZE] [FRAMES] [COUNT]
+//
+// When run by `bench/run`, each side is forked into its own process for the `ipc` and `tcp` transports.
+//
+var zmqstream = require('../lib/zmqstream')
+  , stats = require('./stats')
+  , configure = stats.configure
+
+var PATTERNS = {
+  'req-rep': { client: 'REQ', server: 'REP' },
+  'dealer-router': { client: 'DEALER', server: 'ROUTER' }
+}
+
+//
+// ## createSocket `createSocket(type, config)`
+//
+// Creates a Socket of **type**, with any extra `config.options` applied.
+//
+function createSocket(type, config) {
+  var options = { type: zmqstream.Type[type] }
+    , key
+
+  for (key in config.options) {
+    options[key] = config.options[key]
+  }
+
+  return new zmqstream.Socket(options)
+}
+
+//
+// ## Server `Server(config)`
+//
+// Binds to `config.endpoint`, echoing every message it receives until closed.
+//
+function Server(config) {
+  if (!(this instanceof Server)) {
+    return new Server(config)
+  }
+
+  this.socket = createSocket(PATTERNS[config.pattern].server, config)
+  this.socket.bind(config.endpoint)
+}
+
+//
+// ## start `start()`
+//
+// Starts echoing.
+//
+Server.prototype.start = function start() {
+  var self = this
+
+  function echo() {
+    var messages
+      , i
+
+    while ((messages = self.socket.read())) {
+      for (i = 0; i < messages.length; i++) {
+        self.socket.write(messages[i])
+      }
+    }
+  }
+
+  self.socket.on('readable', echo)
+  echo()
+}
+
+//
+// ## Client `Client(config)`
+//
+// Connects to `config.endpoint`, timing `config.count` round trips.
+//
+function Client(config) {
+  if (!(this instanceof Client)) {
+    return new Client(config)
+  }
+
+  var i
+
+  this.config = config
+  this.received = 0
+  this.rtt = stats.Samples(config.count)
+  this.frames = []
+
+  for (i = 0; i < config.frames; i++) {
+    this.frames.push(new Buffer(config.size))
+    this.frames[i].fill(0)
+  }
+
+  this.socket = createSocket(PATTERNS[config.pattern].client, config)
+  this.socket.connect(config.endpoint)
+}
+
+//
+// ## start `start(callback)`
+//
+// Starts the round trips, calling **callback** with the results once finished.
+//
+Client.prototype.start = function start(callback) {
+  var self = this
+    , startTime = stats.now()
+    , sentTime
+
+  function send() {
+    sentTime = stats.now()
+    self.socket.write(self.frames)
+  }
+
+  function recv() {
+    var messages
+      , seconds
+
+    while ((messages = self.socket.read())) {
+      self.rtt.add(stats.now() - sentTime)
+      self.received += messages.length
+
+      if (self.received >= self.config.count) {
+        seconds = (stats.now() - startTime) / 1e9
+        self.socket.removeAllListeners('readable')
+
+        callback({
+          bench: 'latency',
+          pattern: self.config.pattern,
+          transport: self.config.transport,
+          size: self.config.size,
+          frames: self.config.frames,
+          options: self.config.options,
+          count: self.config.count,
+          received: self.received,
+          seconds: seconds,
+          msgsPerSec: Math.round(self.received / seconds),
+          mbPerSec: Math.round(self.received * self.config.size * self.config.frames / seconds / 1e4) / 100,
+          latency: self.rtt.summarize()
+        })
+        return
+      }
+
+      send()
+    }
+  }
+
+  self.socket.on('readable', recv)
+  send()
+}
+
+//
+// ## run `run(config, callback)`
+//
+// Runs both sides in this process, calling **callback** with the results.
+//
+function run(config, callback) {
+  Server(config).start()
+  Client(config).start(callback)
+}
+
+module.exports = {
+  PATTERNS: PATTERNS,
+  Server: Server,
+  Client: Client,
+  run: run
+}
+
+//
+// ## Running
+//
+// If `latency` is forked by `bench/run`, it waits to be told which side (or both) to play. Run directly, it plays
+// both sides itself.
+//
+if (require.main === module) {
+  if (process.send) {
+    process.on('message', function (config) {
+      if (config.role === 'both') {
+        run(config, function (result) {
+          process.send({ result: result })
+        })
+      } else if (config.role === 'receiver') {
+        Server(config).start()
+        process.send({ ready: true })
+      } else {
+        Client(config).start(function (result) {
+          process.send({ result: result })
+        })
+      }
+    })
+  } else {
+    run(configure(process.argv.slice(2), { pattern: 'req-rep', count: 10000 }), function (result) {
+      console.log(JSON.stringify(result))
+      process.exit(0)
+    })
+  }
+}
@@ -0,0 +1,357 @@
+//
+// # Run
+//
+// Runs the benchmarks across a matrix of patterns, transports, message sizes and frame counts, printing a table of
+// the results and, optionally, writing them out as JSON lines for comparison between builds.
+//
+//     node bench/run [--patterns push-pull,pub-sub,dealer-router] [--latency-patterns req-rep,dealer-router]
+//                    [--transports inproc,ipc,tcp] [--sizes 16,256,4096,65536] [--frames 1,3] [--count 100000]
+//                    [--latency-count 10000] [--options '{"zeroCopyReads":4096}'] [--busy-poll 100] [--native]
+//                    [--json results.jsonl]
+//
+// Every run happens in fresh processes, one per side for `ipc` and `tcp`. With `--native`, each run is repeated
+// with the plain libzmq programs in `bench/c` (see `make -C bench/c`), giving a ceiling to measure the binding
+// against. With `--busy-poll`, each latency run is repeated with `busyPollMicros` set, to compare against the
+// default mode.
+//
+var child_process = require('child_process')
+  , fs = require('fs')
+  , path = require('path')
+  , stats = require('./stats')
+  , throughput = require('./throughput')
+  , latency = require('./latency')
+
+var DEFAULTS = {
+  patterns: 'push-pull,pub-sub,dealer-router',
+  'latency-patterns': 'req-rep,dealer-router',
+  transports: 'inproc,ipc,tcp',
+  sizes: '16,256,4096,65536',
+  frames: '1,3',
+  count: '100000',
+  'latency-count': '10000',
+  options: '{}',
+  'busy-poll': null,
+  native: false,
+  json: null
+}
+
+// A run that hasn't finished by now has stalled (e.g. a PUB/SUB run that lost every message).
+var RUN_TIMEOUT = 60000
+
+//
+// ## parseArgs `parseArgs(argv)`
+//
+// Parses `--name value` pairs from **argv** over DEFAULTS.
+//
+function parseArgs(argv) {
+  var args = {}
+    , key
+    , i
+
+  for (key in DEFAULTS) {
+    args[key] = DEFAULTS[key]
+  }
+
+  for (i = 0; i < argv.length; i++) {
+    key = argv[i].replace(/^--/, '')
+
+    if (typeof DEFAULTS[key] === 'boolean') {
+      args[key] = true
+    } else {
+      args[key] = argv[++i]
+    }
+  }
+
+  return args
+}
+
+//
+// ## matrix `matrix(args)`
+//
+// Returns the configuration of every run described by **args**.
+//
+function matrix(args) {
+  var runs = []
+    , options = JSON.parse(args.options)
+
+  function add(bench, patterns, known, count) {
+    patterns.split(',').filter(Boolean).forEach(function (pattern) {
+      if (!known[pattern]) {
+        throw new Error('Unknown ' + bench + ' pattern: ' + pattern)
+      }
+
+      args.transports.split(',').forEach(function (transport) {
+        args.sizes.split(',').forEach(function (size) {
+          args.frames.split(',').forEach(function (frames) {
+            runs.push({
+              bench: bench,
+              pattern: pattern,
+              transport: transport,
+              endpoint: stats.ENDPOINTS[transport],
+              size: parseInt(size, 10),
+              frames: parseInt(frames, 10),
+              count: parseInt(count, 10),
+              options: options
+            })
+          })
+        })
+      })
+    })
+  }
+
+  add('throughput', args.patterns, throughput.PATTERNS, args.count)
+  add('latency', args['latency-patterns'], latency.PATTERNS, args['latency-count'])
+
+  return runs
+}
+
+//
+// ## withRole `withRole(config, role)`
+//
+// Returns a copy of **config** for the side playing **role**.
+//
+function withRole(config, role) {
+  var copy = {}
+    , key
+
+  for (key in config) {
+    copy[key] = config[key]
+  }
+
+  copy.role = role
+
+  return copy
+}
+
+//
+// ## runNode `runNode(config, callback)`
+//
+// Runs **config** with zmq-stream, calling **callback** with the results (or null, if it stalled).
+//
+function runNode(config, callback) {
+  var script = path.join(__dirname, config.bench + '.js')
+    , children = []
+    , timer
+
+  function finish(result) {
+    clearTimeout(timer)
+
+    children.forEach(function (child) {
+      child.kill()
+    })
+
+    if (result) {
+      result.binding = 'zmq-stream'
+    }
+
+    callback(result)
+  }
+
+  function spawn(role) {
+    var child = child_process.fork(script)
+
+    children.push(child)
+
+    child.on('message', function (message) {
+      if (message.ready) {
+        spawn('sender')
+      } else if (message.result) {
+        finish(message.result)
+      }
+    })
+    child.send(withRole(config, role))
+  }
+
+  timer = setTimeout(function () {
+    finish(null)
+  }, RUN_TIMEOUT)
+
+  // inproc only works within a single context, so both sides have to share a process.
+  spawn(config.transport === 'inproc' ? 'both' : 'receiver')
+}
+
+//
+// ## runBusyPoll `runBusyPoll(config, micros, callback)`
+//
+// Runs **config** with zmq-stream exactly like `runNode`, but with `busyPollMicros` set to **micros** on both sides.
+//
+function runBusyPoll(config, micros, callback) {
+  var copy = {}
+    , key
+
+  for (key in config) {
+    copy[key] = config[key]
+  }
+
+  copy.options = {}
+
+  for (key in config.options) {
+    copy.options[key] = config.options[key]
+  }
+
+  copy.options.busyPollMicros = micros
+
+  runNode(copy, function (result) {
+    if (result) {
+      result.binding = 'busy-poll'
+    }
+
+    callback(result)
+  })
+}
+
+//
+// ## runNative `runNative(config, callback)`
+//
+// Runs **config** with the programs in `bench/c`, calling **callback** with the results (or null, if they're
+// unavailable or stalled).
+//
+function runNative(config, callback) {
+  var program = path.join(__dirname, 'c', config.bench === 'throughput' ? 'thr' : 'lat')
+    , children = []
+    , timer
+
+  function finish(result) {
+    clearTimeout(timer)
+
+    children.forEach(function (child) {
+      child.kill()
+    })
+
+    if (result) {
+      result.binding = 'libzmq'
+      result.options = {}
+    }
+
+    callback(result)
+  }
+
+  function spawn(role) {
+    var child = child_process.spawn(program, [
+          role, config.pattern, config.endpoint, config.size, config.frames, config.count
+        ])
+      , output = ''
+
+    children.push(child)
+
+    child.on('error', function () {
+      finish(null)
+    })
+    child.stdout.on('data', function (data) {
+      var lines
+
+      output += data
+      lines = output.split('\n')
+      output = lines.pop()
+
+      lines.forEach(function (line) {
+        var message = JSON.parse(line)
+
+        if (message.ready) {
+          spawn('sender')
+        } else if (message.bench) {
+          finish(message)
+        }
+      })
+    })
+  }
+
+  if (!fs.existsSync(program)) {
+    callback(null)
+    return
+  }
+
+  timer = setTimeout(function () {
+    finish(null)
+  }, RUN_TIMEOUT)
+
+  spawn(config.transport === 'inproc' ? 'both' : 'receiver')
+}
+
+//
+// ## report `report(result)`
+//
+// Prints a single row of the results table.
+//
+function report(result) {
+  function pad(value, width) {
+    value = String(value)
+
+    while (value.length < width) {
+      value = ' ' + value
+    }
+
+    return value
+  }
+
+  console.log([
+    pad(result.binding, 10),
+    pad(result.bench, 10),
+    pad(result.pattern, 13),
+    pad(result.transport, 6),
+    pad(result.size, 6),
+    pad(result.frames, 2),
+    pad(result.msgsPerSec, 9),
+    pad(result.mbPerSec, 9),
+    pad(result.latency ? result.latency.p50 : '-', 9),
+    pad(result.latency ? result.latency.p99 : '-', 9),
+    pad(result.latency ? result.latency.p999 : '-', 9)
+  ].join(' '))
+}
+
+//
+// ## main `main()`
+//
+// Runs every benchmark in turn.
+//
+function main() {
+  var args = parseArgs(process.argv.slice(2))
+    , runs = matrix(args)
+    , output = args.json ? fs.createWriteStream(args.json) : null
+    , jobs = []
+
+  runs.forEach(function (config) {
+    jobs.push(function (next) {
+      runNode(config, next)
+    })
+
+    if (args['busy-poll'] && config.bench === 'latency') {
+      jobs.push(function (next) {
+        runBusyPoll(config, parseInt(args['busy-poll'], 10), next)
+      })
+    }
+
+    if (args.native) {
+      jobs.push(function (next) {
+        runNative(config, next)
+      })
+    }
+  })
+
+  console.log('   binding      bench       pattern  trans   size fr     msg/s      MB/s   p50(us)   p99(us)  p999(us)')
+
+  ;(function step() {
+    var job = jobs.shift()
+
+    if (!job) {
+      if (output) {
+        output.end()
+      }
+      return
+    }
+
+    job(function (result) {
+      if (result) {
+        report(result)
+
+        if (output) {
+          output.write(JSON.stringify(result) + '\n')
+        }
+      }
+
+      step()
+    })
+  })()
+}
+
+main()
@@ -0,0 +1,124 @@
+//
+// # Stats
+//
+// Helpers shared by the benchmarks for configuring runs and summarizing samples.
+//
+
+// The endpoint each transport binds and connects to.
+var ENDPOINTS = {
+  inproc: 'inproc://zmqstream-bench',
+  ipc: 'ipc:///tmp/zmqstream-bench',
+  tcp: 'tcp://127.0.0.1:5870'
+}
+
+//
+// ## configure `configure(args, defaults)`
+//
+// Builds a run's configuration from positional command line **args** (`PATTERN TRANSPORT SIZE FRAMES COUNT`),
+// falling back to **defaults** for the pattern and count.
+//
+function configure(args, defaults) {
+  var transport = args[1] || 'inproc'
+
+  return {
+    role: 'both',
+    pattern: args[0] || defaults.pattern,
+    transport: transport,
+    endpoint: ENDPOINTS[transport],
+    size: parseInt(args[2], 10) || 64,
+    frames: parseInt(args[3], 10) || 1,
+    count: parseInt(args[4], 10) || defaults.count,
+    options: {}
+  }
+}
+
+//
+// ## now `now()`
+//
+// Returns the current monotonic time in nanoseconds. Since `process.hrtime` uses the same monotonic clock in every
+// process, timestamps can be compared across processes on the same host.
+//
+function now() {
+  var time = process.hrtime()
+
+  return time[0] * 1e9 + time[1]
+}
+
+//
+// ## stamp `stamp(buffer)`
+//
+// Writes the current time into the first 8 bytes of **buffer**.
+//
+function stamp(buffer) {
+  var time = process.hrtime()
+
+  buffer.writeUInt32BE(time[0], 0)
+  buffer.writeUInt32BE(time[1], 4)
+}
+
+//
+// ## elapsed `elapsed(buffer)`
+//
+// Returns the nanoseconds since **buffer** was stamped.
+//
+function elapsed(buffer) {
+  return now() - (buffer.readUInt32BE(0) * 1e9 + buffer.readUInt32BE(4))
+}
+
+//
+// ## Samples `Samples(capacity)`
+//
+// Collects up to **capacity** latency samples, in nanoseconds.
+//
+function Samples(capacity) {
+  if (!(this instanceof Samples)) {
+    return new Samples(capacity)
+  }
+
+  this.values = new Float64Array(capacity)
+  this.length = 0
+}
+
+Samples.prototype.add = add
+function add(value) {
+  if (this.length < this.values.length) {
+    this.values[this.length++] = value
+  }
+}
+
+//
+// ## summarize `summarize()`
+//
+// Returns the p50, p99 and p999 of the samples collected so far in microseconds, or null if there are none.
+//
+Samples.prototype.summarize = summarize
+function summarize() {
+  var sorted = Array.prototype.slice.call(this.values, 0, this.length).sort(function (a, b) {
+        return a - b
+      })
+
+  function percentile(p) {
+    return Math.round(sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))] / 10) / 100
+  }
+
+  if (sorted.length === 0) {
+    return null
+  }
+
+  return {
+    samples: sorted.length,
+    p50: percentile(0.5),
+    p99: percentile(0.99),
+    p999: percentile(0.999),
+    max: percentile(1)
+  }
+}
+
+module.exports = {
+  ENDPOINTS: ENDPOINTS,
+  configure: configure,
+  now: now,
+  stamp: stamp,
+  elapsed: elapsed,
+  Samples: Samples
+}
@@ -0,0 +1,283 @@
+//
+// # Throughput
+//
+// Measures how many messages (and bytes) per second flow from a sending socket to a receiving socket, along with the
+// one-way latency of each message under that load. Each message is `frames` frames of `size` bytes, the last of which
+// carries the time it was sent.
+//
+// Run directly, both sockets live in this process:
+//
+//     node bench/throughput [PATTERN] [TRANSPORT] [SIZE] [FRAMES] [COUNT]
+//
+// When run by `bench/run`, each side is forked into its own process for the `ipc` and `tcp` transports.
+//
+var zmqstream = require('../lib/zmqstream')
+  , stats = require('./stats')
+  , configure = stats.configure
+
+var PATTERNS = {
+  'push-pull': { sender: 'PUSH', receiver: 'PULL' },
+  'pub-sub': { sender: 'PUB', receiver: 'SUB' },
+  'dealer-router': { sender: 'DEALER', receiver: 'ROUTER' }
+}
+
+// PUB/SUB drops messages rather than pushing back, so the receiver gives up once messages stop arriving.
+var IDLE_TIMEOUT = 1000
+
+//
+// ## createSocket `createSocket(type, config)`
+//
+// Creates a Socket of **type**, with any extra `config.options` applied.
+//
+function createSocket(type, config) {
+  var options = { type: zmqstream.Type[type] }
+    , key
+
+  for (key in config.options) {
+    options[key] = config.options[key]
+  }
+
+  return new zmqstream.Socket(options)
+}
+
+//
+// ## Receiver `Receiver(config)`
+//
+// Binds to `config.endpoint`, receiving until `config.count` messages have arrived.
+//
+function Receiver(config) {
+  if (!(this instanceof Receiver)) {
+    return new Receiver(config)
+  }
+
+  this.config = config
+  this.received = 0
+  this.bytes = 0
+  this.startTime = null
+  this.lastTime = null
+  this.latency = stats.Samples(config.count)
+
+  this.socket = createSocket(PATTERNS[config.pattern].receiver, config)
+
+  if (config.pattern === 'pub-sub') {
+    this.socket.set(zmqstream.Option.SUBSCRIBE, '')
+  }
+
+  this.socket.bind(config.endpoint)
+}
+
+//
+// ## start `start(callback)`
+//
+// Starts receiving, calling **callback** with the results once finished.
+//
+Receiver.prototype.start = function start(callback) {
+  var self = this
+
+  self.callback = callback
+  self.socket.on('readable', function () {
+    self.recv()
+  })
+  self.recv()
+
+  self.timer = setInterval(function () {
+    if (self.lastTime !== null && stats.now() - self.lastTime > IDLE_TIMEOUT * 1e6) {
+      self.finish()
+    }
+  }, IDLE_TIMEOUT / 4)
+}
+
+//
+// ## recv `recv()`
+//
+// Receives everything available, recording the latency of each message.
+//
+Receiver.prototype.recv = function recv() {
+  var self = this
+    , messages
+    , message
+    , last
+    , i
+
+  while ((messages = self.socket.read())) {
+    if (self.startTime === null) {
+      self.startTime = stats.now()
+    }
+
+    for (i = 0; i < messages.length; i++) {
+      message = messages[i]
+      last = message[message.length - 1]
+
+      if (last.length >= 8) {
+        self.latency.add(stats.elapsed(last))
+      }
+
+      self.bytes += last.length * self.config.frames
+    }
+
+    self.received += messages.length
+    self.lastTime = stats.now()
+
+    if (self.received >= self.config.count) {
+      self.finish()
+      return
+    }
+  }
+}
+
+//
+// ## finish `finish()`
+//
+// Stops receiving and reports the results.
+//
+Receiver.prototype.finish = function finish() {
+  var seconds = (this.lastTime - this.startTime) / 1e9
+
+  clearInterval(this.timer)
+  this.socket.removeAllListeners('readable')
+
+  this.callback({
+    bench: 'throughput',
+    pattern: this.config.pattern,
+    transport: this.config.transport,
+    size: this.config.size,
+    frames: this.config.frames,
+    options: this.config.options,
+    count: this.config.count,
+    received: this.received,
+    seconds: seconds,
+    msgsPerSec: Math.round(this.received / seconds),
+    mbPerSec: Math.round(this.bytes / seconds / 1e4) / 100,
+    latency: this.latency.summarize()
+  })
+}
+
+//
+// ## Sender `Sender(config)`
+//
+// Connects to `config.endpoint`, sending `config.count` messages as quickly as the socket accepts them.
+//
+function Sender(config) {
+  if (!(this instanceof Sender)) {
+    return new Sender(config)
+  }
+
+  var i
+
+  this.config = config
+  this.sent = 0
+  this.frames = []
+
+  for (i = 0; i < config.frames; i++) {
+    this.frames.push(new Buffer(config.size))
+    this.frames[i].fill(0)
+  }
+
+  this.socket = createSocket(PATTERNS[config.pattern].sender, config)
+  this.socket.connect(config.endpoint)
+}
+
+//
+// ## start `start(callback)`
+//
+// Starts sending, calling **callback** once every message has been queued.
+//
+Sender.prototype.start = function start(callback) {
+  var self = this
+
+  self.callback = callback
+  self.socket.on('drain', function () {
+    self.send()
+  })
+
+  // Subscriptions take a moment to reach the publisher, and anything published before then is lost.
+  setTimeout(function () {
+    self.send()
+  }, self.config.pattern === 'pub-sub' ? 500 : 0)
+}
+
+//
+// ## send `send()`
+//
+// Sends messages until the socket is full, yielding to the event loop every so often.
+//
+Sender.prototype.send = function send() {
+  var self = this
+    , last = self.frames.length - 1
+    , batch = 0
+
+  while (self.sent < self.config.count && batch < 1000) {
+    // Zero-copy writes keep a reference to the Buffer, which therefore can't be reused until it's sent.
+    if (self.config.options.zeroCopyWrites) {
+      self.frames[last] = new Buffer(self.config.size)
+    }
+
+    if (self.config.size >= 8) {
+      stats.stamp(self.frames[last])
+    }
+
+    if (!self.socket.write(self.frames)) {
+      return
+    }
+
+    self.sent++
+    batch++
+  }
+
+  if (self.sent < self.config.count) {
+    setImmediate(function () {
+      self.send()
+    })
+  } else {
+    self.callback()
+  }
+}
+
+//
+// ## run `run(config, callback)`
+//
+// Runs both sides in this process, calling **callback** with the results.
+//
+function run(config, callback) {
+  Receiver(config).start(callback)
+  Sender(config).start(function () {})
+}
+
+module.exports = {
+  PATTERNS: PATTERNS,
+  Receiver: Receiver,
+  Sender: Sender,
+  run: run
+}
+
+//
+// ## Running
+//
+// If `throughput` is forked by `bench/run`, it waits to be told which side (or both) to play. Run directly, it plays
+// both sides itself.
+//
+if (require.main === module) {
+  if (process.send) {
+    process.on('message', function (config) {
+      if (config.role === 'both') {
+        run(config, function (result) {
+          process.send({ result: result })
+        })
+      } else if (config.role === 'receiver') {
+        Receiver(config).start(function (result) {
+          process.send({ result: result })
+        })
+        process.send({ ready: true })
+      } else {
+        Sender(config).start(function () {
+          process.send({ sent: true })
+        })
+      }
+    })
+  } else {
+    run(configure(process.argv.slice(2), { pattern: 'push-pull', count: 100000 }), function (result) {
+      console.log(JSON.stringify(result))
+      process.exit(0)
+    })
+  }
+}
@@ -1,14 +1,38 @@
 {
+  # Optional frame compression codecs, e.g. `node-gyp rebuild --zmqstream_lz4=true --zmqstream_zstd=true`.
+  'variables': {
+    'zmqstream_lz4%': 'false',
+    'zmqstream_zstd%': 'false'
+  },
   'targets': [
     {
       'target_name': 'zmqstream',
-      'sources': [ 'src/zmqstream.cc' ],
+      'sources': [ 'src/zmqstream.cc', 'src/iothread.cc', 'src/pool.cc', 'src/proxy.cc', 'src/coalesce.cc',
+        'src/compress.cc', 'src/trie.cc', 'src/identity.cc', 'src/trace.cc' ],
       # TODO: Build for other platforms.
       'link_settings': {
         'libraries': [
           '-lzmq'
         ]
-      }
+      },
+      'conditions': [
+        [ 'zmqstream_lz4=="true"', {
+          'defines': [ 'ZMQSTREAM_LZ4' ],
+          'link_settings': {
+            'libraries': [
+              '-llz4'
+            ]
+          }
+        } ],
+        [ 'zmqstream_zstd=="true"', {
+          'defines': [ 'ZMQSTREAM_ZSTD' ],
+          'link_settings': {
+            'libraries': [
+              '-lzstd'
+            ]
+          }
+        } ]
+      ]
     }
   ]
 }
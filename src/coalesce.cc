@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "coalesce.h"
+
+namespace zmqstream {
+  // An unlikely first frame for any application message, ending in the format's version.
+  const char BATCH_MARKER[] = "\xffZSB\x01";
+  const size_t BATCH_MARKER_SIZE = sizeof BATCH_MARKER - 1;
+
+  static inline void writeUInt32(char *data, uint32_t value) {
+    data[0] = (char)(value >> 24);
+    data[1] = (char)(value >> 16);
+    data[2] = (char)(value >> 8);
+    data[3] = (char)value;
+  }
+
+  static inline uint32_t readUInt32(const char *data) {
+    const unsigned char *bytes = (const unsigned char*)data;
+
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+  }
+
+  //
+  // ## Coalescer(maxBytes, maxMessages)
+  //
+  // Creates a new, empty batch that's full at **maxBytes** bytes or **maxMessages** messages.
+  //
+  Coalescer::Coalescer(size_t maxBytes, size_t maxMessages)
+      : data(NULL), size(0), capacity(0), messages(0), maxBytes(maxBytes), maxMessages(maxMessages) {
+  }
+
+  Coalescer::~Coalescer() {
+    free(data);
+  }
+
+  //
+  // ## BeginMessage `BeginMessage(frames)`
+  //
+  // Starts a new message of **frames** frames, which must each be appended with `AppendFrame`.
+  //
+  void Coalescer::BeginMessage(uint32_t frames) {
+    Reserve(4);
+    writeUInt32(data + size, frames);
+    size += 4;
+    messages++;
+  }
+
+  //
+  // ## AppendFrame `AppendFrame(data, size)`
+  //
+  // Appends a copy of the **size** bytes at **data** as the next frame of the current message.
+  //
+  void Coalescer::AppendFrame(const char *frame, size_t frameSize) {
+    Reserve(4 + frameSize);
+    writeUInt32(data + size, (uint32_t)frameSize);
+    memcpy(data + size + 4, frame, frameSize);
+    size += 4 + frameSize;
+  }
+
+  //
+  // ## Take `Take(size)`
+  //
+  // Hands over the batch, storing its size in **size**, and starts a new one. The batch is released with `Free`.
+  //
+  char *Coalescer::Take(size_t *batchSize) {
+    char *batch = data;
+
+    *batchSize = size;
+
+    data = NULL;
+    size = 0;
+    capacity = 0;
+    messages = 0;
+
+    return batch;
+  }
+
+  void Coalescer::Free(void *data, void *hint) {
+    free(data);
+  }
+
+  //
+  // ## Reserve `Reserve(bytes)`
+  //
+  // Ensures there's room for **bytes** more bytes in the batch.
+  //
+  void Coalescer::Reserve(size_t bytes) {
+    if (size + bytes <= capacity) {
+      return;
+    }
+
+    // Most batches are flushed at `maxBytes`, so that's enough room for all but the message that overflows it.
+    size_t needed = size + bytes;
+
+    capacity = capacity > 0 ? capacity * 2 : maxBytes + 64;
+
+    if (capacity < needed) {
+      capacity = needed;
+    }
+
+    data = (char*)realloc(data, capacity);
+    assert(data);
+  }
+
+  //
+  // ## IsMarker `IsMarker(data, size)`
+  //
+  // Returns true if the **size** bytes at **data** are a batch's marker frame.
+  //
+  bool BatchReader::IsMarker(const void *data, size_t size) {
+    return size == BATCH_MARKER_SIZE && memcmp(data, BATCH_MARKER, BATCH_MARKER_SIZE) == 0;
+  }
+
+  BatchReader::BatchReader(const void *data, size_t size) : cursor((const char*)data), end((const char*)data + size) {
+  }
+
+  //
+  // ## Validate `Validate(messages, frames, bytes)`
+  //
+  // Returns true if the whole batch is well-formed, storing the number of messages and frames it holds, and the
+  // total size of those frames. Doesn't move the reader.
+  //
+  bool BatchReader::Validate(uint32_t *messages, uint32_t *frames, size_t *bytes) const {
+    BatchReader reader(*this);
+    uint32_t frameCount;
+    const char *frame;
+    uint32_t frameSize;
+
+    *messages = 0;
+    *frames = 0;
+    *bytes = 0;
+
+    while (reader.cursor != reader.end) {
+      // An empty message can't be sent in the first place.
+      if (!reader.NextMessage(&frameCount) || frameCount == 0) {
+        return false;
+      }
+
+      for (uint32_t i = 0; i < frameCount; i++) {
+        if (!reader.NextFrame(&frame, &frameSize)) {
+          return false;
+        }
+
+        *bytes += frameSize;
+      }
+
+      *messages += 1;
+      *frames += frameCount;
+    }
+
+    return *messages > 0;
+  }
+
+  //
+  // ## NextMessage `NextMessage(frames)`
+  //
+  // Moves to the next message, storing its frame count in **frames**. Returns false at the end of the batch.
+  //
+  bool BatchReader::NextMessage(uint32_t *frames) {
+    if (end - cursor < 4) {
+      return false;
+    }
+
+    *frames = readUInt32(cursor);
+    cursor += 4;
+
+    return true;
+  }
+
+  //
+  // ## NextFrame `NextFrame(data, size)`
+  //
+  // Moves to the next frame of the current message, storing where it is in **data** and **size**.
+  //
+  bool BatchReader::NextFrame(const char **data, uint32_t *size) {
+    if (end - cursor < 4) {
+      return false;
+    }
+
+    *size = readUInt32(cursor);
+
+    if ((size_t)(end - cursor - 4) < *size) {
+      return false;
+    }
+
+    *data = cursor + 4;
+    cursor += 4 + *size;
+
+    return true;
+  }
+}
@@ -0,0 +1,135 @@
+#ifndef ZMQSTREAM_COALESCE_H
+#define ZMQSTREAM_COALESCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace zmqstream {
+  //
+  // ## Batches
+  //
+  // A batch travels as a two-frame message: a marker frame (`BATCH_MARKER`, which doubles as the format's version),
+  // followed by a single frame packing any number of messages. Within that frame, each message is its frame count,
+  // followed by each frame's length and bytes. All counts and lengths are 32-bit big-endian integers.
+  //
+  extern const char BATCH_MARKER[];
+  extern const size_t BATCH_MARKER_SIZE;
+
+  //
+  // ## Coalescer
+  //
+  // Packs small messages into a batch until it reaches `maxBytes` or `maxMessages`, at which point it should be
+  // taken and sent.
+  //
+  class Coalescer {
+    public:
+      //
+      // ## Coalescer(maxBytes, maxMessages)
+      //
+      // Creates a new, empty batch that's full at **maxBytes** bytes or **maxMessages** messages.
+      //
+      Coalescer(size_t maxBytes, size_t maxMessages);
+
+      ~Coalescer();
+
+      //
+      // ## BeginMessage `BeginMessage(frames)`
+      //
+      // Starts a new message of **frames** frames, which must each be appended with `AppendFrame`.
+      //
+      void BeginMessage(uint32_t frames);
+
+      //
+      // ## AppendFrame `AppendFrame(data, size)`
+      //
+      // Appends a copy of the **size** bytes at **data** as the next frame of the current message.
+      //
+      void AppendFrame(const char *data, size_t size);
+
+      //
+      // ## Take `Take(size)`
+      //
+      // Hands over the batch, storing its size in **size**, and starts a new one. The batch is released with `Free`.
+      //
+      char *Take(size_t *size);
+
+      //
+      // ## Free
+      //
+      // A `zmq_free_fn` releasing a batch returned by `Take`.
+      //
+      static void Free(void *data, void *hint);
+
+      bool Full() const {
+        return size >= maxBytes || messages >= maxMessages;
+      }
+
+      size_t Messages() const {
+        return messages;
+      }
+
+    protected:
+      char *data;
+      size_t size;
+      size_t capacity;
+      size_t messages;
+      size_t maxBytes;
+      size_t maxMessages;
+
+      //
+      // ## Reserve `Reserve(bytes)`
+      //
+      // Ensures there's room for **bytes** more bytes in the batch.
+      //
+      void Reserve(size_t bytes);
+
+    private:
+      Coalescer(const Coalescer&);
+      Coalescer& operator=(const Coalescer&);
+  };
+
+  //
+  // ## BatchReader
+  //
+  // Walks the messages packed into a batch frame, without copying them.
+  //
+  class BatchReader {
+    public:
+      //
+      // ## IsMarker `IsMarker(data, size)`
+      //
+      // Returns true if the **size** bytes at **data** are a batch's marker frame.
+      //
+      static bool IsMarker(const void *data, size_t size);
+
+      BatchReader(const void *data, size_t size);
+
+      //
+      // ## Validate `Validate(messages, frames, bytes)`
+      //
+      // Returns true if the whole batch is well-formed, storing the number of messages and frames it holds, and the
+      // total size of those frames. Doesn't move the reader.
+      //
+      bool Validate(uint32_t *messages, uint32_t *frames, size_t *bytes) const;
+
+      //
+      // ## NextMessage `NextMessage(frames)`
+      //
+      // Moves to the next message, storing its frame count in **frames**. Returns false at the end of the batch.
+      //
+      bool NextMessage(uint32_t *frames);
+
+      //
+      // ## NextFrame `NextFrame(data, size)`
+      //
+      // Moves to the next frame of the current message, storing where it is in **data** and **size**.
+      //
+      bool NextFrame(const char **data, uint32_t *size);
+
+    protected:
+      const char *cursor;
+      const char *end;
+  };
+}
+
+#endif
@@ -0,0 +1,287 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ZMQSTREAM_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef ZMQSTREAM_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+#include "compress.h"
+
+namespace zmqstream {
+  // Like BATCH_MARKER, an unlikely start for any application frame. The codec's number follows it.
+  const char COMPRESSED_MARKER[] = "\xffZC";
+  const size_t COMPRESSED_MARKER_SIZE = sizeof COMPRESSED_MARKER - 1;
+  const size_t COMPRESSED_HEADER_SIZE = COMPRESSED_MARKER_SIZE + 1 + 4;
+
+  static inline void writeUInt32(char *data, uint32_t value) {
+    data[0] = (char)(value >> 24);
+    data[1] = (char)(value >> 16);
+    data[2] = (char)(value >> 8);
+    data[3] = (char)value;
+  }
+
+  static inline uint32_t readUInt32(const char *data) {
+    const unsigned char *bytes = (const unsigned char*)data;
+
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+  }
+
+  //
+  // ## Available `Available(codec)`
+  //
+  // Returns true if **codec** was built in.
+  //
+  bool Compressor::Available(int codec) {
+    switch (codec) {
+#ifdef ZMQSTREAM_LZ4
+      case LZ4:
+        return true;
+#endif
+#ifdef ZMQSTREAM_ZSTD
+      case ZSTD:
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  //
+  // ## IsCompressed `IsCompressed(data, size)`
+  //
+  // Returns true if the **size** bytes at **data** start with a compressed frame's header.
+  //
+  bool Compressor::IsCompressed(const void *data, size_t size) {
+    return size > COMPRESSED_HEADER_SIZE && memcmp(data, COMPRESSED_MARKER, COMPRESSED_MARKER_SIZE) == 0;
+  }
+
+  //
+  // ## Compressor(codec, level, dictionary, dictionarySize, minBytes)
+  //
+  // Creates a new Compressor for **codec**, which must be available. **level** is the codec's own (0 picks its
+  // default), and **dictionary** may be NULL.
+  //
+  Compressor::Compressor(int codec, int level, const char *dictionary, size_t dictionarySize, size_t minBytes)
+      : codec(codec), level(level), minBytes(minBytes), compressDictionary(NULL), decompressDictionary(NULL),
+        decompressContext(NULL) {
+    assert(Available(codec));
+
+#ifdef ZMQSTREAM_ZSTD
+    // Only zstd decompresses with any state, and it's needed even if this Compressor sends with LZ4.
+    decompressContext = ZSTD_createDCtx();
+    assert(decompressContext);
+
+    if (dictionary && dictionarySize > 0) {
+      compressDictionary = ZSTD_createCDict(dictionary, dictionarySize, level);
+      decompressDictionary = ZSTD_createDDict(dictionary, dictionarySize);
+      assert(compressDictionary && decompressDictionary);
+    }
+#endif
+  }
+
+  Compressor::~Compressor() {
+#ifdef ZMQSTREAM_ZSTD
+    ZSTD_freeCDict((ZSTD_CDict*)compressDictionary);
+    ZSTD_freeDDict((ZSTD_DDict*)decompressDictionary);
+    ZSTD_freeDCtx((ZSTD_DCtx*)decompressContext);
+#endif
+  }
+
+  //
+  // ## NewContext `NewContext()`
+  //
+  // Returns the scratch state one thread needs to call `Compress`, to be released with `FreeContext`.
+  //
+  void *Compressor::NewContext() const {
+#ifdef ZMQSTREAM_ZSTD
+    if (codec == ZSTD) {
+      return ZSTD_createCCtx();
+    }
+#endif
+
+    // LZ4 keeps its state on the stack.
+    return NULL;
+  }
+
+  void Compressor::FreeContext(void *context) const {
+#ifdef ZMQSTREAM_ZSTD
+    ZSTD_freeCCtx((ZSTD_CCtx*)context);
+#endif
+  }
+
+  //
+  // ## Compress `Compress(context, data, size, out)`
+  //
+  // Compresses the **size** bytes at **data** into a new frame, header included, stored in **out** and released
+  // with `Free`. Returns the frame's size, or 0 (allocating nothing) if it wouldn't be any smaller.
+  //
+  size_t Compressor::Compress(void *context, const char *data, size_t size, char **out) const {
+    size_t bound = 0;
+    size_t compressed = 0;
+
+    // Larger frames couldn't describe their size in the header.
+    if (size < minBytes || size > UINT32_MAX) {
+      return 0;
+    }
+
+#ifdef ZMQSTREAM_LZ4
+    if (codec == LZ4) {
+      if (size > (size_t)INT32_MAX) {
+        return 0;
+      }
+
+      bound = LZ4_compressBound((int)size);
+    }
+#endif
+#ifdef ZMQSTREAM_ZSTD
+    if (codec == ZSTD) {
+      bound = ZSTD_compressBound(size);
+    }
+#endif
+
+    char *frame = (char*)malloc(COMPRESSED_HEADER_SIZE + bound);
+    assert(frame);
+
+#ifdef ZMQSTREAM_LZ4
+    if (codec == LZ4) {
+      int rc = LZ4_compress_fast(data, frame + COMPRESSED_HEADER_SIZE, (int)size, (int)bound, level > 0 ? level : 1);
+
+      compressed = rc > 0 ? rc : 0;
+    }
+#endif
+#ifdef ZMQSTREAM_ZSTD
+    if (codec == ZSTD) {
+      size_t rc;
+
+      if (compressDictionary) {
+        rc = ZSTD_compress_usingCDict((ZSTD_CCtx*)context, frame + COMPRESSED_HEADER_SIZE, bound, data, size,
+                                      (const ZSTD_CDict*)compressDictionary);
+      } else {
+        rc = ZSTD_compressCCtx((ZSTD_CCtx*)context, frame + COMPRESSED_HEADER_SIZE, bound, data, size, level);
+      }
+
+      compressed = ZSTD_isError(rc) ? 0 : rc;
+    }
+#endif
+
+    if (compressed == 0 || COMPRESSED_HEADER_SIZE + compressed >= size) {
+      free(frame);
+      return 0;
+    }
+
+    memcpy(frame, COMPRESSED_MARKER, COMPRESSED_MARKER_SIZE);
+    frame[COMPRESSED_MARKER_SIZE] = (char)codec;
+    writeUInt32(frame + COMPRESSED_MARKER_SIZE + 1, (uint32_t)size);
+
+    *out = frame;
+    return COMPRESSED_HEADER_SIZE + compressed;
+  }
+
+  //
+  // ## Decompress `Decompress(data, size, out)`
+  //
+  // Decompresses the compressed frame of **size** bytes at **data** into **out**, released with `Free`. Returns
+  // the original size, or -1 (allocating nothing) if the frame is corrupt or its codec unavailable.
+  //
+  ssize_t Compressor::Decompress(const char *data, size_t size, char **out) {
+    int frameCodec = (unsigned char)data[COMPRESSED_MARKER_SIZE];
+    size_t original = readUInt32(data + COMPRESSED_MARKER_SIZE + 1);
+    bool ok = false;
+
+    if (!Available(frameCodec) || original == 0) {
+      return -1;
+    }
+
+    // Skip the header.
+    data += COMPRESSED_HEADER_SIZE;
+    size -= COMPRESSED_HEADER_SIZE;
+
+    // The original size comes from the peer (or from a plain frame that merely looks compressed), so it's checked
+    // against what the payload could possibly expand to before anything is allocated for it.
+#ifdef ZMQSTREAM_LZ4
+    // Every byte of an LZ4 block stands for at most 255 bytes of output.
+    if (frameCodec == LZ4 && original > (uint64_t)size * 255) {
+      return -1;
+    }
+#endif
+#ifdef ZMQSTREAM_ZSTD
+    // zstd records the size in its own frame header, which has to agree. Its densest block, a run, takes 4 bytes to
+    // describe a full 128KiB block.
+    if (frameCodec == ZSTD &&
+        (ZSTD_getFrameContentSize(data, size) != original || original > (uint64_t)size * (128 * 1024 / 4))) {
+      return -1;
+    }
+#endif
+
+    char *frame = (char*)malloc(original);
+
+    if (frame == NULL) {
+      return -1;
+    }
+
+#ifdef ZMQSTREAM_LZ4
+    if (frameCodec == LZ4) {
+      ok = original <= (size_t)INT32_MAX && size <= (size_t)INT32_MAX &&
+           LZ4_decompress_safe(data, frame, (int)size, (int)original) == (int)original;
+    }
+#endif
+#ifdef ZMQSTREAM_ZSTD
+    if (frameCodec == ZSTD) {
+      size_t rc;
+
+      if (decompressDictionary) {
+        rc = ZSTD_decompress_usingDDict((ZSTD_DCtx*)decompressContext, frame, original, data, size,
+                                        (const ZSTD_DDict*)decompressDictionary);
+      } else {
+        rc = ZSTD_decompressDCtx((ZSTD_DCtx*)decompressContext, frame, original, data, size);
+      }
+
+      ok = !ZSTD_isError(rc) && rc == original;
+    }
+#endif
+
+    if (!ok) {
+      free(frame);
+      return -1;
+    }
+
+    *out = frame;
+    return original;
+  }
+
+  void Compressor::Free(void *data, void *hint) {
+    free(data);
+  }
+
+  //
+  // ## TrainDictionary `TrainDictionary(samples, sizes, count, capacity, out)`
+  //
+  // Trains a zstd dictionary of up to **capacity** bytes from **count** samples, stored back to back in
+  // **samples**. The dictionary is stored in **out**, released with `free`. Returns its size, or 0 on failure.
+  //
+  size_t Compressor::TrainDictionary(const char *samples, const size_t *sizes, unsigned count, size_t capacity,
+                                     char **out) {
+#ifdef ZMQSTREAM_ZSTD
+    char *dictionary = (char*)malloc(capacity);
+    assert(dictionary);
+
+    size_t rc = ZDICT_trainFromBuffer(dictionary, capacity, samples, sizes, count);
+
+    if (ZDICT_isError(rc)) {
+      free(dictionary);
+      return 0;
+    }
+
+    *out = dictionary;
+    return rc;
+#else
+    return 0;
+#endif
+  }
+}
@@ -0,0 +1,121 @@
+#ifndef ZMQSTREAM_COMPRESS_H
+#define ZMQSTREAM_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace zmqstream {
+  //
+  // ## Compressed frames
+  //
+  // A compressed frame starts with an 8-byte header: `COMPRESSED_MARKER`, the codec's number, and the frame's
+  // original size as a 32-bit big-endian integer. Frames without the header are plain, so a compressing socket reads
+  // plain peers just fine, and sends small or incompressible frames plain as well.
+  //
+  extern const char COMPRESSED_MARKER[];
+  extern const size_t COMPRESSED_MARKER_SIZE;
+  extern const size_t COMPRESSED_HEADER_SIZE;
+
+  //
+  // ## Compressor
+  //
+  // Compresses frames of at least `minBytes` bytes with one codec (LZ4 or zstd, each only available if built with
+  // it), and decompresses frames compressed with any available codec. A zstd dictionary, if given, is used in both
+  // directions, so peers must share it.
+  //
+  // `Compress` is safe to call from any thread, given a context of its own (see `NewContext`). Everything else
+  // belongs to the main thread.
+  //
+  class Compressor {
+    public:
+      enum Codec {
+        NONE = 0,
+        LZ4 = 1,
+        ZSTD = 2
+      };
+
+      //
+      // ## Available `Available(codec)`
+      //
+      // Returns true if **codec** was built in.
+      //
+      static bool Available(int codec);
+
+      //
+      // ## IsCompressed `IsCompressed(data, size)`
+      //
+      // Returns true if the **size** bytes at **data** start with a compressed frame's header.
+      //
+      static bool IsCompressed(const void *data, size_t size);
+
+      //
+      // ## Compressor(codec, level, dictionary, dictionarySize, minBytes)
+      //
+      // Creates a new Compressor for **codec**, which must be available. **level** is the codec's own (0 picks its
+      // default), and **dictionary** may be NULL.
+      //
+      Compressor(int codec, int level, const char *dictionary, size_t dictionarySize, size_t minBytes);
+
+      ~Compressor();
+
+      //
+      // ## NewContext `NewContext()`
+      //
+      // Returns the scratch state one thread needs to call `Compress`, to be released with `FreeContext`.
+      //
+      void *NewContext() const;
+      void FreeContext(void *context) const;
+
+      //
+      // ## Compress `Compress(context, data, size, out)`
+      //
+      // Compresses the **size** bytes at **data** into a new frame, header included, stored in **out** and released
+      // with `Free`. Returns the frame's size, or 0 (allocating nothing) if it wouldn't be any smaller.
+      //
+      size_t Compress(void *context, const char *data, size_t size, char **out) const;
+
+      //
+      // ## Decompress `Decompress(data, size, out)`
+      //
+      // Decompresses the compressed frame of **size** bytes at **data** into **out**, released with `Free`. Returns
+      // the original size, or -1 (allocating nothing) if the frame is corrupt or its codec unavailable.
+      //
+      ssize_t Decompress(const char *data, size_t size, char **out);
+
+      //
+      // ## Free
+      //
+      // A `zmq_free_fn` releasing a frame returned by `Compress` or `Decompress`.
+      //
+      static void Free(void *data, void *hint);
+
+      //
+      // ## TrainDictionary `TrainDictionary(samples, sizes, count, capacity, out)`
+      //
+      // Trains a zstd dictionary of up to **capacity** bytes from **count** samples, stored back to back in
+      // **samples**. The dictionary is stored in **out**, released with `free`. Returns its size, or 0 on failure.
+      //
+      static size_t TrainDictionary(const char *samples, const size_t *sizes, unsigned count, size_t capacity,
+                                    char **out);
+
+      size_t MinBytes() const {
+        return minBytes;
+      }
+
+    protected:
+      int codec;
+      int level;
+      size_t minBytes;
+      // The codec's own dictionaries and decompression state, which are NULL when unused.
+      void *compressDictionary;
+      void *decompressDictionary;
+      void *decompressContext;
+
+    private:
+      Compressor(const Compressor&);
+      Compressor& operator=(const Compressor&);
+  };
+}
+
+#endif
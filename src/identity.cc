@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "identity.h"
+
+namespace zmqstream {
+  // Slots to start with, enough for a handful of peers before the first `Grow`.
+  static const size_t INITIAL_SLOTS = 64;
+
+  //
+  // FNV-1a, which is plenty for identities: ZMQ's own are sequential, and everyone else's are short.
+  //
+  static uint32_t hashIdentity(const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+
+    return hash;
+  }
+
+  IdentityTable::IdentityTable() : slots(INITIAL_SLOTS, 0), peers(0) {}
+
+  IdentityTable::~IdentityTable() {
+    for (size_t i = 0; i < identities.size(); i++) {
+      if (identities[i]) {
+        zmq_msg_close(identities[i]);
+        delete identities[i];
+      }
+    }
+  }
+
+  //
+  // ## Intern `Intern(data, size)`
+  //
+  // Returns the handle of the identity of **size** bytes at **data**, adding it if it's new.
+  //
+  uint32_t IdentityTable::Intern(const char *data, size_t size) {
+    uint32_t hash = hashIdentity(data, size);
+    size_t slot = Find(data, size, hash);
+
+    if (slots[slot]) {
+      return slots[slot] - 1;
+    }
+
+    // The table is kept at most half full, so probes stay short.
+    if ((peers + 1) * 2 > slots.size()) {
+      Grow();
+      slot = Find(data, size, hash);
+    }
+
+    zmq_msg_t *identity = new zmq_msg_t;
+    assert(zmq_msg_init_size(identity, size) == 0);
+    memcpy(zmq_msg_data(identity), data, size);
+
+    uint32_t handle;
+
+    if (unused.empty()) {
+      handle = identities.size();
+      identities.push_back(identity);
+      hashes.push_back(hash);
+    } else {
+      std::pop_heap(unused.begin(), unused.end(), std::greater<uint32_t>());
+      handle = unused.back();
+      unused.pop_back();
+
+      identities[handle] = identity;
+      hashes[handle] = hash;
+    }
+
+    slots[slot] = handle + 1;
+    peers++;
+
+    return handle;
+  }
+
+  //
+  // ## Copy `Copy(handle, part)`
+  //
+  // Initializes **part** as a copy of **handle**'s identity, ready to be sent. Returns false, leaving **part**
+  // uninitialized, if there's no such peer.
+  //
+  bool IdentityTable::Copy(uint32_t handle, zmq_msg_t *part) {
+    if (handle >= identities.size() || identities[handle] == NULL) {
+      return false;
+    }
+
+    assert(zmq_msg_init(part) == 0);
+    assert(zmq_msg_copy(part, identities[handle]) == 0);
+
+    return true;
+  }
+
+  //
+  // ## Identity `Identity(handle, size)`
+  //
+  // Returns **handle**'s identity, storing its size in **size**, or NULL if there's no such peer.
+  //
+  const char *IdentityTable::Identity(uint32_t handle, size_t *size) {
+    if (handle >= identities.size() || identities[handle] == NULL) {
+      return NULL;
+    }
+
+    *size = zmq_msg_size(identities[handle]);
+    return (const char*)zmq_msg_data(identities[handle]);
+  }
+
+  //
+  // ## Forget `Forget(handle)`
+  //
+  // Removes **handle**, which may then be handed out to another peer. Returns false if there was no such peer.
+  //
+  bool IdentityTable::Forget(uint32_t handle) {
+    if (handle >= identities.size() || identities[handle] == NULL) {
+      return false;
+    }
+
+    zmq_msg_t *identity = identities[handle];
+    size_t mask = slots.size() - 1;
+    size_t hole = Find((const char*)zmq_msg_data(identity), zmq_msg_size(identity), hashes[handle]);
+
+    assert(slots[hole] == handle + 1);
+    slots[hole] = 0;
+
+    // Rather than leaving a tombstone, every peer after the hole that would be found sooner in it is moved there,
+    // which leaves probes exactly as long as if the forgotten peer had never been added.
+    for (size_t slot = (hole + 1) & mask; slots[slot]; slot = (slot + 1) & mask) {
+      size_t home = hashes[slots[slot] - 1] & mask;
+
+      if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+        slots[hole] = slots[slot];
+        slots[slot] = 0;
+        hole = slot;
+      }
+    }
+
+    zmq_msg_close(identity);
+    delete identity;
+
+    identities[handle] = NULL;
+    unused.push_back(handle);
+    std::push_heap(unused.begin(), unused.end(), std::greater<uint32_t>());
+    peers--;
+
+    return true;
+  }
+
+  //
+  // ## Find `Find(data, size, hash)`
+  //
+  // Returns the slot holding the identity of **size** bytes at **data**, or the empty slot it would go in.
+  //
+  size_t IdentityTable::Find(const char *data, size_t size, uint32_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+
+    while (slots[slot]) {
+      uint32_t handle = slots[slot] - 1;
+      zmq_msg_t *identity = identities[handle];
+
+      if (hashes[handle] == hash && zmq_msg_size(identity) == size && memcmp(zmq_msg_data(identity), data, size) == 0) {
+        break;
+      }
+
+      slot = (slot + 1) & mask;
+    }
+
+    return slot;
+  }
+
+  //
+  // ## Grow `Grow()`
+  //
+  // Doubles the number of slots, placing every peer again.
+  //
+  void IdentityTable::Grow() {
+    std::vector<uint32_t> grown(slots.size() * 2, 0);
+    size_t mask = grown.size() - 1;
+
+    for (size_t i = 0; i < slots.size(); i++) {
+      if (slots[i] == 0) {
+        continue;
+      }
+
+      size_t slot = hashes[slots[i] - 1] & mask;
+
+      while (grown[slot]) {
+        slot = (slot + 1) & mask;
+      }
+
+      grown[slot] = slots[i];
+    }
+
+    slots.swap(grown);
+  }
+}
@@ -0,0 +1,89 @@
+#ifndef ZMQSTREAM_IDENTITY_H
+#define ZMQSTREAM_IDENTITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zmq.h>
+
+#include <vector>
+
+namespace zmqstream {
+  //
+  // ## IdentityTable
+  //
+  // Interns the identities of a ROUTER socket's peers as small integer handles, so a peer can be told apart (and
+  // replied to) without turning its identity into a Buffer, let alone a String. Each identity is kept as a ZMQ
+  // message, which replies copy rather than rebuild.
+  //
+  // Identities are found through an open-addressed hash table, which never holds more than half as many peers as it
+  // has slots. Handles are reused once forgotten, lowest first.
+  //
+  class IdentityTable {
+    public:
+      IdentityTable();
+      ~IdentityTable();
+
+      //
+      // ## Intern `Intern(data, size)`
+      //
+      // Returns the handle of the identity of **size** bytes at **data**, adding it if it's new.
+      //
+      uint32_t Intern(const char *data, size_t size);
+
+      //
+      // ## Copy `Copy(handle, part)`
+      //
+      // Initializes **part** as a copy of **handle**'s identity, ready to be sent. Returns false, leaving **part**
+      // uninitialized, if there's no such peer.
+      //
+      bool Copy(uint32_t handle, zmq_msg_t *part);
+
+      //
+      // ## Identity `Identity(handle, size)`
+      //
+      // Returns **handle**'s identity, storing its size in **size**, or NULL if there's no such peer.
+      //
+      const char *Identity(uint32_t handle, size_t *size);
+
+      //
+      // ## Forget `Forget(handle)`
+      //
+      // Removes **handle**, which may then be handed out to another peer. Returns false if there was no such peer.
+      //
+      bool Forget(uint32_t handle);
+
+      size_t Size() const {
+        return peers;
+      }
+
+    protected:
+      // The identity of every handle, or NULL for a forgotten one.
+      std::vector<zmq_msg_t*> identities;
+      std::vector<uint32_t> hashes;
+      // Forgotten handles, kept as a heap so the lowest is reused first.
+      std::vector<uint32_t> unused;
+      // Handles plus one, so 0 marks an empty slot. Always a power of two in size.
+      std::vector<uint32_t> slots;
+      size_t peers;
+
+      //
+      // ## Find `Find(data, size, hash)`
+      //
+      // Returns the slot holding the identity of **size** bytes at **data**, or the empty slot it would go in.
+      //
+      size_t Find(const char *data, size_t size, uint32_t hash) const;
+
+      //
+      // ## Grow `Grow()`
+      //
+      // Doubles the number of slots, placing every peer again.
+      //
+      void Grow();
+
+    private:
+      IdentityTable(const IdentityTable&);
+      IdentityTable& operator=(const IdentityTable&);
+  };
+}
+
+#endif
@@ -0,0 +1,270 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "iothread.h"
+
+namespace zmqstream {
+  //
+  // ## IOThread(socket, ringSize, notify, data)
+  //
+  // Starts a new thread owning **socket**, with Rings of at least **ringSize** frames. **notify** is called on the
+  // main loop, with **data** as its handle's data, whenever there is something new to read or room to write.
+  //
+  IOThread::IOThread(void *socket, size_t ringSize, uv_async_cb notify, void *data)
+      : socket(socket), sleeping(0), stopping(0), incoming(ringSize), outgoing(ringSize), pendingIncoming(0),
+        pendingOutgoing(0) {
+    assert(uv_mutex_init(&lock) == 0);
+    assert(uv_async_init(uv_default_loop(), &notifyHandle, notify) == 0);
+    notifyHandle.data = data;
+
+    // The thread waits on both the socket's ZMQ_FD and this pipe, which the main thread writes to in order to wake it.
+    assert(pipe(wakeFds) == 0);
+    fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, fcntl(wakeFds[1], F_GETFL) | O_NONBLOCK);
+
+    assert(uv_thread_create(&thread, Run, this) == 0);
+  }
+
+  IOThread::~IOThread() {
+    uv_mutex_destroy(&lock);
+  }
+
+  //
+  // ## Close `Close()`
+  //
+  // Stops and joins the thread, discarding any queued frames. The IOThread deletes itself once libuv is done with
+  // it, and should no longer be used. The socket is left open, and belongs to the main thread again.
+  //
+  void IOThread::Close() {
+    char signal = 0;
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_SEQ_CST);
+
+    if (write(wakeFds[1], &signal, 1)) {
+      // Either way, the thread will notice `stopping` the next time it's awake.
+    }
+
+    uv_thread_join(&thread);
+
+    // Published and pending frames alike are still open, and have to be closed before their slots go away.
+    size_t count = incoming.Size() + pendingIncoming;
+    for (size_t i = 0; i < count; i++) {
+      zmq_msg_close(&incoming.At(i)->msg);
+    }
+
+    count = outgoing.Size() + pendingOutgoing;
+    for (size_t i = 0; i < count; i++) {
+      zmq_msg_close(&outgoing.At(i)->msg);
+    }
+
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+
+    notifyHandle.data = this;
+    uv_close((uv_handle_t*)&notifyHandle, Closed);
+  }
+
+  void IOThread::Closed(uv_handle_t *handle) {
+    delete (IOThread*)handle->data;
+  }
+
+  //
+  // ## Recv `Recv(msg)`
+  //
+  // Moves the next received frame into **msg**, behaving like a non-blocking `zmq_msg_recv`.
+  //
+  int IOThread::Recv(zmq_msg_t *msg) {
+    if (incoming.Size() == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    Frame *frame = incoming.At(0);
+
+    zmq_msg_move(msg, &frame->msg);
+    zmq_msg_close(&frame->msg);
+    incoming.Release(1);
+
+    return (int)zmq_msg_size(msg);
+  }
+
+  //
+  // ## Send `Send(msg, flags)`
+  //
+  // Moves **msg** into the outgoing Ring, behaving like a non-blocking `zmq_msg_send`. The message only becomes
+  // visible to the thread once its last frame (without ZMQ_SNDMORE) has been sent.
+  //
+  int IOThread::Send(zmq_msg_t *msg, int flags) {
+    if (Writable() == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    Frame *frame = outgoing.Slot(pendingOutgoing++);
+
+    zmq_msg_init(&frame->msg);
+    zmq_msg_move(&frame->msg, msg);
+    frame->flags = flags & ZMQ_SNDMORE;
+
+    if (!frame->flags) {
+      outgoing.Publish(pendingOutgoing);
+      pendingOutgoing = 0;
+    }
+
+    return (int)zmq_msg_size(&frame->msg);
+  }
+
+  //
+  // ## Writable `Writable()`
+  //
+  // Returns the number of frames that can currently be sent.
+  //
+  size_t IOThread::Writable() {
+    return outgoing.Free() - pendingOutgoing;
+  }
+
+  //
+  // ## Events `Events()`
+  //
+  // Returns the equivalent of ZMQ_EVENTS, as seen by the main thread.
+  //
+  int IOThread::Events() {
+    return (incoming.Size() > 0 ? ZMQ_POLLIN : 0) | (Writable() > 0 ? ZMQ_POLLOUT : 0);
+  }
+
+  //
+  // ## Wake `Wake()`
+  //
+  // Wakes the thread if it's waiting, so it notices changes to the Rings. Must be called after `Recv` and `Send`.
+  //
+  void IOThread::Wake() {
+    char signal = 0;
+
+    // Pairs with the fence in `Run`: either the thread sees our changes to the Rings before it waits, or we see that
+    // it's waiting.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)) {
+      if (write(wakeFds[1], &signal, 1)) {
+        // A full pipe is just as good as a successful write.
+      }
+    }
+  }
+
+  //
+  // ## Run
+  //
+  // The thread's entry point.
+  //
+  void IOThread::Run(void *arg) {
+    IOThread *self = (IOThread*)arg;
+    uv_os_sock_t fd;
+    size_t size = sizeof fd;
+    char drain[64];
+
+    uv_mutex_lock(&self->lock);
+    zmq_getsockopt(self->socket, ZMQ_FD, &fd, &size);
+    uv_mutex_unlock(&self->lock);
+
+    zmq_pollitem_t items[2] = {
+      { NULL, fd, ZMQ_POLLIN, 0 },
+      { NULL, self->wakeFds[0], ZMQ_POLLIN, 0 }
+    };
+
+    while (!__atomic_load_n(&self->stopping, __ATOMIC_SEQ_CST)) {
+      int events = 0;
+      size = sizeof events;
+
+      uv_mutex_lock(&self->lock);
+      bool received = self->ReceiveAll();
+      bool sent = self->SendAll();
+      zmq_getsockopt(self->socket, ZMQ_EVENTS, &events, &size);
+      uv_mutex_unlock(&self->lock);
+
+      if (received || sent) {
+        uv_async_send(&self->notifyHandle);
+      }
+
+      // Like any other user of ZMQ_FD, we may only wait on it once ZMQ_EVENTS says there's nothing left to do.
+      __atomic_store_n(&self->sleeping, 1, __ATOMIC_SEQ_CST);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+      bool canReceive = (events & ZMQ_POLLIN) && self->incoming.Free() > self->pendingIncoming;
+      bool canSend = (events & ZMQ_POLLOUT) && self->outgoing.Size() > 0;
+
+      if (!canReceive && !canSend && !__atomic_load_n(&self->stopping, __ATOMIC_SEQ_CST)) {
+        zmq_poll(items, 2, -1);
+      }
+
+      __atomic_store_n(&self->sleeping, 0, __ATOMIC_SEQ_CST);
+
+      while (read(self->wakeFds[0], drain, sizeof drain) > 0) {
+        // Wake-ups carry no data, so they're simply discarded.
+      }
+    }
+  }
+
+  //
+  // ## ReceiveAll `ReceiveAll()`
+  //
+  // Receives as many frames as the socket has and the incoming Ring can hold. Returns true if a message was
+  // published. Runs on the thread, with the lock held.
+  //
+  bool IOThread::ReceiveAll() {
+    bool published = false;
+
+    while (incoming.Free() > pendingIncoming) {
+      Frame *frame = incoming.Slot(pendingIncoming);
+
+      zmq_msg_init(&frame->msg);
+
+      if (zmq_msg_recv(&frame->msg, socket, ZMQ_DONTWAIT) == -1) {
+        zmq_msg_close(&frame->msg);
+        break;
+      }
+
+      frame->flags = zmq_msg_more(&frame->msg) ? ZMQ_SNDMORE : 0;
+      pendingIncoming++;
+
+      if (!frame->flags) {
+        incoming.Publish(pendingIncoming);
+        pendingIncoming = 0;
+        published = true;
+      }
+    }
+
+    return published;
+  }
+
+  //
+  // ## SendAll `SendAll()`
+  //
+  // Sends as many published frames as the socket will accept. Returns true if any were. Runs on the thread, with
+  // the lock held.
+  //
+  bool IOThread::SendAll() {
+    size_t available = outgoing.Size();
+    size_t count = 0;
+
+    for (; count < available; count++) {
+      Frame *frame = outgoing.At(count);
+
+      if (zmq_msg_send(&frame->msg, socket, frame->flags | ZMQ_DONTWAIT) == -1) {
+        if (zmq_errno() == EAGAIN) {
+          break;
+        }
+
+        // There's nobody to report other errors to, and retrying them forever would stall the Ring.
+        zmq_msg_close(&frame->msg);
+      }
+    }
+
+    if (count > 0) {
+      outgoing.Release(count);
+    }
+
+    return count > 0;
+  }
+}
@@ -0,0 +1,158 @@
+#ifndef ZMQSTREAM_IOTHREAD_H
+#define ZMQSTREAM_IOTHREAD_H
+
+#include <uv.h>
+#include <zmq.h>
+
+#include "ring.h"
+
+namespace zmqstream {
+  //
+  // ## IOThread
+  //
+  // A dedicated native thread that takes ownership of a ZMQ socket, receiving into one Ring and sending from another
+  // so that neither depends on how busy the main thread is. The main thread is woken with a `uv_async_t` whenever
+  // either Ring changes.
+  //
+  // Rings hold frames, but only ever publish whole messages, so the largest message must have fewer frames than the
+  // Ring has slots.
+  //
+  // The socket itself may still be used from the main thread (to connect, set options, etc.), but only while
+  // holding the IOThread's lock (see `IOThread::Guard`).
+  //
+  class IOThread {
+    public:
+      struct Frame {
+        zmq_msg_t msg;
+        int flags;
+      };
+
+      //
+      // ## Guard
+      //
+      // Holds the lock of **thread** for the lifetime of the Guard. A NULL **thread** is allowed, and does nothing.
+      //
+      class Guard {
+        public:
+          Guard(IOThread *thread) : thread(thread) {
+            if (thread) {
+              uv_mutex_lock(&thread->lock);
+            }
+          }
+
+          ~Guard() {
+            if (thread) {
+              uv_mutex_unlock(&thread->lock);
+            }
+          }
+
+        protected:
+          IOThread *thread;
+      };
+
+      //
+      // ## IOThread(socket, ringSize, notify, data)
+      //
+      // Starts a new thread owning **socket**, with Rings of at least **ringSize** frames. **notify** is called on the
+      // main loop, with **data** as its handle's data, whenever there is something new to read or room to write.
+      //
+      IOThread(void *socket, size_t ringSize, uv_async_cb notify, void *data);
+
+      //
+      // ## Close `Close()`
+      //
+      // Stops and joins the thread, discarding any queued frames. The IOThread deletes itself once libuv is done with
+      // it, and should no longer be used. The socket is left open, and belongs to the main thread again.
+      //
+      void Close();
+
+      //
+      // ## Recv `Recv(msg)`
+      //
+      // Moves the next received frame into **msg**, behaving like a non-blocking `zmq_msg_recv`.
+      //
+      int Recv(zmq_msg_t *msg);
+
+      //
+      // ## Send `Send(msg, flags)`
+      //
+      // Moves **msg** into the outgoing Ring, behaving like a non-blocking `zmq_msg_send`. The message only becomes
+      // visible to the thread once its last frame (without ZMQ_SNDMORE) has been sent.
+      //
+      int Send(zmq_msg_t *msg, int flags);
+
+      //
+      // ## Writable `Writable()`
+      //
+      // Returns the number of frames that can currently be sent.
+      //
+      size_t Writable();
+
+      //
+      // ## Events `Events()`
+      //
+      // Returns the equivalent of ZMQ_EVENTS, as seen by the main thread.
+      //
+      int Events();
+
+      //
+      // ## Wake `Wake()`
+      //
+      // Wakes the thread if it's waiting, so it notices changes to the Rings. Must be called after `Recv` and `Send`.
+      //
+      void Wake();
+
+    protected:
+      void *socket;
+      uv_thread_t thread;
+      uv_mutex_t lock;
+      uv_async_t notifyHandle;
+      int wakeFds[2];
+      int sleeping;
+      int stopping;
+
+      Ring<Frame> incoming;
+      Ring<Frame> outgoing;
+      // Frames of a message that have been filled in, but not yet published.
+      size_t pendingIncoming;
+      size_t pendingOutgoing;
+
+      ~IOThread();
+
+      //
+      // ## Run
+      //
+      // The thread's entry point.
+      //
+      static void Run(void *arg);
+
+      //
+      // ## ReceiveAll `ReceiveAll()`
+      //
+      // Receives as many frames as the socket has and the incoming Ring can hold. Returns true if a message was
+      // published. Runs on the thread, with the lock held.
+      //
+      bool ReceiveAll();
+
+      //
+      // ## SendAll `SendAll()`
+      //
+      // Sends as many published frames as the socket will accept. Returns true if any were. Runs on the thread, with
+      // the lock held.
+      //
+      bool SendAll();
+
+      //
+      // ## Closed
+      //
+      // A `uv_close_cb` that deletes the IOThread once its async handle has been closed.
+      //
+      static void Closed(uv_handle_t *handle);
+
+    private:
+      IOThread(const IOThread&);
+      IOThread& operator=(const IOThread&);
+  };
+}
+
+#endif
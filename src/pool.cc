@@ -0,0 +1,140 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+// Slabs beyond this many are given back to the system rather than kept around for reuse.
+#define MAX_FREE_SLABS 4
+
+namespace zmqstream {
+  //
+  // ## FramePool(slabSize, maxFrameSize)
+  //
+  // Creates a new pool of **slabSize**-byte slabs, serving frames of up to **maxFrameSize** bytes.
+  //
+  FramePool::FramePool(size_t slabSize, size_t maxFrameSize)
+      : slabs(0), freeSlabs(0), liveFrames(0), liveBytes(0), slabSize(slabSize), maxFrameSize(maxFrameSize),
+        current(NULL), freeList(NULL), released(false) {
+    assert(maxFrameSize + sizeof(size_t) <= slabSize);
+  }
+
+  FramePool::~FramePool() {
+    while (freeList) {
+      Slab *slab = freeList;
+      freeList = slab->next;
+
+      free(slab->data);
+      delete slab;
+    }
+  }
+
+  //
+  // ## Allocate `Allocate(size, hint)`
+  //
+  // Returns **size** bytes from the current slab, storing the value to pass back to `Free` in **hint**.
+  //
+  char *FramePool::Allocate(size_t size, void **hint) {
+    assert(size <= maxFrameSize);
+
+    // Each frame is prefixed by its size (as `Free` isn't told it), and kept 8-byte aligned.
+    size_t needed = (sizeof(size_t) + size + 7) & ~(size_t)7;
+
+    if (current == NULL || current->used + needed > slabSize) {
+      Slab *full = current;
+      current = NULL;
+
+      if (full && full->live == 0) {
+        Recycle(full);
+      }
+
+      if (freeList) {
+        current = freeList;
+        freeList = current->next;
+        freeSlabs--;
+      } else {
+        current = new Slab;
+        current->pool = this;
+        current->data = (char*)malloc(slabSize);
+        assert(current->data);
+        slabs++;
+      }
+
+      current->used = 0;
+      current->live = 0;
+      current->next = NULL;
+    }
+
+    char *frame = current->data + current->used;
+    *(size_t*)frame = size;
+
+    current->used += needed;
+    current->live++;
+    liveFrames++;
+    liveBytes += size;
+
+    *hint = current;
+    return frame + sizeof(size_t);
+  }
+
+  //
+  // ## Free
+  //
+  // A Buffer `free_callback` releasing a frame returned by `Allocate`.
+  //
+  void FramePool::Free(char *data, void *hint) {
+    Slab *slab = (Slab*)hint;
+    assert(slab);
+
+    FramePool *pool = slab->pool;
+
+    pool->liveFrames--;
+    pool->liveBytes -= *(size_t*)(data - sizeof(size_t));
+
+    // The current slab is still being allocated from, so it's only recycled once it's full.
+    if (--slab->live == 0 && slab != pool->current) {
+      pool->Recycle(slab);
+    }
+
+    if (pool->released && pool->liveFrames == 0) {
+      delete pool;
+    }
+  }
+
+  //
+  // ## Release `Release()`
+  //
+  // Called by the pool's owner once it will no longer `Allocate`. The pool should no longer be used.
+  //
+  void FramePool::Release() {
+    Slab *last = current;
+
+    released = true;
+    current = NULL;
+
+    if (last && last->live == 0) {
+      Recycle(last);
+    }
+
+    if (liveFrames == 0) {
+      delete this;
+    }
+  }
+
+  //
+  // ## Recycle `Recycle(slab)`
+  //
+  // Returns **slab**, which has no live frames left, to the free list (or the system, if the free list is full).
+  //
+  void FramePool::Recycle(Slab *slab) {
+    if (released || freeSlabs >= MAX_FREE_SLABS) {
+      free(slab->data);
+      delete slab;
+      slabs--;
+      return;
+    }
+
+    slab->next = freeList;
+    freeList = slab;
+    freeSlabs++;
+  }
+}
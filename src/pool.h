@@ -0,0 +1,102 @@
+#ifndef ZMQSTREAM_POOL_H
+#define ZMQSTREAM_POOL_H
+
+#include <stddef.h>
+
+namespace zmqstream {
+  //
+  // ## FramePool
+  //
+  // Carves small received frames out of larger slabs, so the receive loop doesn't allocate for each of them. Frames
+  // are bump-allocated from the current slab (each prefixed by its size), and handed to JS as Buffers whose free
+  // callback (`Free`) releases them. Since frames tend to be collected in roughly the order they arrived, a slab is
+  // simply recycled once every frame carved from it has been released.
+  //
+  // The pool belongs to the main thread. It may outlive its owner, as Buffers carved from it can outlive the Socket
+  // that read them: once released by its owner, it deletes itself along with its last slab.
+  //
+  class FramePool {
+    public:
+      struct Slab {
+        FramePool *pool;
+        // Bytes handed out so far.
+        size_t used;
+        // Frames handed out and not yet released.
+        size_t live;
+        Slab *next;
+        char *data;
+      };
+
+      //
+      // ## FramePool(slabSize, maxFrameSize)
+      //
+      // Creates a new pool of **slabSize**-byte slabs, serving frames of up to **maxFrameSize** bytes.
+      //
+      FramePool(size_t slabSize, size_t maxFrameSize);
+
+      //
+      // ## Allocate `Allocate(size, hint)`
+      //
+      // Returns **size** bytes from the current slab, storing the value to pass back to `Free` in **hint**.
+      //
+      char *Allocate(size_t size, void **hint);
+
+      //
+      // ## Free
+      //
+      // A Buffer `free_callback` releasing a frame returned by `Allocate`.
+      //
+      static void Free(char *data, void *hint);
+
+      //
+      // ## Release `Release()`
+      //
+      // Called by the pool's owner once it will no longer `Allocate`. The pool should no longer be used.
+      //
+      void Release();
+
+      size_t MaxFrameSize() const {
+        return maxFrameSize;
+      }
+
+      size_t SlabSize() const {
+        return slabSize;
+      }
+
+      //
+      // ### Occupancy
+      //
+      // Counters describing the pool's current state, for tuning `slabSize` and `maxFrameSize`.
+      //
+      // The number of slabs allocated, whether in use or free.
+      size_t slabs;
+      // The number of slabs waiting to be reused.
+      size_t freeSlabs;
+      // The number of frames handed out and not yet released.
+      size_t liveFrames;
+      // The number of bytes held by those frames.
+      size_t liveBytes;
+
+    protected:
+      size_t slabSize;
+      size_t maxFrameSize;
+      Slab *current;
+      Slab *freeList;
+      bool released;
+
+      ~FramePool();
+
+      //
+      // ## Recycle `Recycle(slab)`
+      //
+      // Returns **slab**, which has no live frames left, to the free list (or the system, if the free list is full).
+      //
+      void Recycle(Slab *slab);
+
+    private:
+      FramePool(const FramePool&);
+      FramePool& operator=(const FramePool&);
+  };
+}
+
+#endif
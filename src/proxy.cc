@@ -0,0 +1,228 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "proxy.h"
+
+namespace zmqstream {
+  // The most messages forwarded in one direction before the thread looks at the other direction (and its state).
+  static const int BATCH_SIZE = 1024;
+
+  //
+  // Returns the ZMQ_EVENTS of **socket**, or 0 if they can't be retrieved.
+  //
+  static int getEvents(void *socket) {
+    int events = 0;
+    size_t size = sizeof events;
+
+    if (zmq_getsockopt(socket, ZMQ_EVENTS, &events, &size) == -1) {
+      return 0;
+    }
+
+    return events;
+  }
+
+  //
+  // ## ProxyThread(frontend, backend, capture)
+  //
+  // Starts a new thread owning **frontend**, **backend** and, if not NULL, **capture**.
+  //
+  ProxyThread::ProxyThread(void *frontend, void *backend, void *capture)
+      : frontendSocket(frontend), backendSocket(backend), captureSocket(capture), state(RUNNING) {
+    this->frontend.messages = 0;
+    this->frontend.bytes = 0;
+    this->backend.messages = 0;
+    this->backend.bytes = 0;
+
+    // Just like IOThread, the thread waits on both the sockets and this pipe, which the main thread writes to.
+    assert(pipe(wakeFds) == 0);
+    fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, fcntl(wakeFds[1], F_GETFL) | O_NONBLOCK);
+
+    assert(uv_thread_create(&thread, Run, this) == 0);
+  }
+
+  ProxyThread::~ProxyThread() {
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+  }
+
+  //
+  // ## Pause `Pause()`
+  //
+  // Stops forwarding messages, leaving them queued in the sockets, until `Resume` is called.
+  //
+  void ProxyThread::Pause() {
+    SetState(PAUSED);
+  }
+
+  //
+  // ## Resume `Resume()`
+  //
+  // Resumes forwarding messages after `Pause`.
+  //
+  void ProxyThread::Resume() {
+    SetState(RUNNING);
+  }
+
+  //
+  // ## Terminate `Terminate()`
+  //
+  // Stops and joins the thread. The sockets are left open, and belong to the main thread again.
+  //
+  void ProxyThread::Terminate() {
+    if (__atomic_load_n(&state, __ATOMIC_SEQ_CST) == TERMINATED) {
+      return;
+    }
+
+    SetState(TERMINATED);
+    uv_thread_join(&thread);
+  }
+
+  //
+  // ## Read `Read(counters, out)`
+  //
+  // Copies **counters**, one of `frontend` or `backend`, into **out**. Safe to call while the thread is running.
+  //
+  void ProxyThread::Read(const Counters *counters, Counters *out) {
+    out->messages = __atomic_load_n(&counters->messages, __ATOMIC_RELAXED);
+    out->bytes = __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+  }
+
+  //
+  // ## SetState `SetState(state)`
+  //
+  // Changes the thread's state, and wakes it so it notices.
+  //
+  void ProxyThread::SetState(int state) {
+    char signal = 0;
+
+    __atomic_store_n(&this->state, state, __ATOMIC_SEQ_CST);
+
+    if (write(wakeFds[1], &signal, 1)) {
+      // A full pipe is just as good as a successful write.
+    }
+  }
+
+  //
+  // ## Run
+  //
+  // The thread's entry point.
+  //
+  void ProxyThread::Run(void *arg) {
+    ProxyThread *self = (ProxyThread*)arg;
+    char drain[64];
+    int state;
+
+    while ((state = __atomic_load_n(&self->state, __ATOMIC_SEQ_CST)) != TERMINATED) {
+      zmq_pollitem_t items[3] = {
+        { self->frontendSocket, 0, 0, 0 },
+        { self->backendSocket, 0, 0, 0 },
+        { NULL, self->wakeFds[0], ZMQ_POLLIN, 0 }
+      };
+
+      if (state == RUNNING) {
+        int frontendEvents = getEvents(self->frontendSocket);
+        int backendEvents = getEvents(self->backendSocket);
+        bool forwarded = false;
+
+        if ((frontendEvents & ZMQ_POLLIN) && (backendEvents & ZMQ_POLLOUT)) {
+          self->Forward(self->frontendSocket, self->backendSocket, &self->frontend);
+          forwarded = true;
+        }
+
+        if ((backendEvents & ZMQ_POLLIN) && (frontendEvents & ZMQ_POLLOUT)) {
+          self->Forward(self->backendSocket, self->frontendSocket, &self->backend);
+          forwarded = true;
+        }
+
+        // Forwarding changes ZMQ_EVENTS, so they have to be checked again before it's safe to wait.
+        if (forwarded) {
+          continue;
+        }
+
+        // Each socket is waited on for input only while its destination has room. Otherwise, it's the destination
+        // that's waited on, for room, but only if the source has something to send.
+        items[0].events = ((backendEvents & ZMQ_POLLOUT) ? ZMQ_POLLIN : 0) |
+                          ((backendEvents & ZMQ_POLLIN) ? ZMQ_POLLOUT : 0);
+        items[1].events = ((frontendEvents & ZMQ_POLLOUT) ? ZMQ_POLLIN : 0) |
+                          ((frontendEvents & ZMQ_POLLIN) ? ZMQ_POLLOUT : 0);
+      }
+
+      zmq_poll(items, 3, -1);
+
+      if (items[2].revents & ZMQ_POLLIN) {
+        while (read(self->wakeFds[0], drain, sizeof drain) > 0) {
+          // Wake-ups carry no data, so they're simply discarded.
+        }
+      }
+    }
+  }
+
+  //
+  // ## Forward `Forward(from, to, counters)`
+  //
+  // Moves up to a batch of whole messages from **from** to **to**, copying them to the capture socket along the
+  // way. Runs on the thread, and may only be called while **to** is writable.
+  //
+  void ProxyThread::Forward(void *from, void *to, Counters *counters) {
+    zmq_msg_t part;
+
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      assert(zmq_msg_init(&part) == 0);
+
+      if (zmq_msg_recv(&part, from, ZMQ_DONTWAIT) == -1) {
+        zmq_msg_close(&part);
+        break;
+      }
+
+      // Once a message's first frame has been refused, the rest of it has to be discarded as well.
+      bool dropped = false;
+      bool captureDropped = captureSocket == NULL;
+      size_t bytes = 0;
+      int more;
+
+      do {
+        more = zmq_msg_more(&part);
+        bytes += zmq_msg_size(&part);
+
+        // The capture socket only gets what it has room for, so a slow listener never holds up the proxy.
+        if (!captureDropped) {
+          zmq_msg_t copy;
+
+          zmq_msg_init(&copy);
+          zmq_msg_copy(&copy, &part);
+
+          if (zmq_msg_send(&copy, captureSocket, (more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT) == -1) {
+            zmq_msg_close(&copy);
+            captureDropped = true;
+          }
+        }
+
+        // ZMQ_EVENTS only says some peer has room, and a ROUTER with ZMQ_ROUTER_MANDATORY blocks on one that doesn't,
+        // which would keep the thread from ever seeing `Terminate`. So a message with nowhere to go (EAGAIN), or one
+        // that's refused outright (e.g. unroutable), is dropped instead, just as `zmq_proxy` would.
+        if (dropped || zmq_msg_send(&part, to, (more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT) == -1) {
+          dropped = true;
+        }
+
+        // The remaining frames of a message always arrive together with the first.
+        if (more && zmq_msg_recv(&part, from, 0) == -1) {
+          break;
+        }
+      } while (more);
+
+      zmq_msg_close(&part);
+
+      if (!dropped) {
+        __atomic_fetch_add(&counters->messages, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&counters->bytes, bytes, __ATOMIC_RELAXED);
+      }
+
+      if (!(getEvents(to) & ZMQ_POLLOUT)) {
+        break;
+      }
+    }
+  }
+}
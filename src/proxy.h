@@ -0,0 +1,119 @@
+#ifndef ZMQSTREAM_PROXY_H
+#define ZMQSTREAM_PROXY_H
+
+#include <stdint.h>
+#include <uv.h>
+#include <zmq.h>
+
+namespace zmqstream {
+  //
+  // ## ProxyThread
+  //
+  // A dedicated native thread shuttling messages between two ZMQ sockets in both directions, optionally copying each
+  // of them to a third "capture" socket, much like `zmq_proxy`. Unlike `zmq_proxy`, it can be paused, resumed and
+  // terminated from the main thread (which signals it through a pipe, the same way IOThread is woken), and it keeps
+  // live counters of the traffic in each direction.
+  //
+  // A source socket is only read from while its destination can be written to, so a slow peer applies backpressure
+  // to the other side rather than being handed messages it would drop.
+  //
+  class ProxyThread {
+    public:
+      //
+      // ### Counters
+      //
+      // Traffic in one direction, updated by the thread and read from the main thread.
+      //
+      struct Counters {
+        uint64_t messages;
+        uint64_t bytes;
+      };
+
+      //
+      // ## ProxyThread(frontend, backend, capture)
+      //
+      // Starts a new thread owning **frontend**, **backend** and, if not NULL, **capture**.
+      //
+      ProxyThread(void *frontend, void *backend, void *capture);
+
+      ~ProxyThread();
+
+      //
+      // ## Pause `Pause()`
+      //
+      // Stops forwarding messages, leaving them queued in the sockets, until `Resume` is called.
+      //
+      void Pause();
+
+      //
+      // ## Resume `Resume()`
+      //
+      // Resumes forwarding messages after `Pause`.
+      //
+      void Resume();
+
+      //
+      // ## Terminate `Terminate()`
+      //
+      // Stops and joins the thread. The sockets are left open, and belong to the main thread again.
+      //
+      void Terminate();
+
+      bool Paused() const {
+        return __atomic_load_n(&state, __ATOMIC_RELAXED) == PAUSED;
+      }
+
+      //
+      // ## Read `Read(counters, out)`
+      //
+      // Copies **counters**, one of `frontend` or `backend`, into **out**. Safe to call while the thread is running.
+      //
+      static void Read(const Counters *counters, Counters *out);
+
+      // Messages received on the frontend (and sent to the backend), and vice versa.
+      Counters frontend;
+      Counters backend;
+
+    protected:
+      enum State {
+        RUNNING,
+        PAUSED,
+        TERMINATED
+      };
+
+      void *frontendSocket;
+      void *backendSocket;
+      void *captureSocket;
+      uv_thread_t thread;
+      int wakeFds[2];
+      int state;
+
+      //
+      // ## SetState `SetState(state)`
+      //
+      // Changes the thread's state, and wakes it so it notices.
+      //
+      void SetState(int state);
+
+      //
+      // ## Run
+      //
+      // The thread's entry point.
+      //
+      static void Run(void *arg);
+
+      //
+      // ## Forward `Forward(from, to, counters)`
+      //
+      // Moves up to a batch of whole messages from **from** to **to**, copying them to the capture socket along the
+      // way. Runs on the thread, and may only be called while **to** is writable.
+      //
+      void Forward(void *from, void *to, Counters *counters);
+
+    private:
+      ProxyThread(const ProxyThread&);
+      ProxyThread& operator=(const ProxyThread&);
+  };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef ZMQSTREAM_RING_H
+#define ZMQSTREAM_RING_H
+
+#include <stddef.h>
+
+namespace zmqstream {
+  //
+  // ## Ring
+  //
+  // A bounded queue shared by exactly one producer thread and one consumer thread, without locks. Each side owns one
+  // index and only ever reads the other's, so acquire/release ordering on those indexes is all the synchronization
+  // required. Slots are exposed directly, allowing values to be built (and consumed) in place.
+  //
+  template <typename T>
+  class Ring {
+    public:
+      Ring(size_t capacity) : mask(0), head(0), tail(0) {
+        size_t size = 1;
+
+        while (size < capacity) {
+          size <<= 1;
+        }
+
+        slots = new T[size];
+        mask = size - 1;
+      }
+
+      ~Ring() {
+        delete[] slots;
+      }
+
+      size_t Capacity() const {
+        return mask + 1;
+      }
+
+      //
+      // ### Producer
+      //
+      // Slots are filled starting at `Slot(0)`, then made visible to the consumer all at once with `Publish`.
+      //
+      size_t Free() const {
+        return Capacity() - (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+      }
+
+      T *Slot(size_t offset) {
+        return &slots[(head + offset) & mask];
+      }
+
+      void Publish(size_t count) {
+        __atomic_store_n(&head, head + count, __ATOMIC_RELEASE);
+      }
+
+      //
+      // ### Consumer
+      //
+      // Published values are read starting at `At(0)`, then handed back to the producer all at once with `Release`.
+      //
+      size_t Size() const {
+        return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - tail;
+      }
+
+      T *At(size_t offset) {
+        return &slots[(tail + offset) & mask];
+      }
+
+      void Release(size_t count) {
+        __atomic_store_n(&tail, tail + count, __ATOMIC_RELEASE);
+      }
+
+    protected:
+      T *slots;
+      size_t mask;
+
+      // The indexes only ever increase, and are padded onto their own cache lines so the two threads don't contend.
+      char headPadding[64];
+      size_t head;
+      char tailPadding[64];
+      size_t tail;
+      char endPadding[64];
+
+    private:
+      Ring(const Ring&);
+      Ring& operator=(const Ring&);
+  };
+}
+
+#endif
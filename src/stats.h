@@ -0,0 +1,94 @@
+#ifndef ZMQSTREAM_STATS_H
+#define ZMQSTREAM_STATS_H
+
+#include <stdint.h>
+#include <string.h>
+
+namespace zmqstream {
+  //
+  // ## SocketStats
+  //
+  // Counters describing what a Socket's hot paths have been doing, for spotting backpressure (writes hitting EAGAIN)
+  // and spinning (checks that emit nothing) in production. They're only ever touched from the main thread, so
+  // they're plain integers, and cost an increment apiece.
+  //
+  struct SocketStats {
+    // The number of buckets in `readBatches`, enough for any batch size a uint32_t can hold.
+    static const int BATCH_BUCKETS = 32;
+
+    // Whole messages, and the bytes of every frame within them, received and sent.
+    uint64_t messagesIn;
+    uint64_t bytesIn;
+    uint64_t messagesOut;
+    uint64_t bytesOut;
+    // Writes refused with EAGAIN, and reads that found nothing to return.
+    uint64_t writeEagains;
+    uint64_t emptyReads;
+    // Events emitted.
+    uint64_t readableEmits;
+    uint64_t drainEmits;
+    // Checks of ZMQ_EVENTS, by what triggered them: a send or recv, the fd being signaled, or an IOThread.
+    uint64_t idleChecks;
+    uint64_t pollChecks;
+    uint64_t asyncChecks;
+    // Checks that emitted nothing at all.
+    uint64_t emptyChecks;
+    // Messages forwarded natively (see `Socket::ForwardTo`), and messages dropped by its rules instead.
+    uint64_t forwarded;
+    uint64_t filtered;
+    // Frames considered for compression (see `Socket::CompressFrame`), their bytes before and after, how many of
+    // them were sent compressed, how many of their messages were compressed on libuv's threadpool, and the time
+    // spent compressing them.
+    uint64_t compressFrames;
+    uint64_t compressBytesIn;
+    uint64_t compressBytesOut;
+    uint64_t compressedFrames;
+    uint64_t compressOffloaded;
+    uint64_t compressNanos;
+    // Compressed frames received, their bytes before and after, corrupt ones, and the time spent decompressing.
+    uint64_t decompressedFrames;
+    uint64_t decompressBytesIn;
+    uint64_t decompressBytesOut;
+    uint64_t decompressErrors;
+    uint64_t decompressNanos;
+    // Busy polls the socket took part in (see `Poller::Spin`), how many of them found a message, and the time spent
+    // in them.
+    uint64_t busyPolls;
+    uint64_t busyPollHits;
+    uint64_t busyPollNanos;
+    // Messages written while ZeroMQ had no room for them, which waited in the outbound queue (see `queueBytes`).
+    uint64_t queuedMessages;
+    // Non-empty reads, by the number of messages returned: bucket `n` counts reads of [2^n, 2^(n+1)) messages.
+    uint64_t readBatches[BATCH_BUCKETS];
+
+    SocketStats() {
+      Reset();
+    }
+
+    void Reset() {
+      memset(this, 0, sizeof *this);
+    }
+
+    //
+    // ## RecordBatch `RecordBatch(messages)`
+    //
+    // Counts a read that returned **messages** messages.
+    //
+    void RecordBatch(uint32_t messages) {
+      int bucket = 0;
+
+      if (messages == 0) {
+        emptyReads++;
+        return;
+      }
+
+      while (messages >>= 1) {
+        bucket++;
+      }
+
+      readBatches[bucket]++;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <string.h>
+
+#include "trace.h"
+
+namespace zmqstream {
+  // Like the batch marker, this starts with a byte that never starts valid UTF-8 text.
+  const char TRACE_MARKER[] = "\xffZT";
+  const size_t TRACE_MARKER_SIZE = sizeof TRACE_MARKER - 1;
+  const size_t TRACE_FRAME_SIZE = TRACE_MARKER_SIZE + 8;
+
+  //
+  // ## EncodeTrace `EncodeTrace(out, nanos)`
+  //
+  // Stores a trace frame for **nanos** in **out**, which must hold `TRACE_FRAME_SIZE` bytes.
+  //
+  void EncodeTrace(char *out, uint64_t nanos) {
+    memcpy(out, TRACE_MARKER, TRACE_MARKER_SIZE);
+
+    for (size_t i = 0; i < 8; i++) {
+      out[TRACE_MARKER_SIZE + i] = (char)(nanos >> (56 - i * 8));
+    }
+  }
+
+  //
+  // ## DecodeTrace `DecodeTrace(data, size, nanos)`
+  //
+  // Returns true, storing its time in **nanos**, if the **size** bytes at **data** are a trace frame.
+  //
+  bool DecodeTrace(const void *data, size_t size, uint64_t *nanos) {
+    const unsigned char *bytes = (const unsigned char*)data;
+
+    if (size != TRACE_FRAME_SIZE || memcmp(bytes, TRACE_MARKER, TRACE_MARKER_SIZE) != 0) {
+      return false;
+    }
+
+    *nanos = 0;
+
+    for (size_t i = 0; i < 8; i++) {
+      *nanos = (*nanos << 8) | bytes[TRACE_MARKER_SIZE + i];
+    }
+
+    return true;
+  }
+
+  LatencyHistogram::LatencyHistogram() {
+    Reset();
+  }
+
+  //
+  // ## Record `Record(nanos)`
+  //
+  // Counts a duration of **nanos** nanoseconds.
+  //
+  void LatencyHistogram::Record(uint64_t nanos) {
+    counts[Index(nanos)]++;
+
+    if (count == 0 || nanos < min) {
+      min = nanos;
+    }
+
+    if (nanos > max) {
+      max = nanos;
+    }
+
+    count++;
+    sum += nanos;
+  }
+
+  //
+  // ## Percentile `Percentile(percentile)`
+  //
+  // Returns the largest duration, to the histogram's precision, of the fastest **percentile** percent of those
+  // counted. Returns 0 if there are none.
+  //
+  uint64_t LatencyHistogram::Percentile(double percentile) const {
+    if (count == 0) {
+      return 0;
+    }
+
+    // The rank of the value wanted, counting from 1.
+    uint64_t rank = (uint64_t)(percentile / 100 * count + 0.5);
+    uint64_t seen = 0;
+
+    rank = rank < 1 ? 1 : rank > count ? count : rank;
+
+    for (int i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+
+      if (seen >= rank) {
+        // No bucket reports more than the largest value actually recorded.
+        uint64_t highest = Highest(i);
+        return highest < max ? highest : max;
+      }
+    }
+
+    return max;
+  }
+
+  //
+  // ## Reset `Reset()`
+  //
+  // Forgets every duration counted so far.
+  //
+  void LatencyHistogram::Reset() {
+    memset(counts, 0, sizeof counts);
+    count = 0;
+    sum = 0;
+    min = 0;
+    max = 0;
+  }
+
+  //
+  // ## Index `Index(nanos)`
+  //
+  // Returns the bucket counting **nanos**.
+  //
+  int LatencyHistogram::Index(uint64_t nanos) {
+    if (nanos < (uint64_t)SUB_BUCKETS) {
+      return (int)nanos;
+    }
+
+    if (nanos >> MAX_BITS) {
+      return BUCKETS - 1;
+    }
+
+    // Halving the value until it fits in `SUB_BUCKETS` leaves it in the top half, so only that half is indexed
+    // beyond the first, exact, range.
+    int shift = (63 - __builtin_clzll(nanos)) - (SUB_BUCKET_BITS - 1);
+
+    return shift * (SUB_BUCKETS / 2) + (int)(nanos >> shift);
+  }
+
+  //
+  // ## Highest `Highest(index)`
+  //
+  // Returns the largest value counted by the bucket at **index**.
+  //
+  uint64_t LatencyHistogram::Highest(int index) {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+
+    int shift = index / (SUB_BUCKETS / 2) - 1;
+    uint64_t sub = index - shift * (SUB_BUCKETS / 2);
+
+    return ((sub + 1) << shift) - 1;
+  }
+}
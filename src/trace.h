@@ -0,0 +1,112 @@
+#ifndef ZMQSTREAM_TRACE_H
+#define ZMQSTREAM_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace zmqstream {
+  //
+  // ## Trace frames
+  //
+  // A tracing socket appends a trace frame to every message it sends: `TRACE_MARKER`, followed by the monotonic
+  // time the message was written, in nanoseconds, as a 64-bit big-endian integer. Tracing sockets strip the frame
+  // from the messages they read, and record how long ago that was.
+  //
+  extern const char TRACE_MARKER[];
+  extern const size_t TRACE_MARKER_SIZE;
+  extern const size_t TRACE_FRAME_SIZE;
+
+  //
+  // ## EncodeTrace `EncodeTrace(out, nanos)`
+  //
+  // Stores a trace frame for **nanos** in **out**, which must hold `TRACE_FRAME_SIZE` bytes.
+  //
+  void EncodeTrace(char *out, uint64_t nanos);
+
+  //
+  // ## DecodeTrace `DecodeTrace(data, size, nanos)`
+  //
+  // Returns true, storing its time in **nanos**, if the **size** bytes at **data** are a trace frame.
+  //
+  bool DecodeTrace(const void *data, size_t size, uint64_t *nanos);
+
+  //
+  // ## LatencyHistogram
+  //
+  // Counts durations in nanoseconds, in the manner of an HDR histogram: values below `SUB_BUCKETS` are counted
+  // exactly, and larger ones in buckets that double in size with each power of two, each split into
+  // `SUB_BUCKETS / 2` sub-buckets. Every value is therefore recorded to within 1/64th (about 1.6%) of itself, in a
+  // fixed amount of memory, and recording never allocates.
+  //
+  class LatencyHistogram {
+    public:
+      static const int SUB_BUCKET_BITS = 7;
+      static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+      // Values of 2^MAX_BITS nanoseconds (a day and a half) or more are counted as the largest bucket.
+      static const int MAX_BITS = 47;
+      static const int BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 2) * (SUB_BUCKETS / 2);
+
+      LatencyHistogram();
+
+      //
+      // ## Record `Record(nanos)`
+      //
+      // Counts a duration of **nanos** nanoseconds.
+      //
+      void Record(uint64_t nanos);
+
+      //
+      // ## Percentile `Percentile(percentile)`
+      //
+      // Returns the largest duration, to the histogram's precision, of the fastest **percentile** percent of those
+      // counted. Returns 0 if there are none.
+      //
+      uint64_t Percentile(double percentile) const;
+
+      //
+      // ## Reset `Reset()`
+      //
+      // Forgets every duration counted so far.
+      //
+      void Reset();
+
+      uint64_t Count() const {
+        return count;
+      }
+
+      uint64_t Min() const {
+        return count > 0 ? min : 0;
+      }
+
+      uint64_t Max() const {
+        return max;
+      }
+
+      double Mean() const {
+        return count > 0 ? (double)sum / count : 0;
+      }
+
+    protected:
+      uint64_t counts[BUCKETS];
+      uint64_t count;
+      uint64_t sum;
+      uint64_t min;
+      uint64_t max;
+
+      //
+      // ## Index `Index(nanos)`
+      //
+      // Returns the bucket counting **nanos**.
+      //
+      static int Index(uint64_t nanos);
+
+      //
+      // ## Highest `Highest(index)`
+      //
+      // Returns the largest value counted by the bucket at **index**.
+      //
+      static uint64_t Highest(int index);
+  };
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "trie.h"
+
+namespace zmqstream {
+  SubscriptionTrie::SubscriptionTrie() : subscriptions(0) {
+    memset(&root, 0, sizeof root);
+  }
+
+  SubscriptionTrie::~SubscriptionTrie() {
+    Destroy(&root);
+  }
+
+  //
+  // ## Add `Add(prefix, size)`
+  //
+  // Adds a reference to the subscription **prefix** of **size** bytes. Returns true if it's a new subscription.
+  //
+  bool SubscriptionTrie::Add(const char *prefix, size_t size) {
+    Node *node = &root;
+
+    for (size_t i = 0; i < size; i++) {
+      node = AddChild(node, (unsigned char)prefix[i]);
+    }
+
+    if (node->refs++ > 0) {
+      return false;
+    }
+
+    subscriptions++;
+    return true;
+  }
+
+  //
+  // ## Remove `Remove(prefix, size)`
+  //
+  // Removes a reference to the subscription **prefix** of **size** bytes. Returns true if that was the last one,
+  // and false if there are more, or there were none to begin with.
+  //
+  bool SubscriptionTrie::Remove(const char *prefix, size_t size) {
+    // Topics can be long, so the path is kept on the heap rather than the stack.
+    std::vector<Node*> path;
+    Node *node = &root;
+
+    path.reserve(size + 1);
+    path.push_back(node);
+
+    for (size_t i = 0; i < size; i++) {
+      node = Child(node, (unsigned char)prefix[i]);
+
+      if (node == NULL) {
+        return false;
+      }
+
+      path.push_back(node);
+    }
+
+    if (node->refs == 0 || --node->refs > 0) {
+      return false;
+    }
+
+    subscriptions--;
+
+    // Nodes that no longer lead to any subscription are pruned, from the end of the prefix back.
+    for (size_t i = size; i > 0; i--) {
+      Node *child = path[i];
+      Node *parent = path[i - 1];
+
+      if (child->refs > 0 || child->live > 0) {
+        break;
+      }
+
+      Destroy(child);
+      free(child);
+
+      parent->next[(unsigned char)prefix[i - 1] - parent->min] = NULL;
+
+      if (--parent->live == 0) {
+        free(parent->next);
+        parent->next = NULL;
+        parent->count = 0;
+      }
+    }
+
+    return true;
+  }
+
+  //
+  // ## Matches `Matches(topic, size)`
+  //
+  // Returns true if any subscription is a prefix of **topic**, of **size** bytes.
+  //
+  bool SubscriptionTrie::Matches(const char *topic, size_t size) const {
+    const Node *node = &root;
+
+    for (size_t i = 0; node->refs == 0; i++) {
+      if (i == size || (node = Child(node, (unsigned char)topic[i])) == NULL) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //
+  // ## Clear `Clear()`
+  //
+  // Removes every subscription.
+  //
+  void SubscriptionTrie::Clear() {
+    Destroy(&root);
+    memset(&root, 0, sizeof root);
+    subscriptions = 0;
+  }
+
+  //
+  // ## AddChild `AddChild(node, byte)`
+  //
+  // Returns the child of **node** for **byte**, creating it (and growing the table) if needed.
+  //
+  SubscriptionTrie::Node *SubscriptionTrie::AddChild(Node *node, unsigned char byte) {
+    Node *child = Child(node, byte);
+
+    if (child) {
+      return child;
+    }
+
+    if (node->count == 0) {
+      node->min = byte;
+      node->count = 1;
+      node->next = (Node**)calloc(1, sizeof(Node*));
+      assert(node->next);
+    } else if (byte < node->min) {
+      // The table grows downwards, so the existing children move up.
+      uint16_t grow = node->min - byte;
+
+      node->next = (Node**)realloc(node->next, (node->count + grow) * sizeof(Node*));
+      assert(node->next);
+      memmove(node->next + grow, node->next, node->count * sizeof(Node*));
+      memset(node->next, 0, grow * sizeof(Node*));
+
+      node->min = byte;
+      node->count += grow;
+    } else if (byte >= node->min + node->count) {
+      uint16_t count = byte - node->min + 1;
+
+      node->next = (Node**)realloc(node->next, count * sizeof(Node*));
+      assert(node->next);
+      memset(node->next + node->count, 0, (count - node->count) * sizeof(Node*));
+
+      node->count = count;
+    }
+
+    child = (Node*)malloc(sizeof(Node));
+    assert(child);
+    memset(child, 0, sizeof *child);
+
+    node->next[byte - node->min] = child;
+    node->live++;
+
+    return child;
+  }
+
+  //
+  // ## Destroy `Destroy(node)`
+  //
+  // Frees every descendant of **node**, leaving it without children.
+  //
+  void SubscriptionTrie::Destroy(Node *node) {
+    // Like `Remove`, this walks the trie without recursing, however deep it is.
+    std::vector<Node*> pending;
+
+    pending.push_back(node);
+
+    while (!pending.empty()) {
+      Node *current = pending.back();
+      pending.pop_back();
+
+      for (uint16_t i = 0; i < current->count; i++) {
+        if (current->next[i]) {
+          pending.push_back(current->next[i]);
+        }
+      }
+
+      free(current->next);
+
+      if (current != node) {
+        free(current);
+      }
+    }
+
+    node->next = NULL;
+    node->count = 0;
+    node->live = 0;
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef ZMQSTREAM_TRIE_H
+#define ZMQSTREAM_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace zmqstream {
+  //
+  // ## SubscriptionTrie
+  //
+  // A byte-wise prefix trie of subscriptions, each with a reference count, mirroring what an XPUB socket's
+  // subscribers have asked for. Like libzmq's own, each node's children are a table indexed by byte, covering only the
+  // range of bytes in use, so `Matches` costs one table lookup per byte of the topic and never allocates.
+  //
+  class SubscriptionTrie {
+    public:
+      SubscriptionTrie();
+      ~SubscriptionTrie();
+
+      //
+      // ## Add `Add(prefix, size)`
+      //
+      // Adds a reference to the subscription **prefix** of **size** bytes. Returns true if it's a new subscription.
+      //
+      bool Add(const char *prefix, size_t size);
+
+      //
+      // ## Remove `Remove(prefix, size)`
+      //
+      // Removes a reference to the subscription **prefix** of **size** bytes. Returns true if that was the last one,
+      // and false if there are more, or there were none to begin with.
+      //
+      bool Remove(const char *prefix, size_t size);
+
+      //
+      // ## Matches `Matches(topic, size)`
+      //
+      // Returns true if any subscription is a prefix of **topic**, of **size** bytes.
+      //
+      bool Matches(const char *topic, size_t size) const;
+
+      //
+      // ## Clear `Clear()`
+      //
+      // Removes every subscription.
+      //
+      void Clear();
+
+      size_t Size() const {
+        return subscriptions;
+      }
+
+    protected:
+      struct Node {
+        // References to the subscription ending at this node.
+        uint32_t refs;
+        // The table of children covers the bytes [min, min + count).
+        unsigned char min;
+        uint16_t count;
+        // Children in the table that aren't NULL.
+        uint16_t live;
+        Node **next;
+      };
+
+      Node root;
+      // Distinct subscriptions, i.e. nodes with references.
+      size_t subscriptions;
+
+      //
+      // ## Child `Child(node, byte)`
+      //
+      // Returns the child of **node** for **byte**, or NULL.
+      //
+      static Node *Child(const Node *node, unsigned char byte) {
+        unsigned int index = (unsigned int)byte - node->min;
+
+        return index < node->count ? node->next[index] : NULL;
+      }
+
+      //
+      // ## AddChild `AddChild(node, byte)`
+      //
+      // Returns the child of **node** for **byte**, creating it (and growing the table) if needed.
+      //
+      static Node *AddChild(Node *node, unsigned char byte);
+
+      //
+      // ## Destroy `Destroy(node)`
+      //
+      // Frees every descendant of **node**, leaving it without children.
+      //
+      static void Destroy(Node *node);
+
+    private:
+      SubscriptionTrie(const SubscriptionTrie&);
+      SubscriptionTrie& operator=(const SubscriptionTrie&);
+  };
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <deque>
 
 #include "zmqstream.h"
 
@@ -11,24 +12,106 @@ using namespace v8;
 using namespace node;
 
 namespace zmqstream {
-  // TODO: Is there any reason to have more than one Context?
-  // Would that make managing blocking sockets (REQ, DEALER, PUSH) easier?
+  // The shared context's bookkeeping has to be in place before `gContext` takes the first reference.
+  uv_once_t ScopedContext::lockOnce = UV_ONCE_INIT;
+  uv_mutex_t ScopedContext::lock;
+  void *ScopedContext::shared = NULL;
+  int ScopedContext::references = 0;
+  // Keeps the shared context alive for as long as the module is loaded.
   ScopedContext gContext;
+  Persistent<FunctionTemplate> Socket::constructorTemplate;
   Persistent<Function> Socket::constructor;
+  Persistent<String> Socket::emitSymbol;
+  Persistent<String> Socket::readableSymbol;
+  Persistent<String> Socket::drainSymbol;
+  Persistent<Function> Proxy::constructor;
+  Persistent<FunctionTemplate> Context::constructorTemplate;
+  Persistent<Function> Context::constructor;
+  PinnedBuffer *PinnedBuffer::released = NULL;
+  uv_mutex_t PinnedBuffer::releasedLock;
+  uv_async_t PinnedBuffer::releasedHandle;
+  uv_idle_t Poller::idleHandle;
+  uv_prepare_t Poller::prepareHandle;
+  uv_check_t Poller::checkHandle;
+  Socket *Poller::dirty = NULL;
+  Socket *Poller::checking = NULL;
+  std::vector<Socket*> Poller::spinners;
+  std::vector<Socket*> Poller::spinning;
 
   //
   // ## ScopedContext
   //
-  // At the moment, there's a 1:1 relationship between Node processes and ZMQ contexts. This scope-based wrapper
-  // is used to ensure that global context is managed properly over the life of that process.
+  // The default ZMQ context is held by the process rather than by the module, so the native threads working on its
+  // behalf (`ioThread` sockets and proxies) share it, `inproc://` endpoints included. Loading the addon into more than
+  // one isolate isn't supported yet. It's created by the first reference and terminated once the last is released.
   //
   ScopedContext::ScopedContext() {
-    context = zmq_ctx_new();
-    assert(context != 0);
+    context = Acquire();
   }
 
   ScopedContext::~ScopedContext() {
-    assert(zmq_ctx_destroy(context) == 0 || zmq_errno() == EINTR);
+    Release();
+  }
+
+  void ScopedContext::InitLock() {
+    assert(uv_mutex_init(&lock) == 0);
+  }
+
+  //
+  // ## Acquire `Acquire()`
+  //
+  // Returns the shared context, creating it if there are no references to it yet, and adds a reference.
+  //
+  void *ScopedContext::Acquire() {
+    uv_once(&lockOnce, InitLock);
+    uv_mutex_lock(&lock);
+
+    if (references++ == 0) {
+      shared = zmq_ctx_new();
+      assert(shared != 0);
+    }
+
+    void *context = shared;
+    uv_mutex_unlock(&lock);
+
+    return context;
+  }
+
+  //
+  // ## Release `Release()`
+  //
+  // Removes a reference to the shared context, terminating it if that was the last one.
+  //
+  void ScopedContext::Release() {
+    uv_mutex_lock(&lock);
+    assert(references > 0);
+
+    void *context = NULL;
+
+    if (--references == 0) {
+      context = shared;
+      shared = NULL;
+    }
+
+    uv_mutex_unlock(&lock);
+
+    // Terminating blocks until every socket in the context is closed, so it's done outside the lock.
+    if (context) {
+      assert(zmq_ctx_destroy(context) == 0 || zmq_errno() == EINTR);
+    }
+  }
+
+  //
+  // ## References `References()`
+  //
+  // Returns the number of references to the shared context.
+  //
+  int ScopedContext::References() {
+    uv_mutex_lock(&lock);
+    int count = references;
+    uv_mutex_unlock(&lock);
+
+    return count;
   }
 
   //
@@ -39,6 +122,7 @@ namespace zmqstream {
   #define THROW(str) return ThrowException(Exception::Error(String::New(str)));
   #define THROW_REF(str) return ThrowException(Exception::ReferenceError(String::New(str)));
   #define THROW_TYPE(str) return ThrowException(Exception::TypeError(String::New(str)));
+  #define THROW_RANGE(str) return ThrowException(Exception::RangeError(String::New(str)));
 
   //
   // ZMQ provides its own error messages, so we'll pass those through to V8.
@@ -84,43 +168,131 @@ namespace zmqstream {
   }
 
   //
-  // ## Socket
+  // Copies the bytes of **value**, either a Buffer or a String, into **out**.
   //
-  // Much like the native `net` module, a ZMQStream socket (perhaps obviously) is really just a Duplex stream that
-  // you can `connect`, `bind`, etc. just like a native ZMQ socket.
+  static void toBytes(Handle<Value> value, std::string *out) {
+    if (Buffer::HasInstance(value)) {
+      out->assign(Buffer::Data(value->ToObject()), Buffer::Length(value->ToObject()));
+    } else {
+      String::Utf8Value string(value->ToString());
+      out->assign(*string, string.length());
+    }
+  }
+
+  // The most messages forwarded (or subscriptions consumed) by a single check, so one busy socket can't starve the
+  // rest of the loop.
+  static const int FORWARD_BATCH_SIZE = 256;
+
   //
-  Socket::Socket(int type) : ObjectWrap(), shouldDrain(false), shouldReadable(true) {
-    this->socket = zmq_socket(gContext.context, type);
-    assert(this->socket != 0);
+  // How much a single `Read` or `ReadFlat` may consume before returning, so a deep queue is delivered over several
+  // ticks instead of stalling the loop. Limits are only checked between messages, so the last one may overshoot.
+  //
+  struct ReadBudget {
+    // The most messages, or -1 for no limit.
+    int messages;
+    // The most bytes and nanoseconds, or 0 for no limit.
+    size_t bytes;
+    uint64_t nanos;
+    uint64_t start;
+    // True if the budget came from an Object, in which case a read it cuts short is followed by `'readable'`.
+    bool rearm;
+
+    ReadBudget() : messages(-1), bytes(0), nanos(0), start(0), rearm(false) {
+    }
 
-    uv_os_sock_t fd;
-    size_t size = sizeof fd;
-    zmq_getsockopt(this->socket, ZMQ_FD, &fd, &size);
+    //
+    // Returns true once **read** bytes, or the time since the read started, use up the budget.
+    //
+    bool Spent(size_t read) const {
+      return (bytes > 0 && read >= bytes) || (nanos > 0 && uv_hrtime() - start >= nanos);
+    }
+  };
 
-    assert(uv_poll_init_socket(uv_default_loop(), &readableHandle, fd) == 0);
-    readableHandle.data = this;
-    assert(uv_poll_init_socket(uv_default_loop(), &writableHandle, fd) == 0);
-    writableHandle.data = this;
-    assert(uv_idle_init(uv_default_loop(), &idleHandle) == 0);
-    idleHandle.data = this;
+  //
+  // Reads the **value** passed to `Read` or `ReadFlat` into **budget**: either a number of messages, or an Object
+  // with any of `maxMessages`, `maxBytes` and `maxMicros`.
+  //
+  static void toBudget(Handle<Value> value, ReadBudget *budget) {
+    if (!value->IsObject()) {
+      budget->messages = value->ToInteger()->Value();
+      return;
+    }
+
+    Local<Object> options = value->ToObject();
+    Local<Value> maxMessages = options->Get(String::NewSymbol("maxMessages"));
+    int64_t maxBytes = options->Get(String::NewSymbol("maxBytes"))->ToInteger()->Value();
+    int64_t maxMicros = options->Get(String::NewSymbol("maxMicros"))->ToInteger()->Value();
+
+    if (!maxMessages->IsUndefined()) {
+      budget->messages = maxMessages->ToInteger()->Value();
+    }
+
+    budget->bytes = maxBytes > 0 ? maxBytes : 0;
+    budget->nanos = maxMicros > 0 ? maxMicros * 1000 : 0;
+    budget->rearm = true;
+
+    if (budget->nanos > 0) {
+      budget->start = uv_hrtime();
+    }
   }
 
-  Socket::~Socket() {
-    if (this->socket) {
-      assert(zmq_close(this->socket) == 0);
+  //
+  // Points **data** at the memory behind **value**, a Buffer, ArrayBuffer or typed array, and stores its size in
+  // bytes in **size**. Returns false if **value** is none of those.
+  //
+  static bool toExternalBytes(Handle<Value> value, char **data, size_t *size) {
+    if (!value->IsObject() || !value->ToObject()->HasIndexedPropertiesInExternalArrayData()) {
+      return false;
+    }
+
+    Local<Object> object = value->ToObject();
+    size_t width;
+
+    switch (object->GetIndexedPropertiesExternalArrayDataType()) {
+      case kExternalShortArray:
+      case kExternalUnsignedShortArray:
+        width = 2;
+        break;
+      case kExternalIntArray:
+      case kExternalUnsignedIntArray:
+      case kExternalFloatArray:
+        width = 4;
+        break;
+      case kExternalDoubleArray:
+        width = 8;
+        break;
+      default:
+        width = 1;
     }
 
-    uv_close((uv_handle_t*)&writableHandle, NULL);
-    uv_close((uv_handle_t*)&readableHandle, NULL);
-    uv_close((uv_handle_t*)&idleHandle, NULL);
+    *data = (char*)object->GetIndexedPropertiesExternalArrayData();
+    *size = object->GetIndexedPropertiesExternalArrayDataLength() * width;
+
+    return true;
   }
 
   //
-  // ## Socket(options)
+  // ## Context
   //
-  // Creates a new **options.type** ZMQ socket. Defaults to PAIR.
+  // A ZMQ context, owning the I/O threads that handle its sockets' traffic. Sockets are created within the
+  // process-wide default context unless given a Context of their own, which is useful when a process needs more I/O
+  // threads than the default, or needs to pin sockets (see `ZMQ_AFFINITY`) and threads to specific cores.
   //
-  Handle<Value> Socket::New(const Arguments& args) {
+  Context::Context(void *context) : ObjectWrap(), context(context), sockets(0) {
+  }
+
+  Context::~Context() {
+    if (context) {
+      zmq_ctx_destroy(context);
+    }
+  }
+
+  //
+  // ## Context(options)
+  //
+  // Creates a new ZMQ context, configured by **options**.
+  //
+  Handle<Value> Context::New(const Arguments& args) {
     HandleScope scope;
 
     if (!args.IsConstructCall()) {
@@ -136,206 +308,1245 @@ namespace zmqstream {
       options = args[0]->ToObject();
     }
 
-    Handle<Integer> type = options->Get(String::NewSymbol("type"))->ToInteger();
-    int32_t hwm = options->Get(String::NewSymbol("highWaterMark"))->ToInteger()->Int32Value();
+    int32_t ioThreads = options->Get(String::NewSymbol("ioThreads"))->ToInteger()->Int32Value();
+    int32_t maxSockets = options->Get(String::NewSymbol("maxSockets"))->ToInteger()->Int32Value();
+    Handle<Value> threadPriority = options->Get(String::NewSymbol("threadPriority"));
+    Handle<Value> threadSchedPolicy = options->Get(String::NewSymbol("threadSchedPolicy"));
+    Handle<Value> threadCpus = options->Get(String::NewSymbol("threadCpus"));
 
-    // Creates a new instance object of this type and wraps it.
-    Socket* self = new Socket(type->Value());
+    if (!threadCpus->IsUndefined() && !threadCpus->IsArray()) {
+      THROW_TYPE("threadCpus must be an Array of CPU numbers.");
+    }
+
+    void *context = zmq_ctx_new();
+
+    if (context == NULL) {
+      ZMQ_THROW();
+    }
+
+    Context *self = new Context(context);
     assert(self);
     self->Wrap(args.This());
-    self->Ref();
 
-    if (hwm > 0) {
-      ZMQ_CHECK(zmq_setsockopt(self->socket, ZMQ_SNDHWM, &hwm, sizeof hwm));
-      ZMQ_CHECK(zmq_setsockopt(self->socket, ZMQ_RCVHWM, &hwm, sizeof hwm));
+    // These have to be set before the first socket is created, which is why they're only available as options.
+    if (ioThreads > 0) {
+      ZMQ_CHECK(zmq_ctx_set(context, ZMQ_IO_THREADS, ioThreads));
     }
 
-    // Establishes initial property values.
-    args.This()->Set(String::NewSymbol("type"), type);
+    if (maxSockets > 0) {
+      ZMQ_CHECK(zmq_ctx_set(context, ZMQ_MAX_SOCKETS, maxSockets));
+    }
 
-    // If we've had a super"class" provided, be sure to call its constructor.
-    Handle<Value> super = constructor->Get(String::NewSymbol("super_"));
-    if (super->IsFunction()) {
-      super->ToObject()->CallAsFunction(args.This(), 0, NULL);
+    if (!threadPriority->IsUndefined()) {
+#ifdef ZMQ_THREAD_PRIORITY
+      ZMQ_CHECK(zmq_ctx_set(context, ZMQ_THREAD_PRIORITY, threadPriority->Int32Value()));
+#else
+      THROW("threadPriority requires ZeroMQ 4.1 or newer.");
+#endif
+    }
+
+    if (!threadSchedPolicy->IsUndefined()) {
+#ifdef ZMQ_THREAD_SCHED_POLICY
+      ZMQ_CHECK(zmq_ctx_set(context, ZMQ_THREAD_SCHED_POLICY, threadSchedPolicy->Int32Value()));
+#else
+      THROW("threadSchedPolicy requires ZeroMQ 4.1 or newer.");
+#endif
     }
 
+    if (threadCpus->IsArray()) {
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+      Handle<Array> cpus = Handle<Array>::Cast(threadCpus);
+
+      for (uint32_t i = 0; i < cpus->Length(); i++) {
+        ZMQ_CHECK(zmq_ctx_set(context, ZMQ_THREAD_AFFINITY_CPU_ADD, cpus->Get(i)->Int32Value()));
+      }
+#else
+      THROW("threadCpus requires ZeroMQ 4.3 or newer.");
+#endif
+    }
+
+    // Establishes initial property values.
+    args.This()->Set(String::NewSymbol("ioThreads"), Integer::New(zmq_ctx_get(context, ZMQ_IO_THREADS)));
+    args.This()->Set(String::NewSymbol("maxSockets"), Integer::New(zmq_ctx_get(context, ZMQ_MAX_SOCKETS)));
+
     return args.This();
   }
 
   //
   // ## Close `Close()`
   //
-  // Closes the underlying ZMQ socket. _The stream should no longer be used!_
+  // Terminates the underlying ZMQ context. Every Socket created within it must already be closed, as
+  // `zmq_ctx_destroy` would otherwise block until they are.
   //
-  Handle<Value> Socket::Close(const Arguments& args) {
+  Handle<Value> Context::Close(const Arguments& args) {
     HandleScope scope;
-    Socket *self = THIS_TO_SOCKET(args.This());
+    Context *self = ObjectWrap::Unwrap<Context>(args.This());
     assert(self);
 
-    void *socket = self->socket;
-
-    uv_poll_stop(&self->readableHandle);
-    uv_poll_stop(&self->writableHandle);
-    uv_idle_stop(&self->idleHandle);
+    void *context = self->context;
 
-    if (socket == NULL) {
+    if (context == NULL) {
       return scope.Close(Undefined());
     }
 
-    self->socket = NULL;
-    self->Unref();
+    // They could only be closed from this thread, which `zmq_ctx_destroy` would block forever.
+    if (self->sockets > 0) {
+      THROW_REF("Context has open sockets, and cannot be closed.");
+    }
+
+    self->context = NULL;
 
-    ZMQ_CHECK(zmq_close(socket));
+    ZMQ_CHECK(zmq_ctx_destroy(context));
 
     return scope.Close(Undefined());
   }
 
   //
-  // ## SetOption `SetOption(option, value)`
+  // ## HasInstance `HasInstance(value)`
   //
-  // Sets a ZMQ-specific option on the underlying ZMQ socket.
+  // Returns true if **value** is a Context.
   //
-  Handle<Value> Socket::SetOption(const Arguments& args) {
-    HandleScope scope;
-    Socket *self = THIS_TO_SOCKET(args.This());
-    assert(self);
+  bool Context::HasInstance(Handle<Value> value) {
+    return value->IsObject() && constructorTemplate->HasInstance(value);
+  }
 
-    if (self->socket == NULL) {
-      THROW_REF("Socket is closed, and options cannot be set.");
-    }
+  //
+  // ## Initialize
+  //
+  // Creates and populates the constructor Function and its prototype.
+  //
+  void Context::Initialize() {
+    Local<FunctionTemplate> tpl(FunctionTemplate::New(New));
 
-    if (args.Length() < 1 || !args[0]->IsNumber()) {
-      THROW_TYPE("No option type specified.");
-    }
+    // ObjectWrap uses the first internal field to store the wrapped pointer.
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    tpl->SetClassName(String::NewSymbol("Context"));
 
-    if (args.Length() < 2) {
-      THROW_TYPE("No option value specified.");
+    NODE_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+
+    constructorTemplate = Persistent<FunctionTemplate>::New(tpl);
+    constructor = Persistent<Function>::New(tpl->GetFunction());
+  }
+
+  //
+  // ## PinnedBuffer
+  //
+  // Keeps a Node Buffer alive for as long as ZeroMQ holds a pointer into its memory (see `zmq_msg_init_data`). ZeroMQ
+  // releases messages from its own I/O threads, so releases are queued and handed back to the main loop before the
+  // Buffer's persistent handle is disposed.
+  //
+  void PinnedBuffer::Initialize() {
+    assert(uv_mutex_init(&releasedLock) == 0);
+    assert(uv_async_init(uv_default_loop(), &releasedHandle, Dispose) == 0);
+
+    // Pending releases should never keep the process alive on their own.
+    uv_unref((uv_handle_t*)&releasedHandle);
+  }
+
+  int PinnedBuffer::InitMessage(zmq_msg_t *msg, Handle<Object> buffer) {
+    PinnedBuffer *pinned = new PinnedBuffer;
+    pinned->buffer = Persistent<Object>::New(buffer);
+    pinned->next = NULL;
+
+    int rc = zmq_msg_init_data(msg, Buffer::Data(buffer), Buffer::Length(buffer), Release, pinned);
+
+    if (rc != 0) {
+      pinned->buffer.Dispose();
+      delete pinned;
     }
 
-    int type = args[0]->Int32Value();
-    int rc = 0;
+    return rc;
+  }
 
-    switch (type) {
-      // char*
-      case ZMQ_SUBSCRIBE:
-      case ZMQ_UNSUBSCRIBE:
-      case ZMQ_IDENTITY:
-      case ZMQ_TCP_ACCEPT_FILTER:
-        {
-          size_t size = args[1]->ToString()->Length();
-          void *value = malloc(size);
-          assert(value);
-          args[1]->ToString()->WriteAscii((char*)value, 0, size);
+  void PinnedBuffer::Release(void *data, void *hint) {
+    PinnedBuffer *pinned = (PinnedBuffer*)hint;
+    assert(pinned);
 
-          rc = zmq_setsockopt(self->socket, type, value, size);
+    uv_mutex_lock(&releasedLock);
+    pinned->next = released;
+    released = pinned;
+    uv_mutex_unlock(&releasedLock);
 
-          free(value);
-        }
-        break;
-      // int
-      case ZMQ_RATE:
-      case ZMQ_RECOVERY_IVL:
-      case ZMQ_SNDBUF:
-      case ZMQ_RCVBUF:
-      case ZMQ_LINGER:
-      case ZMQ_RECONNECT_IVL:
-      case ZMQ_RECONNECT_IVL_MAX:
-      case ZMQ_MULTICAST_HOPS:
-      case ZMQ_RCVTIMEO:
-      case ZMQ_SNDTIMEO:
-      case ZMQ_TCP_KEEPALIVE:
-      case ZMQ_TCP_KEEPALIVE_IDLE:
-      case ZMQ_TCP_KEEPALIVE_CNT:
-      case ZMQ_TCP_KEEPALIVE_INTVL:
-        {
-          int value = args[1]->Int32Value();
+    uv_async_send(&releasedHandle);
+  }
 
-          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
-        }
-        break;
-      // bool
-      case ZMQ_IPV4ONLY:
-      case ZMQ_DELAY_ATTACH_ON_CONNECT:
-      case ZMQ_ROUTER_MANDATORY:
-      case ZMQ_XPUB_VERBOSE:
-        {
-          bool value = args[1]->Int32Value() > 0 ? 1 : 0;
+  void PinnedBuffer::Dispose(uv_async_t *handle, int status) {
+    uv_mutex_lock(&releasedLock);
+    PinnedBuffer *pinned = released;
+    released = NULL;
+    uv_mutex_unlock(&releasedLock);
 
-          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
-        }
-        break;
-      // uint64_t
-      case ZMQ_AFFINITY:
-        {
-          uint64_t value = args[1]->Uint32Value();
+    while (pinned) {
+      PinnedBuffer *next = pinned->next;
 
-          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
-        }
-        break;
-      // int64_t
-      case ZMQ_MAXMSGSIZE:
-        {
-          int64_t value = args[1]->IntegerValue();
+      pinned->buffer.Dispose();
+      delete pinned;
 
-          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
-        }
-        break;
+      pinned = next;
     }
+  }
 
-    ZMQ_CHECK(rc);
+  //
+  // ## Proxy
+  //
+  // Forwards messages between two Sockets (and copies them to an optional third) on a ProxyThread, so brokering runs
+  // at native speed without any message crossing into JS. The Sockets belong to the thread until the Proxy is
+  // terminated, and can't be used from JS in the meantime.
+  //
+  Proxy::Proxy() : ObjectWrap(), thread(NULL), running(false) {
+  }
 
-    return scope.Close(Undefined());
+  Proxy::~Proxy() {
+    Terminate();
+
+    if (thread) {
+      delete thread;
+    }
   }
 
   //
-  // ## GetOption `GetOption(option)`
+  // ## Proxy(frontend, backend, options)
   //
-  // Retrieves a ZMQ-specific option from the underlying ZMQ socket.
+  // Starts forwarding between the Sockets **frontend** and **backend**, copying every message to
+  // **options.capture**, if given.
   //
-  Handle<Value> Socket::GetOption(const Arguments& args) {
+  Handle<Value> Proxy::New(const Arguments& args) {
     HandleScope scope;
-    Socket *self = THIS_TO_SOCKET(args.This());
-    assert(self);
 
-    if (self->socket == NULL) {
-      THROW_REF("Socket is closed, and options cannot be retrieved.");
+    if (!args.IsConstructCall()) {
+      Handle<Value> argv[3] = { args[0], args[1], args[2] };
+      return constructor->NewInstance(3, argv);
     }
 
-    if (args.Length() < 1 || !args[0]->IsNumber()) {
-      THROW_TYPE("No option type specified.");
+    if (!Socket::HasInstance(args[0]) || !Socket::HasInstance(args[1])) {
+      THROW_TYPE("Proxy requires a frontend and backend Socket.");
     }
 
-    Handle<Value> retval;
-    int type = args[0]->Int32Value();
-    size_t size;
-    int rc = 0;
+    Handle<Value> captureObj = Undefined();
 
-    switch (type) {
-      // char*
-      case ZMQ_IDENTITY:
-      case ZMQ_LAST_ENDPOINT:
-        {
-          size = 128;
-          void *value = malloc(size);
-          assert(value);
-          rc = zmq_getsockopt(self->socket, type, value, &size);
-          retval = String::New((char*)value, size);
-          free(value);
-        }
-        break;
-      // int
-      case ZMQ_TYPE:
-      case ZMQ_SNDHWM:
-      case ZMQ_RCVHWM:
-      case ZMQ_RATE:
-      case ZMQ_RECOVERY_IVL:
-      case ZMQ_SNDBUF:
-      case ZMQ_RCVBUF:
-      case ZMQ_LINGER:
-      case ZMQ_RECONNECT_IVL:
-      case ZMQ_RECONNECT_IVL_MAX:
-      case ZMQ_BACKLOG:
-      case ZMQ_MULTICAST_HOPS:
+    if (args[2]->IsObject()) {
+      captureObj = args[2]->ToObject()->Get(String::NewSymbol("capture"));
+    }
+
+    if (!captureObj->IsUndefined() && !captureObj->IsNull() && !Socket::HasInstance(captureObj)) {
+      THROW_TYPE("Invalid capture socket specified.");
+    }
+
+    Socket *sockets[3] = {
+      ObjectWrap::Unwrap<Socket>(args[0]->ToObject()),
+      ObjectWrap::Unwrap<Socket>(args[1]->ToObject()),
+      Socket::HasInstance(captureObj) ? ObjectWrap::Unwrap<Socket>(captureObj->ToObject()) : NULL
+    };
+
+    // Everything is validated before any Socket is lent, so a failure leaves them all usable.
+    for (int i = 0; i < 3; i++) {
+      Socket *socket = sockets[i];
+
+      if (socket == NULL) {
+        continue;
+      }
+
+      if (socket->socket == NULL) {
+        THROW_REF("Socket is closed, and cannot be proxied.");
+      }
+
+      if (socket->proxy) {
+        THROW_REF("Socket is already in use by a proxy.");
+      }
+
+      if (socket->ioThread) {
+        THROW_TYPE("Sockets with an ioThread cannot be proxied.");
+      }
+
+      if (socket->forwarding) {
+        THROW_REF("Socket is forwarding, and cannot be proxied.");
+      }
+
+      // The proxy would send (or read) ahead of them, and they'd be held back until it's terminated.
+      if (socket->HasPending()) {
+        THROW_REF("Socket has messages pending, and cannot be proxied.");
+      }
+
+      for (int j = 0; j < i; j++) {
+        if (sockets[j] == socket) {
+          THROW_TYPE("A Socket can only be used once per proxy.");
+        }
+      }
+    }
+
+    Proxy *self = new Proxy();
+    assert(self);
+    self->Wrap(args.This());
+
+    // A running Proxy has to stay alive, whether or not JS holds onto it.
+    self->Ref();
+    self->running = true;
+
+    self->frontend = Persistent<Object>::New(args[0]->ToObject());
+    self->backend = Persistent<Object>::New(args[1]->ToObject());
+
+    if (sockets[2]) {
+      self->capture = Persistent<Object>::New(captureObj->ToObject());
+    }
+
+    for (int i = 0; i < 3; i++) {
+      if (sockets[i]) {
+        sockets[i]->HandOff(self);
+      }
+    }
+
+    self->thread = new ProxyThread(sockets[0]->socket, sockets[1]->socket, sockets[2] ? sockets[2]->socket : NULL);
+
+    return args.This();
+  }
+
+  //
+  // ## Terminate `Terminate()`
+  //
+  // Stops the thread, handing the Sockets back to JS. Terminating more than once is harmless.
+  //
+  void Proxy::Terminate() {
+    if (!running) {
+      return;
+    }
+
+    running = false;
+    thread->Terminate();
+
+    Persistent<Object> *handles[3] = { &frontend, &backend, &capture };
+
+    for (int i = 0; i < 3; i++) {
+      if (handles[i]->IsEmpty()) {
+        continue;
+      }
+
+      ObjectWrap::Unwrap<Socket>(*handles[i])->TakeBack();
+      handles[i]->Dispose();
+      handles[i]->Clear();
+    }
+
+    Unref();
+  }
+
+  //
+  // ## Pause `Pause()`
+  //
+  // Stops forwarding messages until `Resume` is called.
+  //
+  Handle<Value> Proxy::Pause(const Arguments& args) {
+    HandleScope scope;
+    Proxy *self = ObjectWrap::Unwrap<Proxy>(args.This());
+    assert(self);
+
+    if (!self->running) {
+      THROW_REF("Proxy is terminated, and cannot be paused.");
+    }
+
+    self->thread->Pause();
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## Resume `Resume()`
+  //
+  // Resumes forwarding messages after `Pause`.
+  //
+  Handle<Value> Proxy::Resume(const Arguments& args) {
+    HandleScope scope;
+    Proxy *self = ObjectWrap::Unwrap<Proxy>(args.This());
+    assert(self);
+
+    if (!self->running) {
+      THROW_REF("Proxy is terminated, and cannot be resumed.");
+    }
+
+    self->thread->Resume();
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## Terminate `Terminate()`
+  //
+  // Stops forwarding messages for good, handing the Sockets back to JS.
+  //
+  Handle<Value> Proxy::Terminate(const Arguments& args) {
+    HandleScope scope;
+    Proxy *self = ObjectWrap::Unwrap<Proxy>(args.This());
+    assert(self);
+
+    self->Terminate();
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## Stats `Stats()`
+  //
+  // Returns the messages and bytes forwarded in each direction so far.
+  //
+  Handle<Value> Proxy::Stats(const Arguments& args) {
+    HandleScope scope;
+    Proxy *self = ObjectWrap::Unwrap<Proxy>(args.This());
+    assert(self);
+
+    ProxyThread::Counters counters[2];
+    const char *names[2] = { "frontend", "backend" };
+
+    ProxyThread::Read(&self->thread->frontend, &counters[0]);
+    ProxyThread::Read(&self->thread->backend, &counters[1]);
+
+    Local<Object> stats = Object::New();
+    stats->Set(String::NewSymbol("running"), Boolean::New(self->running));
+    stats->Set(String::NewSymbol("paused"), Boolean::New(self->running && self->thread->Paused()));
+
+    for (int i = 0; i < 2; i++) {
+      Local<Object> direction = Object::New();
+      direction->Set(String::NewSymbol("messages"), Number::New(counters[i].messages));
+      direction->Set(String::NewSymbol("bytes"), Number::New(counters[i].bytes));
+      stats->Set(String::NewSymbol(names[i]), direction);
+    }
+
+    return scope.Close(stats);
+  }
+
+  //
+  // ## Initialize
+  //
+  // Creates and populates the constructor Function and its prototype.
+  //
+  void Proxy::Initialize() {
+    Local<FunctionTemplate> tpl(FunctionTemplate::New(New));
+
+    // ObjectWrap uses the first internal field to store the wrapped pointer.
+    tpl->InstanceTemplate()->SetInternalFieldCount(1);
+    tpl->SetClassName(String::NewSymbol("Proxy"));
+
+    NODE_SET_PROTOTYPE_METHOD(tpl, "pause", Pause);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "resume", Resume);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "terminate", Terminate);
+    NODE_SET_PROTOTYPE_METHOD(tpl, "stats", Stats);
+
+    constructor = Persistent<Function>::New(tpl->GetFunction());
+  }
+
+  //
+  // ## Poller
+  //
+  // Tracks readiness for every Socket on the loop. Each Socket contributes a single `uv_poll_t` on its ZMQ_FD, and
+  // marks itself "dirty" whenever ZMQ_EVENTS may have changed: after a send or recv, or when its fd is signaled.
+  // Every dirty Socket is then checked in a single pass, so the work done on each turn of the loop grows with the
+  // number of active sockets rather than the number of open ones.
+  //
+  // Passes run from a `uv_check_t`, straight after the loop has polled for I/O, so a signaled fd is checked on the
+  // same turn it woke the loop up, and from a `uv_prepare_t`, just before the loop blocks, for Sockets marked by
+  // anything else. Neither keeps the loop alive or busy. The shared `uv_idle_t` is only active while Sockets are
+  // dirty, to keep the loop from blocking until they've been checked, so a quiet loop blocks in the kernel rather
+  // than spinning.
+  //
+  void Poller::Initialize() {
+    assert(uv_idle_init(uv_default_loop(), &idleHandle) == 0);
+    assert(uv_prepare_init(uv_default_loop(), &prepareHandle) == 0);
+    assert(uv_check_init(uv_default_loop(), &checkHandle) == 0);
+
+    assert(uv_prepare_start(&prepareHandle, RunBeforePoll) == 0);
+    assert(uv_check_start(&checkHandle, RunAfterPoll) == 0);
+    uv_unref((uv_handle_t*)&prepareHandle);
+    uv_unref((uv_handle_t*)&checkHandle);
+  }
+
+  void Poller::MarkDirty(Socket *socket) {
+    if (socket->dirty) {
+      return;
+    }
+
+    socket->dirty = true;
+    socket->prevDirty = NULL;
+    socket->nextDirty = dirty;
+
+    if (dirty) {
+      dirty->prevDirty = socket;
+    }
+
+    dirty = socket;
+
+    uv_idle_start(&idleHandle, Wait);
+  }
+
+  void Poller::Remove(Socket *socket) {
+    if (!socket->dirty) {
+      return;
+    }
+
+    if (!Unlink(&dirty, socket)) {
+      Unlink(&checking, socket);
+    }
+
+    socket->dirty = false;
+  }
+
+  bool Poller::Unlink(Socket **head, Socket *socket) {
+    if (socket->prevDirty) {
+      socket->prevDirty->nextDirty = socket->nextDirty;
+    } else if (*head == socket) {
+      *head = socket->nextDirty;
+    } else {
+      return false;
+    }
+
+    if (socket->nextDirty) {
+      socket->nextDirty->prevDirty = socket->prevDirty;
+    }
+
+    socket->prevDirty = NULL;
+    socket->nextDirty = NULL;
+    return true;
+  }
+
+  void Poller::Wait(uv_idle_t *handle, int status) {
+    // The pass itself waits for the prepare or check phase. Being active is all that's needed.
+  }
+
+  void Poller::RunBeforePoll(uv_prepare_t *handle, int status) {
+    Run();
+
+    if (!spinners.empty()) {
+      Spin();
+    }
+  }
+
+  void Poller::RunAfterPoll(uv_check_t *handle, int status) {
+    Run();
+  }
+
+  void Poller::AddSpinner(Socket *socket) {
+    spinners.push_back(socket);
+  }
+
+  void Poller::RemoveSpinner(Socket *socket) {
+    for (size_t i = 0; i < spinners.size(); i++) {
+      if (spinners[i] == socket) {
+        spinners.erase(spinners.begin() + i);
+        return;
+      }
+    }
+  }
+
+  void Poller::Spin() {
+    uint64_t start = uv_hrtime();
+    uint64_t now = start;
+    uint64_t deadline = start;
+
+    // This runs just before the loop would block, so nothing else is kept waiting for long.
+    for (size_t i = 0; i < spinners.size(); i++) {
+      Socket *socket = spinners[i];
+
+      if (socket->Spinning(now)) {
+        spinning.push_back(socket);
+
+        if (socket->lastActive + socket->busyPollNanos > deadline) {
+          deadline = socket->lastActive + socket->busyPollNanos;
+        }
+      }
+    }
+
+    if (spinning.empty()) {
+      return;
+    }
+
+    while (dirty == NULL && now < deadline) {
+      for (size_t i = 0; i < spinning.size(); i++) {
+        Socket *socket = spinning[i];
+        int events;
+
+        if (now - socket->lastActive < socket->busyPollNanos && (events = socket->Events()) > 0 &&
+            (events & ZMQ_POLLIN)) {
+          socket->stats.busyPollHits++;
+          MarkDirty(socket);
+        }
+      }
+
+      now = uv_hrtime();
+    }
+
+    for (size_t i = 0; i < spinning.size(); i++) {
+      spinning[i]->stats.busyPolls++;
+      spinning[i]->stats.busyPollNanos += now - start;
+    }
+
+    spinning.clear();
+
+    // Whatever was found is emitted before the loop blocks, and its readers will be spun for again next time.
+    if (dirty) {
+      Run();
+      uv_idle_start(&idleHandle, Wait);
+    }
+  }
+
+  void Poller::Run() {
+    HandleScope scope;
+
+    if (dirty == NULL) {
+      return;
+    }
+
+    // Sockets marked dirty by the events we emit are left for the next pass, which keeps each pass bounded.
+    checking = dirty;
+    dirty = NULL;
+
+    while (checking) {
+      Socket *socket = checking;
+
+      checking = socket->nextDirty;
+
+      if (checking) {
+        checking->prevDirty = NULL;
+      }
+
+      socket->dirty = false;
+      socket->prevDirty = NULL;
+      socket->nextDirty = NULL;
+
+      Socket::Check(socket);
+    }
+
+    // Anything marked during the pass is checked by the next one, which the loop mustn't block before.
+    if (dirty == NULL) {
+      uv_idle_stop(&idleHandle);
+    }
+  }
+
+  //
+  // ## Socket
+  //
+  // Much like the native `net` module, a ZMQStream socket (perhaps obviously) is really just a Duplex stream that
+  // you can `connect`, `bind`, etc. just like a native ZMQ socket.
+  //
+  Socket::Socket(void *context, int type)
+      : ObjectWrap(), dirty(false), prevDirty(NULL), nextDirty(NULL), polled(false), shouldDrain(false),
+        shouldReadable(true), canRead(type != ZMQ_PUSH && type != ZMQ_PUB), busyPollNanos(0), lastActive(0),
+        zeroCopyReads(0), zeroCopyWrites(0), framePool(NULL), ioThread(NULL), proxy(NULL), forwarding(NULL),
+        coalescer(NULL), coalesceTimer(NULL), coalesceMillis(0), coalesceStalled(false), compressor(NULL),
+        compressContext(NULL), compressAsyncBytes(0), outboundBytes(0), queueBytes(0), queueMessages(0),
+        subscriptions(NULL), peers(NULL),
+        transitLatency(NULL), queueLatency(NULL), wakeNanos(0), readableNanos(0), monitoring(NULL),
+        sharedContext(false) {
+    this->socket = zmq_socket(context, type);
+    assert(this->socket != 0);
+
+    uv_os_sock_t fd;
+    size_t size = sizeof fd;
+    zmq_getsockopt(this->socket, ZMQ_FD, &fd, &size);
+
+    // The handle outlives the Socket until libuv is done closing it, so it's allocated separately.
+    pollHandle = new uv_poll_t;
+    assert(uv_poll_init_socket(uv_default_loop(), pollHandle, fd) == 0);
+    pollHandle->data = this;
+  }
+
+  Socket::~Socket() {
+    if (this->ioThread) {
+      this->ioThread->Close();
+      this->ioThread = NULL;
+    }
+
+    if (this->socket) {
+      assert(zmq_close(this->socket) == 0);
+    }
+
+    if (!contextHandle.IsEmpty()) {
+      contextHandle.Dispose();
+    }
+
+    if (sharedContext) {
+      ScopedContext::Release();
+    }
+
+    // Frames carved from the pool may still be alive, in which case it'll clean up after itself.
+    if (framePool) {
+      framePool->Release();
+    }
+
+    StopForwarding();
+    Poller::Remove(this);
+    Poller::RemoveSpinner(this);
+    uv_close((uv_handle_t*)pollHandle, ClosePollHandle);
+
+    if (coalesceTimer) {
+      uv_close((uv_handle_t*)coalesceTimer, CloseTimerHandle);
+    }
+
+    delete coalescer;
+
+    // Jobs still on the threadpool keep the Socket alive, so only finished ones are left.
+    for (size_t i = 0; i < compressJobs.size(); i++) {
+      delete compressJobs[i];
+    }
+
+    for (size_t i = 0; i < outbound.size(); i++) {
+      delete outbound[i];
+    }
+
+    for (size_t i = 0; i < stash.size(); i++) {
+      zmq_msg_close(&stash[i]);
+    }
+
+    if (compressor) {
+      compressor->FreeContext(compressContext);
+      delete compressor;
+    }
+
+    delete subscriptions;
+    delete peers;
+    delete transitLatency;
+    delete queueLatency;
+    delete monitoring;
+
+    if (!monitorHandle.IsEmpty()) {
+      monitorHandle.Dispose();
+    }
+
+    if (!emitFunction.IsEmpty()) {
+      emitFunction.Dispose();
+    }
+  }
+
+  //
+  // ## ClosePollHandle
+  //
+  // A `uv_close_cb` freeing a Socket's `pollHandle`.
+  //
+  void Socket::ClosePollHandle(uv_handle_t *handle) {
+    delete (uv_poll_t*)handle;
+  }
+
+  //
+  // ## CloseTimerHandle
+  //
+  // A `uv_close_cb` freeing a Socket's `coalesceTimer`.
+  //
+  void Socket::CloseTimerHandle(uv_handle_t *handle) {
+    delete (uv_timer_t*)handle;
+  }
+
+  //
+  // ## Socket(options)
+  //
+  // Creates a new **options.type** ZMQ socket. Defaults to PAIR.
+  //
+  Handle<Value> Socket::New(const Arguments& args) {
+    HandleScope scope;
+
+    if (!args.IsConstructCall()) {
+      Handle<Value> argv[1] = { args[0] };
+      return constructor->NewInstance(1, argv);
+    }
+
+    Handle<Object> options;
+
+    if (args.Length() < 1 || !args[0]->IsObject()) {
+      options = Object::New();
+    } else {
+      options = args[0]->ToObject();
+    }
+
+    Handle<Integer> type = options->Get(String::NewSymbol("type"))->ToInteger();
+    int32_t hwm = options->Get(String::NewSymbol("highWaterMark"))->ToInteger()->Int32Value();
+    int32_t zeroCopyReads = options->Get(String::NewSymbol("zeroCopyReads"))->ToInteger()->Int32Value();
+    int32_t zeroCopyWrites = options->Get(String::NewSymbol("zeroCopyWrites"))->ToInteger()->Int32Value();
+    int32_t pooledReads = options->Get(String::NewSymbol("pooledReads"))->ToInteger()->Int32Value();
+    int32_t poolSlabSize = options->Get(String::NewSymbol("poolSlabSize"))->ToInteger()->Int32Value();
+    bool ioThread = options->Get(String::NewSymbol("ioThread"))->BooleanValue();
+    int32_t ioRingSize = options->Get(String::NewSymbol("ioRingSize"))->ToInteger()->Int32Value();
+    bool coalesce = options->Get(String::NewSymbol("coalesce"))->BooleanValue();
+    int32_t coalesceBytes = options->Get(String::NewSymbol("coalesceBytes"))->ToInteger()->Int32Value();
+    int32_t coalesceMessages = options->Get(String::NewSymbol("coalesceMessages"))->ToInteger()->Int32Value();
+    int32_t coalesceMicros = options->Get(String::NewSymbol("coalesceMicros"))->ToInteger()->Int32Value();
+    Handle<Value> compress = options->Get(String::NewSymbol("compress"));
+    int32_t compressLevel = options->Get(String::NewSymbol("compressLevel"))->ToInteger()->Int32Value();
+    Handle<Value> compressDictionary = options->Get(String::NewSymbol("compressDictionary"));
+    Handle<Value> compressMinBytes = options->Get(String::NewSymbol("compressMinBytes"));
+    Handle<Value> compressAsyncBytes = options->Get(String::NewSymbol("compressAsyncBytes"));
+    bool trackSubscriptions = options->Get(String::NewSymbol("trackSubscriptions"))->BooleanValue();
+    bool internIdentities = options->Get(String::NewSymbol("internIdentities"))->BooleanValue();
+    bool trace = options->Get(String::NewSymbol("trace"))->BooleanValue();
+    int32_t busyPollMicros = options->Get(String::NewSymbol("busyPollMicros"))->ToInteger()->Int32Value();
+    int32_t queueBytes = options->Get(String::NewSymbol("queueBytes"))->ToInteger()->Int32Value();
+    int32_t queueMessages = options->Get(String::NewSymbol("queueMessages"))->ToInteger()->Int32Value();
+
+    int32_t socketType = type->Value();
+    int codec = Compressor::NONE;
+
+    // Every option is checked before anything is allocated, so a bad combination can't leave a half-built socket
+    // (and the context it holds) behind.
+    if (pooledReads > 0) {
+      if (poolSlabSize <= 0) {
+        poolSlabSize = 64 * 1024;
+      }
+
+      if ((size_t)pooledReads + sizeof(size_t) > (size_t)poolSlabSize) {
+        THROW_TYPE("pooledReads must be smaller than poolSlabSize.");
+      }
+    }
+
+    // Batches are addressed as a whole, so they can't carry an envelope (or a subscription prefix) per message.
+    if (coalesce && socketType != ZMQ_PUSH && socketType != ZMQ_PULL && socketType != ZMQ_PUB &&
+        socketType != ZMQ_SUB && socketType != ZMQ_PAIR) {
+      THROW_TYPE("coalesce is only supported by PUSH, PULL, PUB, SUB and PAIR sockets.");
+    }
+
+    if (compress->BooleanValue()) {
+      String::Utf8Value name(compress);
+
+      if (strcmp(*name, "lz4") == 0) {
+        codec = Compressor::LZ4;
+      } else if (strcmp(*name, "zstd") == 0) {
+        codec = Compressor::ZSTD;
+      } else {
+        THROW_TYPE("compress must be 'lz4' or 'zstd'.");
+      }
+
+      if (!Compressor::Available(codec)) {
+        THROW_TYPE("That compression codec was not built in (see zmqstream.Compression).");
+      }
+
+      if (!compressDictionary->IsUndefined() && !Buffer::HasInstance(compressDictionary)) {
+        THROW_TYPE("compressDictionary must be a Buffer.");
+      }
+    }
+
+    if (trackSubscriptions && socketType != ZMQ_XPUB) {
+      THROW_TYPE("trackSubscriptions is only supported by XPUB sockets.");
+    }
+
+    if (internIdentities && socketType != ZMQ_ROUTER) {
+      THROW_TYPE("internIdentities is only supported by ROUTER sockets.");
+    }
+
+    // Batches would need a trace frame per message, and unpacking them would be no cheaper than not coalescing.
+    if (trace && coalesce) {
+      THROW_TYPE("trace cannot be combined with coalesce.");
+    }
+
+    // An IOThread is already waiting on the socket, and is the better way to get messages off it sooner.
+    if (busyPollMicros > 0 && ioThread) {
+      THROW_TYPE("busyPollMicros cannot be combined with ioThread.");
+    }
+
+    // Each of these already holds written messages back in a queue of its own.
+    if ((queueBytes > 0 || queueMessages > 0) && (ioThread || coalesce || compress->BooleanValue())) {
+      THROW_TYPE("queueBytes and queueMessages cannot be combined with ioThread, coalesce or compress.");
+    }
+
+    Handle<Value> contextObj = options->Get(String::NewSymbol("context"));
+    void *context = NULL;
+
+    if (!contextObj->IsUndefined()) {
+      if (!Context::HasInstance(contextObj)) {
+        THROW_TYPE("Invalid context specified.");
+      }
+
+      context = ObjectWrap::Unwrap<Context>(contextObj->ToObject())->context;
+
+      if (context == NULL) {
+        THROW_REF("Context is closed, and cannot create sockets.");
+      }
+    } else {
+      context = ScopedContext::Acquire();
+    }
+
+    // Creates a new instance object of this type and wraps it.
+    Socket* self = new Socket(context, socketType);
+    assert(self);
+    self->Wrap(args.This());
+    self->Ref();
+
+    if (contextObj->IsUndefined()) {
+      self->sharedContext = true;
+    } else {
+      self->contextHandle = Persistent<Object>::New(contextObj->ToObject());
+      ObjectWrap::Unwrap<Context>(self->contextHandle)->sockets++;
+    }
+
+    if (hwm > 0) {
+      int rc = zmq_setsockopt(self->socket, ZMQ_SNDHWM, &hwm, sizeof hwm);
+
+      if (isSuccessRC(rc)) {
+        rc = zmq_setsockopt(self->socket, ZMQ_RCVHWM, &hwm, sizeof hwm);
+      }
+
+      // Nothing has been registered yet, but the socket and its context still have to be let go of.
+      if (!isSuccessRC(rc)) {
+        Handle<Value> error = Exception::Error(String::New(zmq_strerror(zmq_errno())));
+        Close(args);
+        return ThrowException(error);
+      }
+    }
+
+    if (zeroCopyReads > 0) {
+      self->zeroCopyReads = zeroCopyReads;
+    }
+
+    if (zeroCopyWrites > 0) {
+      self->zeroCopyWrites = zeroCopyWrites;
+    }
+
+    if (pooledReads > 0) {
+      self->framePool = new FramePool(poolSlabSize, pooledReads);
+    }
+
+    if (coalesce) {
+      self->coalescer = new Coalescer(coalesceBytes > 0 ? coalesceBytes : 16 * 1024,
+                                      coalesceMessages > 0 ? coalesceMessages : 256);
+
+      // libuv's timers only have millisecond resolution, so partial batches wait at least a millisecond.
+      self->coalesceMillis = coalesceMicros > 0 ? (coalesceMicros + 999) / 1000 : 1;
+      self->coalesceTimer = new uv_timer_t;
+      assert(uv_timer_init(uv_default_loop(), self->coalesceTimer) == 0);
+      self->coalesceTimer->data = self;
+    }
+
+    if (codec != Compressor::NONE) {
+      const char *dictionary = NULL;
+      size_t dictionarySize = 0;
+
+      if (Buffer::HasInstance(compressDictionary)) {
+        dictionary = Buffer::Data(compressDictionary->ToObject());
+        dictionarySize = Buffer::Length(compressDictionary->ToObject());
+      }
+
+      // Below a few hundred bytes, frames rarely shrink by more than the header adds.
+      int32_t minBytes = compressMinBytes->IsUndefined() ? 256 : compressMinBytes->ToInteger()->Int32Value();
+      int32_t asyncBytes = compressAsyncBytes->IsUndefined() ? 64 * 1024 :
+                           compressAsyncBytes->ToInteger()->Int32Value();
+
+      self->compressor = new Compressor(codec, compressLevel, dictionary, dictionarySize, minBytes > 1 ? minBytes : 1);
+      self->compressContext = self->compressor->NewContext();
+      self->compressAsyncBytes = asyncBytes > 0 ? asyncBytes : 0;
+    }
+
+    if (trackSubscriptions) {
+      self->subscriptions = new SubscriptionTrie();
+
+      // Subscriptions are read as soon as they arrive, whether or not anything else is going on.
+      if (!ioThread) {
+        uv_poll_start(self->pollHandle, UV_READABLE, Check);
+      }
+
+      Poller::MarkDirty(self);
+    }
+
+    if (internIdentities) {
+      self->peers = new IdentityTable();
+    }
+
+    if (trace) {
+      self->transitLatency = new LatencyHistogram();
+      self->queueLatency = new LatencyHistogram();
+    }
+
+    if (busyPollMicros > 0) {
+      self->busyPollNanos = (uint64_t)busyPollMicros * 1000;
+      Poller::AddSpinner(self);
+    }
+
+    if (queueBytes > 0 || queueMessages > 0) {
+      self->queueBytes = queueBytes > 0 ? queueBytes : 1024 * 1024;
+      self->queueMessages = queueMessages > 0 ? queueMessages : 1024;
+    }
+
+    // This has to come last, as the socket belongs to the thread from here on out.
+    if (ioThread) {
+      self->ioThread = new IOThread(self->socket, ioRingSize > 0 ? ioRingSize : 1024, Check, self);
+    }
+
+    // Establishes initial property values.
+    args.This()->Set(String::NewSymbol("type"), type);
+
+    // If we've had a super"class" provided, be sure to call its constructor.
+    Handle<Value> super = constructor->Get(String::NewSymbol("super_"));
+    if (super->IsFunction()) {
+      super->ToObject()->CallAsFunction(args.This(), 0, NULL);
+    }
+
+    return args.This();
+  }
+
+  //
+  // ## Close `Close()`
+  //
+  // Closes the underlying ZMQ socket. _The stream should no longer be used!_
+  //
+  Handle<Value> Socket::Close(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    // The proxy has to be stopped before the socket is closed out from under it.
+    if (self->proxy) {
+      self->proxy->Terminate();
+    }
+
+    void *socket = self->socket;
+
+    uv_poll_stop(self->pollHandle);
+    Poller::Remove(self);
+    Poller::RemoveSpinner(self);
+
+    if (socket == NULL) {
+      return scope.Close(Undefined());
+    }
+
+    self->StopForwarding();
+
+    // Whatever's been coalesced so far is sent if there's room for it, just as it would have been without coalescing.
+    if (self->coalescer) {
+      self->FlushBatch();
+
+      uv_close((uv_handle_t*)self->coalesceTimer, CloseTimerHandle);
+      self->coalesceTimer = NULL;
+      self->coalesceStalled = false;
+    }
+
+    // Compressed messages are sent if there's room for them, and dropped otherwise. Jobs still on the threadpool are
+    // discarded once they return.
+    if (self->compressor) {
+      self->SendCompressed();
+
+      for (size_t i = 0; i < self->compressJobs.size(); i++) {
+        if (self->compressJobs[i]->done) {
+          delete self->compressJobs[i];
+        } else {
+          self->compressJobs[i]->orphaned = true;
+        }
+      }
+
+      self->compressJobs.clear();
+    }
+
+    // Queued messages are likewise sent if there's room for them, and dropped otherwise.
+    if (!self->outbound.empty()) {
+      self->SendQueued();
+
+      for (size_t i = 0; i < self->outbound.size(); i++) {
+        delete self->outbound[i];
+      }
+
+      self->outbound.clear();
+      self->outboundBytes = 0;
+    }
+
+    // Flushing schedules checks (and may watch for room) of its own, which no longer matter.
+    uv_poll_stop(self->pollHandle);
+    Poller::Remove(self);
+
+    // Sockets waiting to forward here will notice it's closed the next time they're checked.
+    for (size_t i = 0; i < self->forwardWaiters.size(); i++) {
+      Poller::MarkDirty(self->forwardWaiters[i]);
+    }
+
+    self->forwardWaiters.clear();
+
+    // The thread has to be stopped before the socket is closed out from under it.
+    if (self->ioThread) {
+      self->ioThread->Close();
+      self->ioThread = NULL;
+    }
+
+    for (size_t i = 0; i < self->stash.size(); i++) {
+      zmq_msg_close(&self->stash[i]);
+    }
+
+    self->stash.clear();
+
+    // The monitor socket is left open, so it can still read the events closing this one produces.
+    if (!self->monitorHandle.IsEmpty()) {
+      self->monitorHandle.Dispose();
+      self->monitorHandle.Clear();
+    }
+
+    self->socket = NULL;
+    self->Unref();
+
+    // The socket is gone either way, so its context is let go of before any error is reported. That may terminate the
+    // context, replacing zmq_close's errno, so it's read first.
+    int error = isSuccessRC(zmq_close(socket)) ? 0 : zmq_errno();
+
+    if (!self->contextHandle.IsEmpty()) {
+      ObjectWrap::Unwrap<Context>(self->contextHandle)->sockets--;
+      self->contextHandle.Dispose();
+      self->contextHandle.Clear();
+    }
+
+    if (self->sharedContext) {
+      self->sharedContext = false;
+      ScopedContext::Release();
+    }
+
+    if (error) {
+      return ThrowException(Exception::Error(String::New(zmq_strerror(error))));
+    }
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## SetOption `SetOption(option, value)`
+  //
+  // Sets a ZMQ-specific option on the underlying ZMQ socket.
+  //
+  Handle<Value> Socket::SetOption(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and options cannot be set.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and options cannot be set.");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsNumber()) {
+      THROW_TYPE("No option type specified.");
+    }
+
+    if (args.Length() < 2) {
+      THROW_TYPE("No option value specified.");
+    }
+
+    IOThread::Guard guard(self->ioThread);
+    int type = args[0]->Int32Value();
+    int rc = 0;
+
+    switch (type) {
+      // char*
+      case ZMQ_SUBSCRIBE:
+      case ZMQ_UNSUBSCRIBE:
+      case ZMQ_IDENTITY:
+      case ZMQ_TCP_ACCEPT_FILTER:
+        {
+          size_t size = args[1]->ToString()->Length();
+          void *value = malloc(size);
+          assert(value);
+          args[1]->ToString()->WriteAscii((char*)value, 0, size);
+
+          rc = zmq_setsockopt(self->socket, type, value, size);
+
+          free(value);
+        }
+        break;
+      // int
+      case ZMQ_RATE:
+      case ZMQ_RECOVERY_IVL:
+      case ZMQ_SNDBUF:
+      case ZMQ_RCVBUF:
+      case ZMQ_LINGER:
+      case ZMQ_RECONNECT_IVL:
+      case ZMQ_RECONNECT_IVL_MAX:
+      case ZMQ_MULTICAST_HOPS:
+      case ZMQ_RCVTIMEO:
+      case ZMQ_SNDTIMEO:
+      case ZMQ_TCP_KEEPALIVE:
+      case ZMQ_TCP_KEEPALIVE_IDLE:
+      case ZMQ_TCP_KEEPALIVE_CNT:
+      case ZMQ_TCP_KEEPALIVE_INTVL:
+        {
+          int value = args[1]->Int32Value();
+
+          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
+        }
+        break;
+      // bool
+      case ZMQ_IPV4ONLY:
+      case ZMQ_DELAY_ATTACH_ON_CONNECT:
+      case ZMQ_ROUTER_MANDATORY:
+      case ZMQ_XPUB_VERBOSE:
+        {
+          bool value = args[1]->Int32Value() > 0 ? 1 : 0;
+
+          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
+        }
+        break;
+      // uint64_t
+      case ZMQ_AFFINITY:
+        {
+          uint64_t value = args[1]->Uint32Value();
+
+          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
+        }
+        break;
+      // int64_t
+      case ZMQ_MAXMSGSIZE:
+        {
+          int64_t value = args[1]->IntegerValue();
+
+          rc = zmq_setsockopt(self->socket, type, &value, sizeof value);
+        }
+        break;
+    }
+
+    ZMQ_CHECK(rc);
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## GetOption `GetOption(option)`
+  //
+  // Retrieves a ZMQ-specific option from the underlying ZMQ socket.
+  //
+  Handle<Value> Socket::GetOption(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and options cannot be retrieved.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and options cannot be retrieved.");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsNumber()) {
+      THROW_TYPE("No option type specified.");
+    }
+
+    IOThread::Guard guard(self->ioThread);
+    Handle<Value> retval;
+    int type = args[0]->Int32Value();
+    size_t size;
+    int rc = 0;
+
+    switch (type) {
+      // char*
+      case ZMQ_IDENTITY:
+      case ZMQ_LAST_ENDPOINT:
+        {
+          size = 128;
+          void *value = malloc(size);
+          assert(value);
+          rc = zmq_getsockopt(self->socket, type, value, &size);
+          retval = String::New((char*)value, size);
+          free(value);
+        }
+        break;
+      // int
+      case ZMQ_TYPE:
+      case ZMQ_SNDHWM:
+      case ZMQ_RCVHWM:
+      case ZMQ_RATE:
+      case ZMQ_RECOVERY_IVL:
+      case ZMQ_SNDBUF:
+      case ZMQ_RCVBUF:
+      case ZMQ_LINGER:
+      case ZMQ_RECONNECT_IVL:
+      case ZMQ_RECONNECT_IVL_MAX:
+      case ZMQ_BACKLOG:
+      case ZMQ_MULTICAST_HOPS:
       case ZMQ_RCVTIMEO:
       case ZMQ_SNDTIMEO:
       // case ZMQ_FD:
@@ -351,177 +1562,2540 @@ namespace zmqstream {
           retval = Number::New(value);
         }
         break;
-      // bool
-      case ZMQ_RCVMORE:
-      case ZMQ_IPV4ONLY:
-      case ZMQ_DELAY_ATTACH_ON_CONNECT:
-        {
-          size = sizeof(bool);
-          bool value;
-          rc = zmq_getsockopt(self->socket, type, &value, &size);
-          retval = Boolean::New(value);
+      // bool
+      case ZMQ_RCVMORE:
+      case ZMQ_IPV4ONLY:
+      case ZMQ_DELAY_ATTACH_ON_CONNECT:
+        {
+          size = sizeof(bool);
+          bool value;
+          rc = zmq_getsockopt(self->socket, type, &value, &size);
+          retval = Boolean::New(value);
+        }
+        break;
+      // uint64_t
+      case ZMQ_AFFINITY:
+        {
+          size = sizeof(uint64_t);
+          uint64_t value;
+          rc = zmq_getsockopt(self->socket, type, &value, &size);
+          retval = Number::New(value);
+        }
+        break;
+      // int64_t
+      case ZMQ_MAXMSGSIZE:
+        {
+          size = sizeof(int64_t);
+          int64_t value;
+          rc = zmq_getsockopt(self->socket, type, &value, &size);
+          retval = Number::New(value);
+        }
+        break;
+    }
+
+    ZMQ_CHECK(rc);
+
+    return scope.Close(retval);
+  }
+
+  //
+  // ## HasPending `HasPending()`
+  //
+  // Returns true if the socket holds messages that haven't reached (or been read from) the ZMQ socket yet: a
+  // coalesced batch, compression jobs, its outbound queue, or frames `ReadInto` stashed.
+  //
+  bool Socket::HasPending() {
+    return (coalescer && coalescer->Messages() > 0) || !compressJobs.empty() || !outbound.empty() || !stash.empty();
+  }
+
+  //
+  // ## HandOff `HandOff(proxy)`
+  //
+  // Lends the socket to **proxy**, which will use it from another thread until `TakeBack` is called.
+  //
+  void Socket::HandOff(Proxy *proxy) {
+    this->proxy = proxy;
+
+    uv_poll_stop(pollHandle);
+    Poller::Remove(this);
+  }
+
+  //
+  // ## TakeBack `TakeBack()`
+  //
+  // Reclaims the socket from its Proxy, resuming any events the application was waiting on.
+  //
+  void Socket::TakeBack() {
+    proxy = NULL;
+
+    if (shouldReadable || shouldDrain) {
+      uv_poll_start(pollHandle, UV_READABLE, Check);
+    }
+
+    ScheduleCheck();
+  }
+
+  //
+  // ## CreateFrame `CreateFrame(part)`
+  //
+  // Creates a Node Buffer for the received frame **part**. Small frames are copied (into the FramePool, if there
+  // is one), leaving **part** untouched. Frames of at least `zeroCopyReads` bytes are moved into a heap-allocated
+  // message that the Buffer keeps alive, leaving **part** empty.
+  //
+  Handle<Object> Socket::CreateFrame(zmq_msg_t *part) {
+    HandleScope scope;
+    size_t size = zmq_msg_size(part);
+
+    if ((framePool && size <= framePool->MaxFrameSize()) || zeroCopyReads == 0 || size < zeroCopyReads) {
+      return scope.Close(CopyFrame((const char*)zmq_msg_data(part), size));
+    }
+
+    // Moving (rather than copying) the message transfers ownership of its content without touching the payload.
+    // Since very small messages store their data inline, the data pointer has to be taken _after_ the move.
+    zmq_msg_t *owned = new zmq_msg_t;
+    assert(zmq_msg_init(owned) == 0);
+    assert(zmq_msg_move(owned, part) == 0);
+
+    return scope.Close(Local<Object>::New(Buffer::New((char*)zmq_msg_data(owned), size, ReleaseFrame, owned)->handle_));
+  }
+
+  //
+  // ## CopyFrame `CopyFrame(data, size)`
+  //
+  // Creates a Node Buffer holding a copy of the **size** bytes at **data**, carved from the FramePool if there is
+  // one.
+  //
+  Handle<Object> Socket::CopyFrame(const char *data, size_t size) {
+    HandleScope scope;
+
+    if (framePool && size <= framePool->MaxFrameSize()) {
+      void *hint;
+      char *copy = framePool->Allocate(size, &hint);
+
+      memcpy(copy, data, size);
+
+      return scope.Close(Local<Object>::New(Buffer::New(copy, size, FramePool::Free, hint)->handle_));
+    }
+
+    return scope.Close(Local<Object>::New(Buffer::New((char*)data, size)->handle_));
+  }
+
+  //
+  // ## UnpackBatch `UnpackBatch(batch, messages)`
+  //
+  // Appends every message packed into the frame **batch** to **messages**, returning how many there were. Returns
+  // 0, leaving **messages** untouched, if **batch** is malformed.
+  //
+  uint32_t Socket::UnpackBatch(zmq_msg_t *batch, Handle<Array> messages) {
+    HandleScope scope;
+    BatchReader reader(zmq_msg_data(batch), zmq_msg_size(batch));
+    uint32_t count;
+    uint32_t frames;
+    size_t bytes;
+
+    if (!reader.Validate(&count, &frames, &bytes)) {
+      return 0;
+    }
+
+    while (reader.NextMessage(&frames)) {
+      Local<Array> message = Array::New(frames);
+
+      for (uint32_t i = 0; i < frames; i++) {
+        const char *data;
+        uint32_t size;
+
+        reader.NextFrame(&data, &size);
+        message->Set(i, CopyFrame(data, size));
+      }
+
+      messages->Set(messages->Length(), message);
+    }
+
+    return count;
+  }
+
+  //
+  // ## ReleaseFrame
+  //
+  // A `free_callback` for zero-copy Buffers, closing the message that backs them once they've been collected.
+  //
+  void Socket::ReleaseFrame(char *data, void *hint) {
+    zmq_msg_t *owned = (zmq_msg_t*)hint;
+    assert(owned);
+
+    zmq_msg_close(owned);
+    delete owned;
+  }
+
+  //
+  // ## StripTrace `StripTrace(part)`
+  //
+  // Returns true if **part** is a trace frame and the socket is tracing, recording how long ago it was sent. Clocks
+  // are only comparable within a host, so a time in the future (from another host's clock) is recorded as 0.
+  //
+  bool Socket::StripTrace(zmq_msg_t *part) {
+    uint64_t sent;
+
+    if (transitLatency == NULL || !DecodeTrace(zmq_msg_data(part), zmq_msg_size(part), &sent)) {
+      return false;
+    }
+
+    uint64_t now = uv_hrtime();
+    transitLatency->Record(now > sent ? now - sent : 0);
+
+    return true;
+  }
+
+  //
+  // ## RecordQueued `RecordQueued()`
+  //
+  // Records how long the messages about to be read waited since the wakeup that announced them, if tracing. Only
+  // the first read after each `'readable'` is recorded.
+  //
+  void Socket::RecordQueued() {
+    if (queueLatency == NULL || readableNanos == 0) {
+      return;
+    }
+
+    queueLatency->Record(uv_hrtime() - readableNanos);
+    readableNanos = 0;
+  }
+
+  //
+  // ## Read `Read(size)`
+  //
+  // Consumes a maximum of **size** messages of data from the ZMQ socket. If **size** is undefined, the entire
+  // queue will be read and returned.
+  //
+  // **size** may also be a budget Object with any of `maxMessages`, `maxBytes` and `maxMicros`, checked between
+  // messages. A read that stops short of the queue's end is then followed by another 'readable' event, on a later
+  // tick, so a deep queue never stalls the loop.
+  //
+  // If there is no data to consume then null is returned, and a future 'readable' event will be emitted when more is
+  // available.
+  //
+  // Calling stream.read(0) is a no-op with no internal side effects, but can be used to test for Socket validity.
+  //
+  // Returns an Array of Messages, which are in turn Arrays of Frames as Node Buffers.
+  //
+  // NOTE: To reiterate, this Read returns a different amount and different format than the builtin Duplex, which
+  // is a single Buffer or String of <= `size`. Because of this, there is no encoding support.
+  //
+  Handle<Value> Socket::Read(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be read from.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be read from.");
+    }
+
+    if (self->subscriptions) {
+      THROW_REF("Socket reads its own subscriptions, and cannot be read from.");
+    }
+
+    if (self->monitoring) {
+      THROW_REF("Socket reads its own monitor events, and cannot be read from.");
+    }
+
+    ReadBudget budget;
+
+    if (args.Length() > 0) {
+      toBudget(args[0], &budget);
+    }
+
+    int size = budget.messages;
+
+    if (size == 0) {
+      return scope.Close(Null());
+    }
+
+    self->RecordQueued();
+
+    int rc = 0;
+    zmq_msg_t part;
+    Handle<Array> messages = Array::New();
+    Handle<Array> message = Array::New();
+    // True once a batch's marker frame has been received, and its batch frame is expected next.
+    bool inBatch = false;
+    size_t bytes = 0;
+    bool spent = false;
+
+    do {
+      ZMQ_CHECK(zmq_msg_init(&part));
+
+      rc = self->RecvFrame(&part);
+      ZMQ_CHECK(rc);
+
+      if (!isEAGAIN(rc)) {
+        // We want to continue, so clear `rc`.
+        rc = 0;
+
+        // A zero-copy frame is moved out of `part`, taking its ZMQ_RCVMORE flag with it, so that has to be read first.
+        bool more = zmq_msg_more(&part);
+        uint32_t unpacked = 0;
+
+        if (self->compressor) {
+          self->DecompressFrame(&part);
+        }
+
+        self->stats.bytesIn += zmq_msg_size(&part);
+        bytes += zmq_msg_size(&part);
+
+        if (self->coalescer && !inBatch && more && message->Length() == 0 &&
+            BatchReader::IsMarker(zmq_msg_data(&part), zmq_msg_size(&part))) {
+          inBatch = true;
+        } else if (inBatch && !more && (unpacked = self->UnpackBatch(&part, messages)) > 0) {
+          // Batches are never split, so `size` may be overshot.
+          inBatch = false;
+          size = size > 0 && (uint32_t)size <= unpacked ? 0 : size - unpacked;
+          spent = budget.Spent(bytes);
+        } else {
+          // Whatever looked like a batch wasn't one after all, and is returned as is.
+          if (inBatch) {
+            message->Set(0, self->CopyFrame(BATCH_MARKER, BATCH_MARKER_SIZE));
+            inBatch = false;
+          }
+
+          // A trace frame is recorded rather than returned.
+          if (more || message->Length() == 0 || !self->StripTrace(&part)) {
+            message->Set(message->Length(), self->CreateFrame(&part));
+          }
+
+          if (!more) {
+            size--;
+            messages->Set(messages->Length(), message);
+            message = Array::New();
+            spent = budget.Spent(bytes);
+          }
+        }
+      }
+
+      ZMQ_CHECK(zmq_msg_close(&part));
+    } while (rc == 0 && size != 0 && !spent);
+
+    // We've just called recv, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterRecv(rc);
+
+    // Whatever the budget left behind is announced by the check we've just scheduled, on a later tick.
+    if (budget.rearm && rc == 0) {
+      self->WatchReadable();
+    }
+
+    self->stats.messagesIn += messages->Length();
+    self->stats.RecordBatch(messages->Length());
+
+    if (messages->Length() == 0) {
+      self->WatchReadable();
+      return scope.Close(Null());
+    }
+
+    return scope.Close(messages);
+  }
+
+  //
+  // ## ReadFlat `ReadFlat(size)`
+  //
+  // Consumes a maximum of **size** messages (or a budget), exactly like `Read`, but packs every frame into a
+  // single Buffer rather than allocating one Buffer (and Array) per frame (and message).
+  //
+  // Returns an Object with `data`, the Buffer of every frame back to back, and `index`, a Uint32Array describing
+  // the batch. For each message in order, `index` holds its frame count followed by the offset and length of each
+  // frame within `data`. The number of messages is available as `messages`. Returns null if there is no data to
+  // consume, just like `Read`.
+  //
+  Handle<Value> Socket::ReadFlat(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be read from.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be read from.");
+    }
+
+    if (self->subscriptions) {
+      THROW_REF("Socket reads its own subscriptions, and cannot be read from.");
+    }
+
+    if (self->monitoring) {
+      THROW_REF("Socket reads its own monitor events, and cannot be read from.");
+    }
+
+    ReadBudget budget;
+
+    if (args.Length() > 0 && !args[0]->IsUndefined()) {
+      toBudget(args[0], &budget);
+    }
+
+    int size = budget.messages;
+
+    if (size == 0) {
+      return scope.Close(Null());
+    }
+
+    self->RecordQueued();
+
+    // Frames are held onto until the whole batch has been received, so the Buffer can be allocated exactly once.
+    // A deque never relocates its elements, which matters because zmq_msg_t instances must not be moved around.
+    // A coalesced batch is recorded with a frame count of 0, and unpacked while the Buffer is filled.
+    std::deque<zmq_msg_t> parts;
+    std::deque<uint32_t> frameCounts;
+    uint32_t frameCount = 0;
+    uint32_t messageCount = 0;
+    uint32_t entryCount = 0;
+    size_t bytes = 0;
+    bool spent = false;
+    int rc = 0;
+
+    do {
+      parts.push_back(zmq_msg_t());
+      zmq_msg_t *part = &parts.back();
+      zmq_msg_init(part);
+
+      rc = self->RecvFrame(part);
+
+      if (rc == -1) {
+        zmq_msg_close(part);
+        parts.pop_back();
+        break;
+      }
+
+      rc = 0;
+
+      bool more = zmq_msg_more(part);
+
+      if (self->compressor) {
+        self->DecompressFrame(part);
+      }
+
+      bytes += zmq_msg_size(part);
+      frameCount++;
+      self->stats.bytesIn += zmq_msg_size(part);
+
+      if (more) {
+        continue;
+      }
+
+      // A trace frame is recorded rather than returned.
+      if (frameCount > 1 && self->StripTrace(part)) {
+        bytes -= zmq_msg_size(part);
+        zmq_msg_close(part);
+        parts.pop_back();
+        frameCount--;
+      }
+
+      uint32_t batchMessages;
+      uint32_t batchFrames;
+      size_t batchBytes;
+      zmq_msg_t *marker = frameCount == 2 ? &parts[parts.size() - 2] : NULL;
+
+      if (self->coalescer && marker && BatchReader::IsMarker(zmq_msg_data(marker), zmq_msg_size(marker)) &&
+          BatchReader(zmq_msg_data(part), zmq_msg_size(part)).Validate(&batchMessages, &batchFrames, &batchBytes)) {
+        // Batches are never split, so `size` may be overshot.
+        size = size > 0 && (uint32_t)size <= batchMessages ? 0 : size - batchMessages;
+        bytes += batchBytes - zmq_msg_size(marker) - zmq_msg_size(part);
+        frameCounts.push_back(0);
+        messageCount += batchMessages;
+        entryCount += batchMessages + batchFrames * 2;
+      } else {
+        size--;
+        frameCounts.push_back(frameCount);
+        messageCount++;
+        entryCount += 1 + frameCount * 2;
+      }
+
+      frameCount = 0;
+      spent = budget.Spent(bytes);
+    } while (size != 0 && !spent);
+
+    // Any error other than EAGAIN is thrown, but only after every received message has been closed.
+    bool failed = rc == -1 && zmq_errno() != EAGAIN;
+    int err = zmq_errno();
+
+    // We've just called recv, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterRecv(rc);
+
+    // Whatever the budget left behind is announced by the check we've just scheduled, on a later tick.
+    if (budget.rearm && rc == 0) {
+      self->WatchReadable();
+    }
+
+    self->stats.messagesIn += messageCount;
+
+    if (!failed) {
+      self->stats.RecordBatch(messageCount);
+    }
+
+    if (failed || frameCounts.empty()) {
+      for (std::deque<zmq_msg_t>::iterator it = parts.begin(); it != parts.end(); ++it) {
+        zmq_msg_close(&*it);
+      }
+
+      if (failed) {
+        return ThrowException(Exception::Error(String::New(zmq_strerror(err))));
+      }
+
+      self->WatchReadable();
+      return scope.Close(Null());
+    }
+
+    Handle<Object> global = v8::Context::GetCurrent()->Global();
+    Handle<Function> Uint32Array = Handle<Function>::Cast(global->Get(String::NewSymbol("Uint32Array")));
+    Handle<Value> indexArgs[1] = { Integer::NewFromUnsigned(entryCount) };
+    Handle<Object> index = Uint32Array->NewInstance(1, indexArgs);
+    assert(index->HasIndexedPropertiesInExternalArrayData());
+
+    uint32_t *entry = (uint32_t*)index->GetIndexedPropertiesExternalArrayData();
+    Buffer *data = Buffer::New(bytes);
+    char *cursor = Buffer::Data(data);
+    std::deque<zmq_msg_t>::iterator it = parts.begin();
+
+    for (std::deque<uint32_t>::iterator count = frameCounts.begin(); count != frameCounts.end(); ++count) {
+      if (*count == 0) {
+        zmq_msg_close(&*it++);
+
+        BatchReader reader(zmq_msg_data(&*it), zmq_msg_size(&*it));
+        uint32_t frames;
+
+        while (reader.NextMessage(&frames)) {
+          *entry++ = frames;
+
+          for (uint32_t i = 0; i < frames; i++) {
+            const char *frame;
+            uint32_t frameSize;
+
+            reader.NextFrame(&frame, &frameSize);
+
+            *entry++ = cursor - Buffer::Data(data);
+            *entry++ = frameSize;
+
+            memcpy(cursor, frame, frameSize);
+            cursor += frameSize;
+          }
+        }
+
+        zmq_msg_close(&*it++);
+        continue;
+      }
+
+      *entry++ = *count;
+
+      for (uint32_t i = 0; i < *count; i++, ++it) {
+        size_t partSize = zmq_msg_size(&*it);
+
+        *entry++ = cursor - Buffer::Data(data);
+        *entry++ = partSize;
+
+        memcpy(cursor, zmq_msg_data(&*it), partSize);
+        cursor += partSize;
+
+        zmq_msg_close(&*it);
+      }
+    }
+
+    // Only complete messages are returned, so anything left over is discarded.
+    for (; it != parts.end(); ++it) {
+      zmq_msg_close(&*it);
+    }
+
+    Local<Object> result = Object::New();
+    result->Set(String::NewSymbol("messages"), Integer::NewFromUnsigned(messageCount));
+    result->Set(String::NewSymbol("data"), Local<Object>::New(data->handle_));
+    result->Set(String::NewSymbol("index"), index);
+
+    return scope.Close(result);
+  }
+
+  //
+  // ## ReadInto `ReadInto(target, index, [offset])`
+  //
+  // Copies as many whole messages as fit into **target**, a Buffer, ArrayBuffer or typed array, starting **offset**
+  // bytes in, and describes them in **index**, a Uint32Array, exactly as `ReadFlat` would: for each message in
+  // order, its frame count followed by the offset and length of each frame within **target**. Nothing is allocated
+  // at all, so a consumer reading into the same memory over and over makes no garbage.
+  //
+  // Returns the number of messages read. A message is never split, so reading stops at the first message that
+  // doesn't fit in what's left of either **target** or **index**, which is kept and returned by the next read of
+  // any kind. That's 0 if not even the first one fit. Returns null if there is no data to consume, just like `Read`.
+  //
+  Handle<Value> Socket::ReadInto(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be read from.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be read from.");
+    }
+
+    if (self->subscriptions) {
+      THROW_REF("Socket reads its own subscriptions, and cannot be read from.");
+    }
+
+    if (self->monitoring) {
+      THROW_REF("Socket reads its own monitor events, and cannot be read from.");
+    }
+
+    // A batch unpacks into any number of messages, which could never be stopped at a boundary in between.
+    if (self->coalescer) {
+      THROW_TYPE("readInto is not supported by coalescing sockets.");
+    }
+
+    char *target;
+    size_t capacity;
+
+    if (args.Length() < 1 || !toExternalBytes(args[0], &target, &capacity)) {
+      THROW_TYPE("Target must be a Buffer, ArrayBuffer or typed array.");
+    }
+
+    if (args.Length() < 2 || !args[1]->IsObject() || !args[1]->ToObject()->HasIndexedPropertiesInExternalArrayData() ||
+        args[1]->ToObject()->GetIndexedPropertiesExternalArrayDataType() != kExternalUnsignedIntArray) {
+      THROW_TYPE("Index must be a Uint32Array.");
+    }
+
+    Local<Object> indexObj = args[1]->ToObject();
+    uint32_t *index = (uint32_t*)indexObj->GetIndexedPropertiesExternalArrayData();
+    size_t entryCapacity = indexObj->GetIndexedPropertiesExternalArrayDataLength();
+    int64_t offset = 0;
+
+    if (args.Length() > 2 && !args[2]->IsUndefined()) {
+      offset = args[2]->ToInteger()->Value();
+    }
+
+    // Offsets are stored as 32-bit integers, so nothing can be written past 4GB.
+    if (offset < 0 || (uint64_t)offset > capacity || (uint64_t)capacity > 0xffffffffULL) {
+      THROW_RANGE("Offset is outside the target.");
+    }
+
+    self->RecordQueued();
+
+    // Each message is received whole before it's known to fit. Frames are kept as received, so one that doesn't
+    // fit can be stashed, and decompressed copies are made alongside them when needed.
+    std::deque<zmq_msg_t> parts;
+    std::deque<zmq_msg_t> copies;
+    size_t cursor = offset;
+    size_t entries = 0;
+    uint32_t messageCount = 0;
+    bool received = false;
+    bool stashed = false;
+    int rc = 0;
+
+    while (true) {
+      do {
+        parts.push_back(zmq_msg_t());
+        zmq_msg_init(&parts.back());
+
+        rc = self->RecvFrame(&parts.back());
+
+        if (rc == -1) {
+          zmq_msg_close(&parts.back());
+          parts.pop_back();
+        }
+      } while (rc != -1 && zmq_msg_more(&parts.back()));
+
+      // Messages arrive whole, so a partial one only remains if something went badly wrong.
+      if (rc == -1) {
+        for (size_t i = 0; i < parts.size(); i++) {
+          zmq_msg_close(&parts[i]);
+        }
+
+        parts.clear();
+        break;
+      }
+
+      rc = 0;
+      received = true;
+
+      std::deque<zmq_msg_t> *frames = &parts;
+
+      if (self->compressor) {
+        for (size_t i = 0; i < parts.size(); i++) {
+          copies.push_back(zmq_msg_t());
+          zmq_msg_init(&copies.back());
+          zmq_msg_copy(&copies.back(), &parts[i]);
+          self->DecompressFrame(&copies.back());
+        }
+
+        frames = &copies;
+      }
+
+      // A trace frame is recorded rather than returned, but only once the message is known to fit.
+      size_t frameCount = frames->size();
+      uint64_t sent;
+
+      if (self->transitLatency && frameCount > 1 &&
+          DecodeTrace(zmq_msg_data(&frames->back()), zmq_msg_size(&frames->back()), &sent)) {
+        frameCount--;
+      }
+
+      size_t bytes = 0;
+
+      for (size_t i = 0; i < frameCount; i++) {
+        bytes += zmq_msg_size(&(*frames)[i]);
+      }
+
+      bool fits = bytes <= capacity - cursor && 1 + frameCount * 2 <= entryCapacity - entries;
+
+      if (fits) {
+        index[entries++] = frameCount;
+
+        for (size_t i = 0; i < frameCount; i++) {
+          zmq_msg_t *frame = &(*frames)[i];
+          size_t size = zmq_msg_size(frame);
+
+          index[entries++] = cursor;
+          index[entries++] = size;
+
+          memcpy(target + cursor, zmq_msg_data(frame), size);
+          cursor += size;
+        }
+
+        if (frameCount < frames->size()) {
+          self->StripTrace(&frames->back());
+        }
+
+        for (size_t i = 0; i < parts.size(); i++) {
+          self->stats.bytesIn += zmq_msg_size(&(*frames)[i]);
+          zmq_msg_close(&parts[i]);
+        }
+
+        messageCount++;
+      } else {
+        // The message is handed over to the stash as is, for whichever read comes next.
+        for (size_t i = 0; i < parts.size(); i++) {
+          self->stash.push_back(zmq_msg_t());
+          zmq_msg_init(&self->stash.back());
+          zmq_msg_move(&self->stash.back(), &parts[i]);
+          zmq_msg_close(&parts[i]);
+        }
+
+        stashed = true;
+      }
+
+      for (size_t i = 0; i < copies.size(); i++) {
+        zmq_msg_close(&copies[i]);
+      }
+
+      parts.clear();
+      copies.clear();
+
+      if (stashed) {
+        break;
+      }
+    }
+
+    // Any error other than EAGAIN is thrown, now that every received message has been closed (or stashed).
+    bool failed = rc == -1 && zmq_errno() != EAGAIN;
+    int err = zmq_errno();
+
+    // We've just called recv, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterRecv(rc);
+
+    self->stats.messagesIn += messageCount;
+    self->stats.RecordBatch(messageCount);
+
+    if (failed) {
+      return ThrowException(Exception::Error(String::New(zmq_strerror(err))));
+    }
+
+    if (!received) {
+      self->WatchReadable();
+      return scope.Close(Null());
+    }
+
+    // Whatever didn't fit is announced by the check we've just scheduled, on a later tick, just as a budget's is.
+    if (stashed) {
+      self->WatchReadable();
+    }
+
+    return scope.Close(Integer::NewFromUnsigned(messageCount));
+  }
+
+  //
+  // ## Write `Write(message)`
+  //
+  // Writes **message** to the ZMQ socket to be transmitted over the wire at some time in the future.
+  //
+  // Calling stream.write([]) is a no-op with no internal side effects, but can be used for test for Socket
+  // validity.
+  //
+  // Returns true if **message** was queued successfully, or false if the buffer is full (see ZMQ_DONTWAIT/EAGAIN).
+  //
+  // NOTE: Unlike the builtin Duplex class, a return value of `false` indicates the write was _unsuccessful_, and
+  // will need to be tried again.
+  //
+  // A socket with an outbound queue (see `queueBytes`) behaves like the builtin class instead: **message** is
+  // always accepted, queued if ZeroMQ has no room for it, and the return value is false once the queue has reached
+  // its high-water mark, after which `'drain'` is emitted when it's empty again.
+  //
+  Handle<Value> Socket::Write(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be written to.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be written to.");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsArray()) {
+      THROW_TYPE("No message specified.");
+    }
+
+    Local<Array> frames = Local<Array>::Cast(args[0]);
+
+    if (!IsMessage(frames)) {
+      THROW_TYPE("Cannot write non-Buffer message part.");
+    }
+
+    if (self->queueMessages > 0) {
+      int rc = self->QueueMessage(frames);
+      self->CheckAfterSend(rc);
+
+      ZMQ_CHECK(rc);
+
+      if (self->QueueFull()) {
+        self->shouldDrain = true;
+        return scope.Close(Boolean::New(0));
+      }
+
+      return scope.Close(Boolean::New(1));
+    }
+
+    int rc = self->SendMessage(frames);
+
+    // We've just called send, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterSend(rc);
+
+    ZMQ_CHECK(rc);
+
+    if (isEAGAIN(rc)) {
+      self->stats.writeEagains++;
+      self->WatchWritable();
+      return scope.Close(Boolean::New(0));
+    }
+
+    return scope.Close(Boolean::New(1));
+  }
+
+  //
+  // ## WriteMany `WriteMany(messages)`
+  //
+  // Writes as many of **messages**, an Array of Messages, as the ZMQ socket will accept, in order.
+  //
+  // Every frame of every message is validated before anything is sent, and ZMQ_EVENTS is checked once for the
+  // whole batch rather than once per message.
+  //
+  // Returns the number of messages queued successfully. If that's fewer than `messages.length`, the buffer is full
+  // (see ZMQ_DONTWAIT/EAGAIN), and a `'drain'` event will be emitted when the rest can be tried again.
+  //
+  // A socket with an outbound queue accepts every message, so always returns `messages.length`. If the queue has
+  // reached its high-water mark, `'drain'` is emitted once it's empty again.
+  //
+  Handle<Value> Socket::WriteMany(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be written to.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be written to.");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsArray()) {
+      THROW_TYPE("No messages specified.");
+    }
+
+    Local<Array> messages = Local<Array>::Cast(args[0]);
+    uint32_t length = messages->Length();
+    uint32_t sent = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+      Local<Value> message = messages->Get(i);
+
+      if (!message->IsArray()) {
+        THROW_TYPE("Cannot write non-Array message.");
+      }
+
+      if (!IsMessage(Local<Array>::Cast(message))) {
+        THROW_TYPE("Cannot write non-Buffer message part.");
+      }
+    }
+
+    if (self->queueMessages > 0) {
+      int rc = 0;
+
+      for (; sent < length && rc == 0; sent++) {
+        rc = self->QueueMessage(Local<Array>::Cast(messages->Get(sent)));
+      }
+
+      self->CheckAfterSend(rc);
+
+      ZMQ_CHECK(rc);
+
+      // Every message was accepted, so backpressure is only reported by the `'drain'` that follows.
+      if (self->QueueFull()) {
+        self->shouldDrain = true;
+      }
+
+      return scope.Close(Integer::New(sent));
+    }
+
+    if (length == 0) {
+      return scope.Close(Integer::New(0));
+    }
+
+    int rc = 0;
+
+    for (; sent < length; sent++) {
+      rc = self->SendMessage(Local<Array>::Cast(messages->Get(sent)));
+
+      if (rc == -1) {
+        break;
+      }
+    }
+
+    // We've just called send, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterSend(rc);
+
+    ZMQ_CHECK(rc);
+
+    if (isEAGAIN(rc)) {
+      self->stats.writeEagains++;
+      self->WatchWritable();
+    }
+
+    return scope.Close(Integer::NewFromUnsigned(sent));
+  }
+
+  //
+  // ## IsMessage `IsMessage(frames)`
+  //
+  // Returns true if every element of **frames** is a Buffer, and can therefore be sent with `SendMessage`.
+  //
+  bool Socket::IsMessage(Handle<Array> frames) {
+    uint32_t length = frames->Length();
+
+    for (uint32_t i = 0; i < length; i++) {
+      if (!Buffer::HasInstance(frames->Get(i))) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //
+  // ## SendMessage `SendMessage(frames, envelope)`
+  //
+  // Sends **frames**, an already-validated Array of Buffers, to the ZMQ socket as a single multipart message. If
+  // **envelope** isn't NULL, it's sent first, as is, and closed (or sent) whatever happens.
+  //
+  // Returns 0 on success, or -1 if any frame could not be sent (see `zmq_msg_send`), including EAGAIN.
+  //
+  int Socket::SendMessage(Handle<Array> frames, zmq_msg_t *envelope) {
+    uint32_t length = frames->Length();
+    Handle<Object> buffer;
+    size_t size;
+    size_t bytes = 0;
+    int rc;
+
+    if (coalescer && envelope == NULL) {
+      return CoalesceMessage(frames);
+    }
+
+    // Once a message is waiting to be compressed on the threadpool, every message after it has to wait its turn.
+    if (compressor) {
+      bool offload = !compressJobs.empty();
+
+      for (uint32_t i = 0; i < length && !offload; i++) {
+        offload = compressAsyncBytes > 0 && Buffer::Length(frames->Get(i)->ToObject()) >= compressAsyncBytes;
+      }
+
+      if (offload && envelope) {
+        // A job only holds whole messages, so the envelope joins the queue as a Buffer like the rest.
+        Local<Array> message = Array::New(length + 1);
+        message->Set(0, CopyFrame((const char*)zmq_msg_data(envelope), zmq_msg_size(envelope)));
+
+        for (uint32_t i = 0; i < length; i++) {
+          message->Set(i + 1, frames->Get(i));
+        }
+
+        zmq_msg_close(envelope);
+        return QueueCompressed(message);
+      }
+
+      if (offload) {
+        return QueueCompressed(frames);
+      }
+    }
+
+    // A trace frame is only ever added to a message with a body, as `write([])` sends nothing at all.
+    bool trace = transitLatency && length > 0;
+
+    // An IOThread only ever sees whole messages, so there has to be room for all of them up front.
+    if (ioThread && ioThread->Writable() < length + (envelope ? 1 : 0) + (trace ? 1 : 0)) {
+      if (envelope) {
+        zmq_msg_close(envelope);
+      }
+
+      errno = EAGAIN;
+      return -1;
+    }
+
+    if (envelope) {
+      size = zmq_msg_size(envelope);
+      rc = SendFrame(envelope, length > 0 ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
+
+      if (rc == -1) {
+        zmq_msg_close(envelope);
+        return rc;
+      }
+
+      bytes += size;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+      zmq_msg_t part;
+
+      buffer = frames->Get(i)->ToObject();
+      size = Buffer::Length(buffer);
+      rc = InitFrame(&part, buffer);
+
+      if (rc == -1) {
+        return rc;
+      }
+
+      rc = SendFrame(&part, i < length - 1 || trace ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
+
+      if (rc == -1) {
+        // A failed send leaves the message with us, and closing it is what unpins a zero-copy Buffer.
+        zmq_msg_close(&part);
+        return rc;
+      }
+
+      bytes += size;
+    }
+
+    if (trace) {
+      zmq_msg_t part;
+
+      if (zmq_msg_init_size(&part, TRACE_FRAME_SIZE) == -1) {
+        return -1;
+      }
+
+      EncodeTrace((char*)zmq_msg_data(&part), uv_hrtime());
+
+      if (SendFrame(&part, ZMQ_DONTWAIT) == -1) {
+        zmq_msg_close(&part);
+        return -1;
+      }
+    }
+
+    stats.messagesOut++;
+    stats.bytesOut += bytes;
+
+    return 0;
+  }
+
+  //
+  // ## InitFrame `InitFrame(part, buffer)`
+  //
+  // Initializes **part** with the contents of **buffer**, compressed, pinned or copied as the socket is
+  // configured to. Behaves like `zmq_msg_init_size`.
+  //
+  int Socket::InitFrame(zmq_msg_t *part, Handle<Object> buffer) {
+    size_t size = Buffer::Length(buffer);
+
+    if (compressor && size >= compressor->MinBytes()) {
+      return CompressFrame(part, Buffer::Data(buffer), size);
+    }
+
+    if (zeroCopyWrites > 0 && size >= zeroCopyWrites) {
+      return PinnedBuffer::InitMessage(part, buffer);
+    }
+
+    int rc = zmq_msg_init_size(part, size);
+
+    if (rc == 0) {
+      memcpy(zmq_msg_data(part), Buffer::Data(buffer), size);
+    }
+
+    return rc;
+  }
+
+  //
+  // ## CoalesceMessage `CoalesceMessage(frames)`
+  //
+  // Adds **frames**, exactly like `SendMessage` would send them, to the batch being coalesced, flushing it if
+  // that makes it full. The first message of a batch starts the timer that flushes whatever else joins it.
+  //
+  // Returns 0 on success, or -1 with EAGAIN while a full batch is still waiting for room to be sent.
+  //
+  int Socket::CoalesceMessage(Handle<Array> frames) {
+    uint32_t length = frames->Length();
+    size_t bytes = 0;
+
+    if (coalesceStalled) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    coalescer->BeginMessage(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+      Local<Object> buffer = frames->Get(i)->ToObject();
+
+      coalescer->AppendFrame(Buffer::Data(buffer), Buffer::Length(buffer));
+      bytes += Buffer::Length(buffer);
+    }
+
+    stats.messagesOut++;
+    stats.bytesOut += bytes;
+
+    // A batch that can't be sent yet keeps its message, so the write still succeeds.
+    if (coalescer->Full()) {
+      FlushBatch();
+    } else if (coalescer->Messages() == 1) {
+      uv_timer_start(coalesceTimer, FlushTimer, coalesceMillis, 0);
+    }
+
+    return 0;
+  }
+
+  //
+  // ## FlushBatch `FlushBatch()`
+  //
+  // Sends the batch being coalesced, if there is one, as a marker frame followed by the batch frame. If there's
+  // no room to, the socket stalls, refusing writes until a check finds room and flushes it.
+  //
+  // Returns 0 on success, or -1 if the batch could not be sent (see `zmq_msg_send`), including EAGAIN.
+  //
+  int Socket::FlushBatch() {
+    zmq_msg_t part;
+    size_t size;
+    int rc;
+
+    uv_timer_stop(coalesceTimer);
+
+    if (coalescer->Messages() == 0) {
+      return 0;
+    }
+
+    // Both frames have to be accepted, as a message can't be taken back once its first frame has been sent.
+    if (ioThread ? ioThread->Writable() < 2 : !(Events() & ZMQ_POLLOUT)) {
+      coalesceStalled = true;
+
+      // An IOThread notifies us about room in its Ring on its own.
+      if (!ioThread) {
+        uv_poll_start(pollHandle, UV_READABLE, Check);
+      }
+
+      errno = EAGAIN;
+      return -1;
+    }
+
+    if (zmq_msg_init_size(&part, BATCH_MARKER_SIZE) == -1) {
+      return -1;
+    }
+
+    memcpy(zmq_msg_data(&part), BATCH_MARKER, BATCH_MARKER_SIZE);
+
+    rc = SendFrame(&part, ZMQ_SNDMORE | ZMQ_DONTWAIT);
+
+    if (rc == -1) {
+      zmq_msg_close(&part);
+      return rc;
+    }
+
+    char *batch = coalescer->Take(&size);
+
+    // Batches are small enough to compress right here, and much more compressible than the messages within them.
+    if (compressor) {
+      rc = CompressFrame(&part, batch, size);
+      Coalescer::Free(batch, NULL);
+
+      if (rc == -1) {
+        return rc;
+      }
+    } else if (zmq_msg_init_data(&part, batch, size, Coalescer::Free, NULL) == -1) {
+      Coalescer::Free(batch, NULL);
+      return -1;
+    }
+
+    rc = SendFrame(&part, ZMQ_DONTWAIT);
+
+    if (rc == -1) {
+      zmq_msg_close(&part);
+      return rc;
+    }
+
+    coalesceStalled = false;
+
+    // We've just called send, and are required to check ZMQ_EVENTS.
+    ScheduleCheck();
+
+    return 0;
+  }
+
+  //
+  // ## FlushTimer
+  //
+  // A `uv_timer_cb` flushing a partial batch once it's waited long enough for company.
+  //
+  void Socket::FlushTimer(uv_timer_t *handle, int status) {
+    assert(handle);
+
+    Socket *self = (Socket*)handle->data;
+    assert(self);
+
+    if (self->socket == NULL || self->proxy) {
+      return;
+    }
+
+    self->FlushBatch();
+  }
+
+  //
+  // ## CompressFrame `CompressFrame(part, data, size)`
+  //
+  // Initializes **part** with the **size** bytes at **data**, compressed if that makes them smaller. Behaves like
+  // `zmq_msg_init_size`.
+  //
+  int Socket::CompressFrame(zmq_msg_t *part, const char *data, size_t size) {
+    uint64_t start = uv_hrtime();
+    char *compressed;
+    size_t compressedSize = compressor->Compress(compressContext, data, size, &compressed);
+
+    stats.compressNanos += uv_hrtime() - start;
+    stats.compressFrames++;
+    stats.compressBytesIn += size;
+
+    if (compressedSize > 0) {
+      stats.compressedFrames++;
+      stats.compressBytesOut += compressedSize;
+
+      return zmq_msg_init_data(part, compressed, compressedSize, Compressor::Free, NULL);
+    }
+
+    stats.compressBytesOut += size;
+
+    if (zmq_msg_init_size(part, size) == -1) {
+      return -1;
+    }
+
+    memcpy(zmq_msg_data(part), data, size);
+
+    return 0;
+  }
+
+  //
+  // ## DecompressFrame `DecompressFrame(part)`
+  //
+  // Replaces **part** with its decompressed form if it's a compressed frame. Corrupt frames are left as they are.
+  //
+  void Socket::DecompressFrame(zmq_msg_t *part) {
+    if (!Compressor::IsCompressed(zmq_msg_data(part), zmq_msg_size(part))) {
+      return;
+    }
+
+    uint64_t start = uv_hrtime();
+    char *data;
+    ssize_t size = compressor->Decompress((const char*)zmq_msg_data(part), zmq_msg_size(part), &data);
+
+    stats.decompressNanos += uv_hrtime() - start;
+
+    if (size < 0) {
+      stats.decompressErrors++;
+      return;
+    }
+
+    stats.decompressedFrames++;
+    stats.decompressBytesIn += zmq_msg_size(part);
+    stats.decompressBytesOut += size;
+
+    zmq_msg_close(part);
+    assert(zmq_msg_init_data(part, data, size, Compressor::Free, NULL) == 0);
+  }
+
+  //
+  // ## QueueCompressed `QueueCompressed(frames)`
+  //
+  // Queues a copy of **frames** as a CompressJob behind those already waiting, compressing it on the threadpool if
+  // any frame is at least `compressAsyncBytes` bytes, or right away otherwise.
+  //
+  // Returns 0 on success, or -1 with EAGAIN if `MAX_COMPRESS_JOBS` messages are already waiting.
+  //
+  int Socket::QueueCompressed(Handle<Array> frames) {
+    uint32_t length = frames->Length();
+    bool offload = false;
+    size_t bytes = 0;
+
+    if (compressJobs.size() >= MAX_COMPRESS_JOBS) {
+      errno = EAGAIN;
+      return -1;
+    }
+
+    CompressJob *job = new CompressJob();
+    job->request.data = job;
+    job->socket = this;
+    job->compressor = compressor;
+    job->done = false;
+    job->orphaned = false;
+    job->frameBytes = 0;
+    job->compressedBytes = 0;
+    job->compressedFrames = 0;
+    job->nanos = 0;
+    job->frames.resize(transitLatency && length > 0 ? length + 1 : length);
+
+    for (uint32_t i = 0; i < length; i++) {
+      Local<Object> buffer = frames->Get(i)->ToObject();
+      CompressJob::Frame *frame = &job->frames[i];
+
+      // The Buffer may well be reused as soon as this returns, so the job needs a copy of its own.
+      frame->size = Buffer::Length(buffer);
+      frame->data = (char*)malloc(frame->size > 0 ? frame->size : 1);
+      assert(frame->data);
+      memcpy(frame->data, Buffer::Data(buffer), frame->size);
+
+      bytes += frame->size;
+      offload = offload || (compressAsyncBytes > 0 && frame->size >= compressAsyncBytes);
+    }
+
+    // The message is traced from the moment it was written, time spent waiting to be compressed included.
+    if (job->frames.size() > length) {
+      CompressJob::Frame *frame = &job->frames[length];
+
+      frame->size = TRACE_FRAME_SIZE;
+      frame->data = (char*)malloc(TRACE_FRAME_SIZE);
+      assert(frame->data);
+      EncodeTrace(frame->data, uv_hrtime());
+    }
+
+    compressJobs.push_back(job);
+
+    stats.messagesOut++;
+    stats.bytesOut += bytes;
+
+    if (offload) {
+      // The job refers back to the Socket, which has to stay around until it returns.
+      Ref();
+      stats.compressOffloaded++;
+      assert(uv_queue_work(uv_default_loop(), &job->request, RunCompressJob, AfterCompressJob) == 0);
+    } else {
+      job->Compress(compressContext);
+      job->done = true;
+      RecordCompression(job);
+    }
+
+    return 0;
+  }
+
+  //
+  // ## SendCompressed `SendCompressed()`
+  //
+  // Sends every CompressJob that's done from the front of `compressJobs`, for as long as there is room.
+  //
+  // Returns 0 once none are left to send, or -1 if any could not be sent (see `zmq_msg_send`), including EAGAIN.
+  //
+  int Socket::SendCompressed() {
+    int rc = 0;
+
+    while (!compressJobs.empty() && compressJobs.front()->done) {
+      CompressJob *job = compressJobs.front();
+      size_t length = job->frames.size();
+
+      // An IOThread only ever sees whole messages, so there has to be room for all of them up front.
+      if (ioThread ? ioThread->Writable() < length : !(Events() & ZMQ_POLLOUT)) {
+        // An IOThread notifies us about room in its Ring on its own.
+        if (!ioThread) {
+          uv_poll_start(pollHandle, UV_READABLE, Check);
+        }
+
+        errno = EAGAIN;
+        rc = -1;
+        break;
+      }
+
+      compressJobs.pop_front();
+
+      for (size_t i = 0; i < length && rc == 0; i++) {
+        CompressJob::Frame *frame = &job->frames[i];
+        zmq_msg_t part;
+
+        // The message takes over the frame, and releases it once ZeroMQ is done with it.
+        rc = zmq_msg_init_data(&part, frame->data, frame->size, Compressor::Free, NULL);
+        assert(rc == 0);
+        frame->data = NULL;
+
+        rc = SendFrame(&part, i < length - 1 ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
+
+        if (rc == -1) {
+          zmq_msg_close(&part);
+        }
+      }
+
+      delete job;
+
+      // As with `SendMessage`, a message that fails after ZMQ_EVENTS promised room for it is dropped.
+      if (rc == -1) {
+        break;
+      }
+    }
+
+    // We've just called send, and are required to check ZMQ_EVENTS.
+    ScheduleCheck();
+
+    return rc < 0 ? -1 : 0;
+  }
+
+  //
+  // ## RecordCompression `RecordCompression(job)`
+  //
+  // Adds the compression counters of **job** to the socket's own.
+  //
+  void Socket::RecordCompression(CompressJob *job) {
+    stats.compressFrames += job->frames.size();
+    stats.compressBytesIn += job->frameBytes;
+    stats.compressBytesOut += job->compressedBytes;
+    stats.compressedFrames += job->compressedFrames;
+    stats.compressNanos += job->nanos;
+  }
+
+  //
+  // ## QueueMessage `QueueMessage(frames)`
+  //
+  // Sends **frames** if nothing is queued ahead of it and there's room, and queues it in `outbound` otherwise, to be
+  // sent from `Check` once there's room for it.
+  //
+  // Returns 0 on success, whether **frames** was sent or queued, or -1 if it could be neither.
+  //
+  int Socket::QueueMessage(Handle<Array> frames) {
+    uint32_t length = frames->Length();
+
+    // Most of the time nothing is queued, and the message goes straight out just as it would without a queue.
+    if (outbound.empty()) {
+      int rc = SendMessage(frames);
+
+      if (!isEAGAIN(rc)) {
+        return rc;
+      }
+    }
+
+    if (length == 0) {
+      return 0;
+    }
+
+    // The message is traced from the moment it was written, time spent in the queue included.
+    QueuedMessage *message = new QueuedMessage();
+    message->parts.resize(transitLatency ? length + 1 : length);
+    message->ready = 0;
+    message->bytes = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+      Local<Object> buffer = frames->Get(i)->ToObject();
+
+      if (InitFrame(&message->parts[i], buffer) == -1) {
+        delete message;
+        return -1;
+      }
+
+      message->ready++;
+      message->bytes += Buffer::Length(buffer);
+    }
+
+    if (transitLatency) {
+      zmq_msg_t *part = &message->parts[length];
+
+      if (zmq_msg_init_size(part, TRACE_FRAME_SIZE) == -1) {
+        delete message;
+        return -1;
+      }
+
+      message->ready++;
+      EncodeTrace((char*)zmq_msg_data(part), uv_hrtime());
+    }
+
+    outbound.push_back(message);
+    outboundBytes += message->bytes;
+    stats.queuedMessages++;
+
+    uv_poll_start(pollHandle, UV_READABLE, Check);
+
+    return 0;
+  }
+
+  //
+  // ## SendQueued `SendQueued()`
+  //
+  // Sends messages from the front of `outbound` for as long as there is room.
+  //
+  // Returns 0 once none are left to send, or -1 if any could not be sent (see `zmq_msg_send`), including EAGAIN.
+  //
+  int Socket::SendQueued() {
+    int rc = 0;
+
+    while (!outbound.empty()) {
+      QueuedMessage *message = outbound.front();
+      size_t length = message->parts.size();
+
+      // ZeroMQ only ever refuses a whole message for want of room, by refusing its first frame.
+      rc = SendFrame(&message->parts[0], length > 1 ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
+
+      if (isEAGAIN(rc)) {
+        break;
+      }
+
+      for (size_t i = 1; i < length && rc == 0; i++) {
+        rc = SendFrame(&message->parts[i], i < length - 1 ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
+      }
+
+      outbound.pop_front();
+      outboundBytes -= message->bytes;
+
+      if (rc == 0) {
+        stats.messagesOut++;
+        stats.bytesOut += message->bytes;
+      }
+
+      delete message;
+
+      // As with `SendMessage`, a message that fails after its first frame was accepted is dropped.
+      if (rc == -1) {
+        break;
+      }
+    }
+
+    return rc < 0 ? -1 : 0;
+  }
+
+  //
+  // ## QueueFull `QueueFull()`
+  //
+  // Returns true if `outbound` has reached either of its high-water marks.
+  //
+  bool Socket::QueueFull() {
+    return outboundBytes >= queueBytes || outbound.size() >= queueMessages;
+  }
+
+  Socket::QueuedMessage::~QueuedMessage() {
+    // Sent frames are left empty by ZeroMQ, and closing those is harmless.
+    for (size_t i = 0; i < ready; i++) {
+      zmq_msg_close(&parts[i]);
+    }
+  }
+
+  Socket::CompressJob::~CompressJob() {
+    for (size_t i = 0; i < frames.size(); i++) {
+      Compressor::Free(frames[i].data, NULL);
+    }
+  }
+
+  //
+  // ## Compress `Compress(context)`
+  //
+  // Compresses each frame of at least `compressor->MinBytes()` bytes, given a **context** from `compressor` that
+  // only this thread is using. Frames that don't shrink are left as they are.
+  //
+  void Socket::CompressJob::Compress(void *context) {
+    uint64_t start = uv_hrtime();
+
+    for (size_t i = 0; i < frames.size(); i++) {
+      Frame *frame = &frames[i];
+      char *compressed;
+      size_t compressedSize = compressor->Compress(context, frame->data, frame->size, &compressed);
+
+      frameBytes += frame->size;
+
+      if (compressedSize > 0) {
+        Compressor::Free(frame->data, NULL);
+        frame->data = compressed;
+        frame->size = compressedSize;
+        compressedFrames++;
+      }
+
+      compressedBytes += frame->size;
+    }
+
+    nanos += uv_hrtime() - start;
+  }
+
+  //
+  // ## RunCompressJob
+  //
+  // A `uv_work_cb` compressing a CompressJob's frames on libuv's threadpool. Only the job itself is touched.
+  //
+  void Socket::RunCompressJob(uv_work_t *request) {
+    CompressJob *job = (CompressJob*)request->data;
+    void *context = job->compressor->NewContext();
+
+    job->Compress(context);
+
+    job->compressor->FreeContext(context);
+  }
+
+  //
+  // ## AfterCompressJob
+  //
+  // A `uv_after_work_cb` sending a CompressJob's message, and any queued behind it, once it's been compressed.
+  //
+  void Socket::AfterCompressJob(uv_work_t *request, int status) {
+    CompressJob *job = (CompressJob*)request->data;
+    Socket *self = job->socket;
+
+    if (job->orphaned) {
+      delete job;
+      self->Unref();
+      return;
+    }
+
+    job->done = true;
+    self->RecordCompression(job);
+
+    // A proxied socket belongs to another thread, and sends what's waiting once it's taken back and checked.
+    if (!self->proxy) {
+      self->SendCompressed();
+    }
+
+    self->Unref();
+  }
+
+  //
+  // ## RecvFrame `RecvFrame(part)`
+  //
+  // Receives the next frame into **part** without blocking, either straight from the ZMQ socket or, for sockets
+  // owned by an IOThread, from its incoming Ring. Frames in `stash` come first. Behaves like `zmq_msg_recv`.
+  //
+  int Socket::RecvFrame(zmq_msg_t *part) {
+    if (!stash.empty()) {
+      int rc = zmq_msg_move(part, &stash.front());
+
+      zmq_msg_close(&stash.front());
+      stash.pop_front();
+
+      return rc == -1 ? rc : (int)zmq_msg_size(part);
+    }
+
+    if (ioThread) {
+      return ioThread->Recv(part);
+    }
+
+    return zmq_msg_recv(part, socket, ZMQ_DONTWAIT);
+  }
+
+  //
+  // ## SendFrame `SendFrame(part, flags)`
+  //
+  // Sends **part** without blocking, either straight to the ZMQ socket or, for sockets owned by an IOThread, to
+  // its outgoing Ring. Behaves like `zmq_msg_send`.
+  //
+  int Socket::SendFrame(zmq_msg_t *part, int flags) {
+    if (ioThread) {
+      return ioThread->Send(part, flags);
+    }
+
+    return zmq_msg_send(part, socket, flags);
+  }
+
+  //
+  // ## ScheduleCheck `ScheduleCheck()`
+  //
+  // Arranges for ZMQ_EVENTS to be checked "soon", as is required after every send and recv.
+  //
+  void Socket::ScheduleCheck() {
+    // An IOThread does its own checking, but may be waiting on the Rings we've just changed.
+    if (ioThread) {
+      ioThread->Wake();
+      return;
+    }
+
+    Poller::MarkDirty(this);
+  }
+
+  //
+  // ## Waiting `Waiting()`
+  //
+  // Returns true if a check could do anything other than emit `'readable'`.
+  //
+  bool Socket::Waiting() {
+    return shouldDrain || coalesceStalled || !compressJobs.empty() || !outbound.empty() || !forwardWaiters.empty() ||
+           forwarding || subscriptions || monitoring;
+  }
+
+  //
+  // ## Spinning `Spinning(now)`
+  //
+  // Returns true if the socket should be busy polled at **now**: it's waiting to be readable, on the main thread,
+  // and was last read from or written to less than `busyPollNanos` ago.
+  //
+  bool Socket::Spinning(uint64_t now) {
+    return socket && !proxy && !ioThread && !forwarding && canRead && shouldReadable &&
+           now - lastActive < busyPollNanos;
+  }
+
+  //
+  // ## CheckAfterRecv `CheckAfterRecv(rc)`
+  //
+  // Schedules the check required after a read that ended with **rc**, unless it can't find anything new. A recv
+  // that fails with EAGAIN has just processed every pending command and reset the fd, which will be signaled as
+  // soon as another message arrives, so a socket only waiting to be readable needn't be checked.
+  //
+  void Socket::CheckAfterRecv(int rc) {
+    if (busyPollNanos) {
+      lastActive = uv_hrtime();
+    }
+
+    if (ioThread || !isEAGAIN(rc) || Waiting()) {
+      ScheduleCheck();
+    }
+  }
+
+  //
+  // ## CheckAfterSend `CheckAfterSend(rc)`
+  //
+  // Schedules the check required after a write that ended with **rc**, unless it can't find anything new. A socket
+  // that can't receive, and isn't waiting for room, has nothing to learn from ZMQ_EVENTS after a successful send.
+  //
+  void Socket::CheckAfterSend(int rc) {
+    if (busyPollNanos) {
+      lastActive = uv_hrtime();
+    }
+
+    if (ioThread || canRead || rc == -1 || Waiting()) {
+      ScheduleCheck();
+    }
+  }
+
+  //
+  // ## WatchReadable `WatchReadable()`
+  //
+  // Arranges for `'readable'` to be emitted once there is something to read.
+  //
+  void Socket::WatchReadable() {
+    shouldReadable = true;
+
+    // An IOThread notifies us about new messages on its own.
+    if (!ioThread) {
+      uv_poll_start(pollHandle, UV_READABLE, Check);
+    }
+  }
+
+  //
+  // ## WatchWritable `WatchWritable()`
+  //
+  // Arranges for `'drain'` to be emitted once there is room to write.
+  //
+  void Socket::WatchWritable() {
+    shouldDrain = true;
+
+    // An IOThread notifies us about room in its Ring on its own.
+    if (!ioThread) {
+      uv_poll_start(pollHandle, UV_READABLE, Check);
+    }
+  }
+
+  //
+  // ## Events `Events()`
+  //
+  // Returns ZMQ_EVENTS for the socket, or its IOThread's equivalent. Returns -1 on failure.
+  //
+  int Socket::Events() {
+    int events = 0;
+    size_t size = sizeof events;
+
+    if (ioThread) {
+      return ioThread->Events();
+    }
+
+    if (zmq_getsockopt(socket, ZMQ_EVENTS, &events, &size) < 0) {
+      return -1;
+    }
+
+    return events;
+  }
+
+  //
+  // ## ForwardTo `ForwardTo(target, options)`
+  //
+  // Forwards every message received from here on to the Socket **target** natively, during the checks that
+  // would otherwise emit `'readable'`, until called again with null. Supported options:
+  //
+  // - `prefix`: Only forward messages whose first frame starts with this Buffer or String.
+  // - `drop`: Drop messages whose first frame starts with this Buffer or String.
+  // - `tee`: Also send a copy of every forwarded message to this Socket, whenever it has room.
+  //
+  Handle<Value> Socket::ForwardTo(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot forward messages.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot forward messages.");
+    }
+
+    if (self->subscriptions) {
+      THROW_REF("Socket reads its own subscriptions, and cannot forward messages.");
+    }
+
+    if (self->monitoring) {
+      THROW_REF("Socket reads its own monitor events, and cannot forward messages.");
+    }
+
+    if (args.Length() < 1 || args[0]->IsNull() || args[0]->IsUndefined()) {
+      self->StopForwarding();
+      return scope.Close(Undefined());
+    }
+
+    if (!HasInstance(args[0])) {
+      THROW_TYPE("No Socket specified to forward to.");
+    }
+
+    Handle<Object> options = args[1]->IsObject() ? args[1]->ToObject() : Object::New();
+    Handle<Value> prefix = options->Get(String::NewSymbol("prefix"));
+    Handle<Value> drop = options->Get(String::NewSymbol("drop"));
+    Handle<Value> teeObj = options->Get(String::NewSymbol("tee"));
+
+    if (!teeObj->IsUndefined() && !teeObj->IsNull() && !HasInstance(teeObj)) {
+      THROW_TYPE("Invalid tee socket specified.");
+    }
+
+    Socket *targets[2] = {
+      THIS_TO_SOCKET(args[0]->ToObject()),
+      HasInstance(teeObj) ? THIS_TO_SOCKET(teeObj->ToObject()) : NULL
+    };
+
+    for (int i = 0; i < 2; i++) {
+      Socket *target = targets[i];
+
+      if (target == NULL) {
+        continue;
+      }
+
+      if (target == self) {
+        THROW_TYPE("A Socket cannot forward to itself.");
+      }
+
+      if (target->socket == NULL) {
+        THROW_REF("Socket is closed, and cannot be forwarded to.");
+      }
+
+      if (target->proxy) {
+        THROW_REF("Socket is in use by a proxy, and cannot be forwarded to.");
+      }
+
+      // Messages are sent one frame at a time, which an IOThread can't take back if its Ring fills up part way.
+      if (target->ioThread) {
+        THROW_TYPE("Sockets with an ioThread cannot be forwarded to.");
+      }
+
+      // Forwarded messages are sent directly, so they'd jump ahead of the open batch rather than joining it.
+      if (target->coalescer) {
+        THROW_TYPE("Sockets with coalesce cannot be forwarded to.");
+      }
+
+      // Likewise, forwarded messages would overtake any still being compressed on the threadpool.
+      if (target->compressor) {
+        THROW_TYPE("Sockets with compress cannot be forwarded to.");
+      }
+
+      // Likewise for messages waiting in its outbound queue.
+      if (target->queueMessages > 0) {
+        THROW_TYPE("Sockets with an outbound queue cannot be forwarded to.");
+      }
+    }
+
+    self->StopForwarding();
+
+    Forwarding *forwarding = new Forwarding;
+    forwarding->target = targets[0];
+    forwarding->tee = targets[1];
+    forwarding->targetHandle = Persistent<Object>::New(args[0]->ToObject());
+    forwarding->hasDrop = !drop->IsUndefined() && !drop->IsNull();
+    forwarding->blocked = false;
+
+    if (forwarding->tee) {
+      forwarding->teeHandle = Persistent<Object>::New(teeObj->ToObject());
+    }
+
+    if (!prefix->IsUndefined() && !prefix->IsNull()) {
+      toBytes(prefix, &forwarding->prefix);
+    }
+
+    if (forwarding->hasDrop) {
+      toBytes(drop, &forwarding->drop);
+    }
+
+    self->forwarding = forwarding;
+
+    // Messages may already be waiting, and the fd won't be signaled for those.
+    if (!self->ioThread) {
+      uv_poll_start(self->pollHandle, UV_READABLE, Check);
+    }
+
+    Poller::MarkDirty(self);
+
+    return scope.Close(Undefined());
+  }
+
+  //
+  // ## StopForwarding `StopForwarding()`
+  //
+  // Stops forwarding messages, if the socket is.
+  //
+  void Socket::StopForwarding() {
+    Forwarding *forwarding = this->forwarding;
+
+    if (forwarding == NULL) {
+      return;
+    }
+
+    std::vector<Socket*> &waiters = forwarding->target->forwardWaiters;
+
+    for (size_t i = 0; i < waiters.size(); i++) {
+      if (waiters[i] == this) {
+        waiters.erase(waiters.begin() + i);
+        break;
+      }
+    }
+
+    forwarding->targetHandle.Dispose();
+
+    if (!forwarding->teeHandle.IsEmpty()) {
+      forwarding->teeHandle.Dispose();
+    }
+
+    delete forwarding;
+    this->forwarding = NULL;
+
+    // Anything left unread is `'readable'` again, if the application is waiting for it.
+    Poller::MarkDirty(this);
+  }
+
+  //
+  // ## Forward `Forward()`
+  //
+  // Moves a batch of messages from the socket to its forwarding target without creating any JS objects, stopping
+  // early (and blocking) if the target fills up.
+  //
+  void Socket::Forward() {
+    Forwarding *forwarding = this->forwarding;
+    Socket *target = forwarding->target;
+    Socket *tee = forwarding->tee;
+    bool received = false;
+    zmq_msg_t part;
+
+    // Either may have been closed (or lent to a Proxy) since forwarding began.
+    if (target->socket == NULL || target->proxy) {
+      StopForwarding();
+      return;
+    }
+
+    if (tee && (tee->socket == NULL || tee->proxy)) {
+      tee = NULL;
+    }
+
+    for (int i = 0; i < FORWARD_BATCH_SIZE; i++) {
+      int events = target->Events();
+
+      // Backpressure: stop reading until the target has room, which it'll let us know about during its own check.
+      if (events < 0 || !(events & ZMQ_POLLOUT)) {
+        forwarding->blocked = true;
+        target->forwardWaiters.push_back(this);
+
+        if (!target->ioThread) {
+          uv_poll_start(target->pollHandle, UV_READABLE, Check);
         }
         break;
-      // uint64_t
-      case ZMQ_AFFINITY:
-        {
-          size = sizeof(uint64_t);
-          uint64_t value;
-          rc = zmq_getsockopt(self->socket, type, &value, &size);
-          retval = Number::New(value);
-        }
+      }
+
+      zmq_msg_init(&part);
+
+      if (RecvFrame(&part) == -1) {
+        zmq_msg_close(&part);
         break;
-      // int64_t
-      case ZMQ_MAXMSGSIZE:
-        {
-          size = sizeof(int64_t);
-          int64_t value;
-          rc = zmq_getsockopt(self->socket, type, &value, &size);
-          retval = Number::New(value);
+      }
+
+      received = true;
+
+      size_t size = zmq_msg_size(&part);
+      const char *data = (const char*)zmq_msg_data(&part);
+      const std::string &prefix = forwarding->prefix;
+      const std::string &drop = forwarding->drop;
+      bool keep = size >= prefix.size() && memcmp(data, prefix.data(), prefix.size()) == 0;
+
+      if (forwarding->hasDrop && size >= drop.size() && memcmp(data, drop.data(), drop.size()) == 0) {
+        keep = false;
+      }
+
+      // Once a message's first frame has been refused, the rest of it has to be discarded as well.
+      bool teeDropped = tee == NULL || !keep;
+      size_t bytes = 0;
+      int more;
+
+      do {
+        more = zmq_msg_more(&part);
+        bytes += zmq_msg_size(&part);
+
+        if (!teeDropped) {
+          zmq_msg_t copy;
+
+          zmq_msg_init(&copy);
+          zmq_msg_copy(&copy, &part);
+
+          if (tee->SendFrame(&copy, (more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT) == -1) {
+            zmq_msg_close(&copy);
+            teeDropped = true;
+          }
         }
-        break;
+
+        // ZMQ_EVENTS promised room for this message, so only errors (e.g. an unroutable ROUTER message) refuse it.
+        if (keep && target->SendFrame(&part, (more ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT) == -1) {
+          keep = false;
+        }
+
+        // The remaining frames of a message always arrive together with the first.
+        if (more && RecvFrame(&part) == -1) {
+          break;
+        }
+      } while (more);
+
+      zmq_msg_close(&part);
+
+      stats.messagesIn++;
+      stats.bytesIn += bytes;
+
+      if (keep) {
+        stats.forwarded++;
+        target->stats.messagesOut++;
+        target->stats.bytesOut += bytes;
+      } else {
+        stats.filtered++;
+      }
+    }
+
+    // We've just called recv and send, and are required to check ZMQ_EVENTS on both ends.
+    if (received) {
+      ScheduleCheck();
+      target->ScheduleCheck();
+
+      if (tee) {
+        tee->ScheduleCheck();
+      }
+    }
+  }
+
+  //
+  // ## HasSubscribers `HasSubscribers(topic)`
+  //
+  // Returns true if any subscription of an XPUB socket tracking them (see `trackSubscriptions`) is a prefix of
+  // **topic**, a Buffer or String. Without **topic**, returns true if there are any subscriptions at all.
+  //
+  // Buffers are matched in place, so checking one costs a lookup per byte and nothing more.
+  //
+  Handle<Value> Socket::HasSubscribers(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->subscriptions == NULL) {
+      THROW_TYPE("Socket does not track its subscriptions (see trackSubscriptions).");
+    }
+
+    if (args.Length() < 1 || args[0]->IsUndefined()) {
+      return scope.Close(Boolean::New(self->subscriptions->Size() > 0));
+    }
+
+    if (Buffer::HasInstance(args[0])) {
+      Local<Object> topic = args[0]->ToObject();
+
+      return scope.Close(Boolean::New(self->subscriptions->Matches(Buffer::Data(topic), Buffer::Length(topic))));
+    }
+
+    String::Utf8Value topic(args[0]->ToString());
+
+    return scope.Close(Boolean::New(self->subscriptions->Matches(*topic, topic.length())));
+  }
+
+  //
+  // ## ReadRequests `ReadRequests(size)`
+  //
+  // Consumes a maximum of **size** messages (or a budget) from a ROUTER socket interning its peers' identities (see
+  // `internIdentities`), exactly like `Read`. Each message is returned as an Object with `peer`, the handle of the
+  // identity it came from, and `body`, an Array of the rest of its frames as Node Buffers. The identity itself is
+  // never turned into a Buffer, so telling peers apart costs a single hash lookup per message.
+  //
+  // Returns null if there is no data to consume, just like `Read`.
+  //
+  Handle<Value> Socket::ReadRequests(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be read from.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be read from.");
+    }
+
+    if (self->peers == NULL) {
+      THROW_TYPE("Socket does not intern its peers' identities (see internIdentities).");
+    }
+
+    ReadBudget budget;
+
+    if (args.Length() > 0) {
+      toBudget(args[0], &budget);
+    }
+
+    int size = budget.messages;
+
+    if (size == 0) {
+      return scope.Close(Null());
+    }
+
+    self->RecordQueued();
+
+    int rc = 0;
+    zmq_msg_t part;
+    Handle<Array> requests = Array::New();
+    Handle<Array> body;
+    // The current message's peer, which is only known once its first frame has been received.
+    uint32_t peer = 0;
+    bool first = true;
+    size_t bytes = 0;
+    bool spent = false;
+
+    do {
+      ZMQ_CHECK(zmq_msg_init(&part));
+
+      rc = self->RecvFrame(&part);
+      ZMQ_CHECK(rc);
+
+      if (!isEAGAIN(rc)) {
+        rc = 0;
+
+        bool more = zmq_msg_more(&part);
+
+        if (first) {
+          peer = self->peers->Intern((const char*)zmq_msg_data(&part), zmq_msg_size(&part));
+          body = Array::New();
+          first = false;
+        } else {
+          if (self->compressor) {
+            self->DecompressFrame(&part);
+          }
+
+          // A trace frame is recorded rather than returned.
+          if (more || body->Length() == 0 || !self->StripTrace(&part)) {
+            body->Set(body->Length(), self->CreateFrame(&part));
+          }
+        }
+
+        self->stats.bytesIn += zmq_msg_size(&part);
+        bytes += zmq_msg_size(&part);
+
+        if (!more) {
+          Local<Object> request = Object::New();
+          request->Set(String::NewSymbol("peer"), Integer::NewFromUnsigned(peer));
+          request->Set(String::NewSymbol("body"), body);
+
+          requests->Set(requests->Length(), request);
+          size--;
+          first = true;
+          spent = budget.Spent(bytes);
+        }
+      }
+
+      ZMQ_CHECK(zmq_msg_close(&part));
+    } while (rc == 0 && size != 0 && !spent);
+
+    // We've just called recv, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterRecv(rc);
+
+    // Whatever the budget left behind is announced by the check we've just scheduled, on a later tick.
+    if (budget.rearm && rc == 0) {
+      self->WatchReadable();
+    }
+
+    self->stats.messagesIn += requests->Length();
+    self->stats.RecordBatch(requests->Length());
+
+    if (requests->Length() == 0) {
+      self->WatchReadable();
+      return scope.Close(Null());
+    }
+
+    return scope.Close(requests);
+  }
+
+  //
+  // ## Reply `Reply(peer, frames)`
+  //
+  // Writes **frames**, an Array of Buffers, to **peer**, a handle returned by `ReadRequests`. The peer's interned
+  // identity message is copied rather than rebuilt, so a reply costs no more than a `Write` of **frames** alone.
+  //
+  // Returns true if the reply was queued successfully, or false if the buffer is full, just like `Write`. Replies to
+  // peers that have since disconnected are dropped by ZMQ, and still return true.
+  //
+  Handle<Value> Socket::Reply(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be written to.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be written to.");
+    }
+
+    if (self->peers == NULL) {
+      THROW_TYPE("Socket does not intern its peers' identities (see internIdentities).");
+    }
+
+    if (args.Length() < 2 || !args[0]->IsUint32() || !args[1]->IsArray()) {
+      THROW_TYPE("No peer and message specified.");
+    }
+
+    Local<Array> frames = Local<Array>::Cast(args[1]);
+
+    if (frames->Length() == 0 || !IsMessage(frames)) {
+      THROW_TYPE("Cannot write non-Buffer message part.");
     }
 
+    zmq_msg_t envelope;
+
+    if (!self->peers->Copy(args[0]->Uint32Value(), &envelope)) {
+      THROW_REF("Unknown peer.");
+    }
+
+    int rc = self->SendMessage(frames, &envelope);
+
+    // We've just called send, and are required to check ZMQ_EVENTS (unless nothing could come of it).
+    self->CheckAfterSend(rc);
+
     ZMQ_CHECK(rc);
 
-    return scope.Close(retval);
+    if (isEAGAIN(rc)) {
+      self->stats.writeEagains++;
+      self->WatchWritable();
+      return scope.Close(Boolean::New(0));
+    }
+
+    return scope.Close(Boolean::New(1));
   }
 
   //
-  // ## Read `Read(size)`
+  // ## Forget `Forget(peer)`
   //
-  // Consumes a maximum of **size** messages of data from the ZMQ socket. If **size** is undefined, the entire
-  // queue will be read and returned.
+  // Forgets **peer**, a handle returned by `ReadRequests`, so its handle can be handed out to the next new peer.
+  // ZMQ doesn't say when peers leave, so the table only shrinks when told to. Returns false if there was no such
+  // peer.
   //
-  // If there is no data to consume then null is returned, and a future 'readable' event will be emitted when more is
-  // available.
+  Handle<Value> Socket::Forget(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->peers == NULL) {
+      THROW_TYPE("Socket does not intern its peers' identities (see internIdentities).");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsUint32()) {
+      THROW_TYPE("No peer specified.");
+    }
+
+    return scope.Close(Boolean::New(self->peers->Forget(args[0]->Uint32Value())));
+  }
+
   //
-  // Calling stream.read(0) is a no-op with no internal side effects, but can be used to test for Socket validity.
+  // Returns a snapshot of **histogram** in microseconds: its `count`, `min`, `mean` and `max`, and the `p50`, `p90`,
+  // `p99`, `p999` and `p9999` percentiles.
   //
-  // Returns an Array of Messages, which are in turn Arrays of Frames as Node Buffers.
+  static Local<Object> latencySnapshot(const LatencyHistogram *histogram) {
+    HandleScope scope;
+    Local<Object> snapshot = Object::New();
+
+    snapshot->Set(String::NewSymbol("count"), Number::New(histogram->Count()));
+    snapshot->Set(String::NewSymbol("min"), Number::New(histogram->Min() / 1000.0));
+    snapshot->Set(String::NewSymbol("mean"), Number::New(histogram->Mean() / 1000.0));
+    snapshot->Set(String::NewSymbol("max"), Number::New(histogram->Max() / 1000.0));
+    snapshot->Set(String::NewSymbol("p50"), Number::New(histogram->Percentile(50) / 1000.0));
+    snapshot->Set(String::NewSymbol("p90"), Number::New(histogram->Percentile(90) / 1000.0));
+    snapshot->Set(String::NewSymbol("p99"), Number::New(histogram->Percentile(99) / 1000.0));
+    snapshot->Set(String::NewSymbol("p999"), Number::New(histogram->Percentile(99.9) / 1000.0));
+    snapshot->Set(String::NewSymbol("p9999"), Number::New(histogram->Percentile(99.99) / 1000.0));
+
+    return scope.Close(snapshot);
+  }
+
   //
-  // NOTE: To reiterate, this Read returns a different amount and different format than the builtin Duplex, which
-  // is a single Buffer or String of <= `size`. Because of this, there is no encoding support.
+  // ## Latency `Latency(reset)`
   //
-  Handle<Value> Socket::Read(const Arguments& args) {
+  // Returns an Object with snapshots (see `latencySnapshot`) of a tracing socket's latencies: `transit`, from when
+  // each message was written to when it was read, and `queued`, from the wakeup that announced messages to the read
+  // that took them. If **reset** is true, both are reset afterwards, so each snapshot covers the interval since the
+  // last. Available even once closed. Returns null unless tracing.
+  //
+  Handle<Value> Socket::Latency(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    if (self->transitLatency == NULL) {
+      return scope.Close(Null());
+    }
+
+    Local<Object> latency = Object::New();
+    latency->Set(String::NewSymbol("transit"), latencySnapshot(self->transitLatency));
+    latency->Set(String::NewSymbol("queued"), latencySnapshot(self->queueLatency));
+
+    if (args.Length() > 0 && args[0]->BooleanValue()) {
+      self->transitLatency->Reset();
+      self->queueLatency->Reset();
+    }
+
+    return scope.Close(latency);
+  }
+
+  //
+  // ## Monitor `Monitor(events)`
+  //
+  // Starts monitoring the socket for the ZMQ_EVENT_* flags in **events** (all of them by default), returning a
+  // PAIR Socket that emits each event, named and timestamped, instead of `'readable'`. Called with false, stops
+  // monitoring, closing the monitor socket. Monitoring again replaces the previous monitor socket.
+  //
+  // Events are read (and timestamped) as soon as they arrive, whether or not anything else is going on.
+  //
+  Handle<Value> Socket::Monitor(const Arguments& args) {
     HandleScope scope;
     Socket *self = THIS_TO_SOCKET(args.This());
     assert(self);
 
-    if (self->socket == NULL) {
-      THROW_REF("Socket is closed, and cannot be read from.");
+    if (self->socket == NULL) {
+      THROW_REF("Socket is closed, and cannot be monitored.");
+    }
+
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be monitored.");
+    }
+
+    bool stop = args.Length() > 0 && (args[0]->IsNull() || (args[0]->IsBoolean() && !args[0]->BooleanValue()));
+    int events = args.Length() > 0 && args[0]->IsNumber() ? args[0]->Int32Value() : ZMQ_EVENT_ALL;
+
+    if (!stop && events <= 0) {
+      THROW_TYPE("No events specified to monitor.");
+    }
+
+    // Only one monitor is allowed per socket, so the previous one (if any) is stopped and closed first.
+    {
+      IOThread::Guard guard(self->ioThread);
+      ZMQ_CHECK(zmq_socket_monitor(self->socket, NULL, 0));
     }
 
-    int size = -1;
+    if (!self->monitorHandle.IsEmpty()) {
+      Handle<Value> close = self->monitorHandle->Get(String::NewSymbol("close"));
 
-    if (args.Length() > 0) {
-      size = args[0]->ToInteger()->Value();
+      if (close->IsFunction()) {
+        close->ToObject()->CallAsFunction(self->monitorHandle, 0, NULL);
+      }
+
+      self->monitorHandle.Dispose();
+      self->monitorHandle.Clear();
     }
 
-    if (size == 0) {
-      return scope.Close(Null());
+    if (stop) {
+      return scope.Close(Undefined());
     }
 
-    int rc = 0;
-    zmq_msg_t part;
-    Handle<Array> messages = Array::New();
-    Handle<Array> message = Array::New();
+    static unsigned int monitors = 0;
+    char endpoint[64];
+    snprintf(endpoint, sizeof endpoint, "inproc://zmqstream-monitor-%p-%u", (void*)self, monitors++);
 
-    do {
-      ZMQ_CHECK(zmq_msg_init(&part));
+    {
+      IOThread::Guard guard(self->ioThread);
+      ZMQ_CHECK(zmq_socket_monitor(self->socket, endpoint, events));
+    }
 
-      rc = zmq_msg_recv(&part, self->socket, ZMQ_DONTWAIT);
-      ZMQ_CHECK(rc);
+    // inproc endpoints only reach sockets from the same Context.
+    Local<Object> options = Object::New();
+    options->Set(String::NewSymbol("type"), Integer::New(ZMQ_PAIR));
 
-      if (!isEAGAIN(rc)) {
-        // We want to continue, so clear `rc`.
-        rc = 0;
+    if (!self->contextHandle.IsEmpty()) {
+      options->Set(String::NewSymbol("context"), self->contextHandle);
+    }
 
-        message->Set(message->Length(), Local<Object>::New(Buffer::New((char*)zmq_msg_data(&part), zmq_msg_size(&part))->handle_));
+    Handle<Value> argv[1] = { options };
+    Local<Object> monitorObj = constructor->NewInstance(1, argv);
 
-        if (!zmq_msg_more(&part)) {
-          size--;
-          messages->Set(messages->Length(), message);
-          message = Array::New();
-        }
-      }
+    // Nothing would ever read the events otherwise, so monitoring is stopped again on failure.
+    if (monitorObj.IsEmpty()) {
+      IOThread::Guard guard(self->ioThread);
+      zmq_socket_monitor(self->socket, NULL, 0);
+      return scope.Close(Undefined());
+    }
 
-      ZMQ_CHECK(zmq_msg_close(&part));
-    } while (rc == 0 && size != 0);
+    Socket *monitor = THIS_TO_SOCKET(monitorObj);
+    assert(monitor);
 
-    // We've just called recv, and are required to check ZMQ_EVENTS.
-    uv_idle_start(&self->idleHandle, Socket::Check);
+    monitor->monitoring = new Monitoring();
 
-    if (messages->Length() == 0) {
-      self->shouldReadable = true;
-      uv_poll_start(&self->readableHandle, UV_READABLE, Check);
-      return scope.Close(Null());
+    if (!isSuccessRC(zmq_connect(monitor->socket, endpoint))) {
+      Handle<Value> error = Exception::Error(String::New(zmq_strerror(zmq_errno())));
+      Handle<Value> close = monitorObj->Get(String::NewSymbol("close"));
+
+      {
+        IOThread::Guard guard(self->ioThread);
+        zmq_socket_monitor(self->socket, NULL, 0);
+      }
+
+      if (close->IsFunction()) {
+        close->ToObject()->CallAsFunction(monitorObj, 0, NULL);
+      }
+
+      return ThrowException(error);
     }
 
-    return scope.Close(messages);
+    uv_poll_start(monitor->pollHandle, UV_READABLE, Check);
+    Poller::MarkDirty(monitor);
+
+    self->monitorHandle = Persistent<Object>::New(monitorObj);
+
+    return scope.Close(monitorObj);
   }
 
   //
-  // ## Write `Write(message)`
+  // ## PoolStats `PoolStats()`
   //
-  // Writes **message** to the ZMQ socket to be transmitted over the wire at some time in the future.
+  // Returns the occupancy of the socket's frame pool (see `pooledReads`), or null if it doesn't have one.
   //
-  // Calling stream.write([]) is a no-op with no internal side effects, but can be used for test for Socket
-  // validity.
+  Handle<Value> Socket::PoolStats(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
+
+    FramePool *pool = self->framePool;
+
+    if (pool == NULL) {
+      return scope.Close(Null());
+    }
+
+    Local<Object> stats = Object::New();
+    stats->Set(String::NewSymbol("slabSize"), Number::New(pool->SlabSize()));
+    stats->Set(String::NewSymbol("maxFrameSize"), Number::New(pool->MaxFrameSize()));
+    stats->Set(String::NewSymbol("slabs"), Number::New(pool->slabs));
+    stats->Set(String::NewSymbol("freeSlabs"), Number::New(pool->freeSlabs));
+    stats->Set(String::NewSymbol("liveFrames"), Number::New(pool->liveFrames));
+    stats->Set(String::NewSymbol("liveBytes"), Number::New(pool->liveBytes));
+
+    return scope.Close(stats);
+  }
+
   //
-  // Returns true if **message** was queued successfully, or false if the buffer is full (see ZMQ_DONTWAIT/EAGAIN).
+  // ## Stats `Stats()`
   //
-  // NOTE: Unlike the builtin Duplex class, a return value of `false` indicates the write was _unsuccessful_, and
-  // will need to be tried again.
+  // Returns a snapshot of the socket's hot-path counters (see `SocketStats`). Available even once closed.
   //
-  Handle<Value> Socket::Write(const Arguments& args) {
+  Handle<Value> Socket::Stats(const Arguments& args) {
     HandleScope scope;
     Socket *self = THIS_TO_SOCKET(args.This());
     assert(self);
 
-    if (self->socket == NULL) {
-      THROW_REF("Socket is closed, and cannot be written to.");
-    }
+    SocketStats *counters = &self->stats;
+    Local<Array> readBatches = Array::New(SocketStats::BATCH_BUCKETS);
 
-    if (args.Length() < 1 || !args[0]->IsArray()) {
-      THROW_TYPE("No message specified.");
+    for (int i = 0; i < SocketStats::BATCH_BUCKETS; i++) {
+      readBatches->Set(i, Number::New(counters->readBatches[i]));
     }
 
-    Local<Object> frames = args[0]->ToObject();
-    int length = frames->Get(String::New("length"))->ToInteger()->Value();
-    Handle<Object> buffer;
-    size_t size;
-    int rc;
-
-    for (int i = 0; i < length; i++) {
-      if (!Buffer::HasInstance(frames->Get(i))) {
-        THROW_TYPE("Cannot write non-Buffer message part.");
-      }
+    Local<Object> stats = Object::New();
+    stats->Set(String::NewSymbol("messagesIn"), Number::New(counters->messagesIn));
+    stats->Set(String::NewSymbol("bytesIn"), Number::New(counters->bytesIn));
+    stats->Set(String::NewSymbol("messagesOut"), Number::New(counters->messagesOut));
+    stats->Set(String::NewSymbol("bytesOut"), Number::New(counters->bytesOut));
+    stats->Set(String::NewSymbol("writeEagains"), Number::New(counters->writeEagains));
+    stats->Set(String::NewSymbol("emptyReads"), Number::New(counters->emptyReads));
+    stats->Set(String::NewSymbol("readableEmits"), Number::New(counters->readableEmits));
+    stats->Set(String::NewSymbol("drainEmits"), Number::New(counters->drainEmits));
+    stats->Set(String::NewSymbol("idleChecks"), Number::New(counters->idleChecks));
+    stats->Set(String::NewSymbol("pollChecks"), Number::New(counters->pollChecks));
+    stats->Set(String::NewSymbol("asyncChecks"), Number::New(counters->asyncChecks));
+    stats->Set(String::NewSymbol("emptyChecks"), Number::New(counters->emptyChecks));
+    stats->Set(String::NewSymbol("forwarded"), Number::New(counters->forwarded));
+    stats->Set(String::NewSymbol("filtered"), Number::New(counters->filtered));
+    stats->Set(String::NewSymbol("compressFrames"), Number::New(counters->compressFrames));
+    stats->Set(String::NewSymbol("compressedFrames"), Number::New(counters->compressedFrames));
+    stats->Set(String::NewSymbol("compressOffloaded"), Number::New(counters->compressOffloaded));
+    stats->Set(String::NewSymbol("compressBytesIn"), Number::New(counters->compressBytesIn));
+    stats->Set(String::NewSymbol("compressBytesOut"), Number::New(counters->compressBytesOut));
+    stats->Set(String::NewSymbol("compressRatio"), Number::New(counters->compressBytesOut > 0 ?
+      (double)counters->compressBytesIn / counters->compressBytesOut : 0));
+    stats->Set(String::NewSymbol("compressMicros"), Number::New(counters->compressNanos / 1000.0));
+    stats->Set(String::NewSymbol("decompressedFrames"), Number::New(counters->decompressedFrames));
+    stats->Set(String::NewSymbol("decompressErrors"), Number::New(counters->decompressErrors));
+    stats->Set(String::NewSymbol("decompressBytesIn"), Number::New(counters->decompressBytesIn));
+    stats->Set(String::NewSymbol("decompressBytesOut"), Number::New(counters->decompressBytesOut));
+    stats->Set(String::NewSymbol("decompressMicros"), Number::New(counters->decompressNanos / 1000.0));
+    stats->Set(String::NewSymbol("busyPolls"), Number::New(counters->busyPolls));
+    stats->Set(String::NewSymbol("busyPollHits"), Number::New(counters->busyPollHits));
+    stats->Set(String::NewSymbol("busyPollMicros"), Number::New(counters->busyPollNanos / 1000.0));
+    stats->Set(String::NewSymbol("queuedMessages"), Number::New(counters->queuedMessages));
+    stats->Set(String::NewSymbol("readBatches"), readBatches);
+
+    if (self->peers) {
+      stats->Set(String::NewSymbol("peers"), Number::New(self->peers->Size()));
     }
 
-    // We're about to call send, and are required to check ZMQ_EVENTS.
-    uv_idle_start(&self->idleHandle, Socket::Check);
-
-    for (int i = 0; i < length; i++) {
-      zmq_msg_t part;
+    if (self->queueMessages > 0) {
+      stats->Set(String::NewSymbol("outboundMessages"), Number::New(self->outbound.size()));
+      stats->Set(String::NewSymbol("outboundBytes"), Number::New(self->outboundBytes));
+    }
 
-      buffer = frames->Get(i)->ToObject();
-      size = Buffer::Length(buffer);
+    return scope.Close(stats);
+  }
 
-      ZMQ_CHECK(zmq_msg_init_size(&part, size));
-      memcpy(zmq_msg_data(&part), Buffer::Data(buffer), size);
+  //
+  // ## ResetStats `ResetStats()`
+  //
+  // Zeroes the socket's hot-path counters.
+  //
+  Handle<Value> Socket::ResetStats(const Arguments& args) {
+    HandleScope scope;
+    Socket *self = THIS_TO_SOCKET(args.This());
+    assert(self);
 
-      rc = zmq_msg_send(&part, self->socket, i < length - 1 ? ZMQ_SNDMORE | ZMQ_DONTWAIT : ZMQ_DONTWAIT);
-      ZMQ_CHECK(rc);
+    self->stats.Reset();
 
-      if (isEAGAIN(rc)) {
-        uv_poll_start(&self->writableHandle, UV_WRITABLE, Check);
-        self->shouldDrain = true;
-        return scope.Close(Boolean::New(0));
-      }
+    if (self->transitLatency) {
+      self->transitLatency->Reset();
+      self->queueLatency->Reset();
     }
 
-    return scope.Close(Boolean::New(1));
+    return scope.Close(Undefined());
   }
 
   //
@@ -540,11 +4114,16 @@ namespace zmqstream {
       THROW_REF("Socket is closed, and cannot be connected.");
     }
 
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be connected.");
+    }
+
     if (args.Length() != 1 || !args[0]->IsString()) {
       THROW_TYPE("No endpoint specified to connect to.");
     }
 
     String::AsciiValue endpoint(args[0]->ToString());
+    IOThread::Guard guard(self->ioThread);
 
     ZMQ_CHECK(zmq_connect(self->socket, *endpoint));
 
@@ -567,11 +4146,16 @@ namespace zmqstream {
       THROW_REF("Socket is closed, and cannot be disconnected.");
     }
 
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be disconnected.");
+    }
+
     if (args.Length() != 1 || !args[0]->IsString()) {
       THROW_TYPE("No endpoint specified to disconnect from.");
     }
 
     String::AsciiValue endpoint(args[0]->ToString());
+    IOThread::Guard guard(self->ioThread);
 
     ZMQ_CHECK(zmq_disconnect(self->socket, *endpoint));
 
@@ -594,11 +4178,16 @@ namespace zmqstream {
       THROW_REF("Socket is closed, and cannot be bound.");
     }
 
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be bound.");
+    }
+
     if (args.Length() != 1 || !args[0]->IsString()) {
       THROW_TYPE("No endpoint specified to bind to.");
     }
 
     String::AsciiValue endpoint(args[0]->ToString());
+    IOThread::Guard guard(self->ioThread);
 
     ZMQ_CHECK(zmq_bind(self->socket, *endpoint));
 
@@ -621,21 +4210,256 @@ namespace zmqstream {
       THROW_REF("Socket is closed, and cannot be unbound.");
     }
 
+    if (self->proxy) {
+      THROW_REF("Socket is in use by a proxy, and cannot be unbound.");
+    }
+
     if (args.Length() != 1 || !args[0]->IsString()) {
       THROW_TYPE("No endpoint specified to unbind from.");
     }
 
     String::AsciiValue endpoint(args[0]->ToString());
+    IOThread::Guard guard(self->ioThread);
 
     ZMQ_CHECK(zmq_unbind(self->socket, *endpoint));
 
     return scope.Close(Undefined());
   }
 
+  //
+  // ## ConsumeSubscriptions `ConsumeSubscriptions(jsObj, emit)`
+  //
+  // Reads a batch of subscription messages into `subscriptions`, emitting `'subscribe'` and `'unsubscribe'` on
+  // **jsObj** whenever a topic gains its first subscriber or loses its last one. Other messages are dropped.
+  //
+  void Socket::ConsumeSubscriptions(Handle<Object> jsObj, Handle<Function> emit) {
+    HandleScope scope;
+    zmq_msg_t part;
+
+    // An event handler may close the socket, which ends the batch.
+    for (int i = 0; i < FORWARD_BATCH_SIZE && socket; i++) {
+      assert(zmq_msg_init(&part) == 0);
+
+      if (RecvFrame(&part) == -1) {
+        zmq_msg_close(&part);
+        break;
+      }
+
+      bool more = zmq_msg_more(&part);
+      const char *data = (const char*)zmq_msg_data(&part);
+      size_t size = zmq_msg_size(&part);
+      const char *event = NULL;
+
+      stats.messagesIn++;
+      stats.bytesIn += size;
+
+      // A subscription is a single frame: 1 to subscribe, or 0 to unsubscribe, followed by the topic.
+      if (!more && size > 0 && data[0] == 1 && subscriptions->Add(data + 1, size - 1)) {
+        event = "subscribe";
+      } else if (!more && size > 0 && data[0] == 0 && subscriptions->Remove(data + 1, size - 1)) {
+        event = "unsubscribe";
+      }
+
+      if (event) {
+        Handle<Value> args[2] = { String::New(event), CopyFrame(data + 1, size - 1) };
+        emit->CallAsFunction(jsObj, 2, args);
+      }
+
+      // Anything else (like a message from an XSUB upstream) is dropped, frames and all.
+      while (more && socket && RecvFrame(&part) != -1) {
+        more = zmq_msg_more(&part);
+      }
+
+      zmq_msg_close(&part);
+    }
+
+    // We've just called recv, and are required to check ZMQ_EVENTS.
+    if (socket) {
+      ScheduleCheck();
+    }
+  }
+
+  //
+  // Returns the name a monitor event is emitted under, or NULL for events we don't know.
+  //
+  static const char *monitorEventName(int event) {
+    switch (event) {
+      case ZMQ_EVENT_CONNECTED: return "connected";
+      case ZMQ_EVENT_CONNECT_DELAYED: return "connect_delayed";
+      case ZMQ_EVENT_CONNECT_RETRIED: return "connect_retried";
+      case ZMQ_EVENT_LISTENING: return "listening";
+      case ZMQ_EVENT_BIND_FAILED: return "bind_failed";
+      case ZMQ_EVENT_ACCEPTED: return "accepted";
+      case ZMQ_EVENT_ACCEPT_FAILED: return "accept_failed";
+      case ZMQ_EVENT_CLOSED: return "closed";
+      case ZMQ_EVENT_CLOSE_FAILED: return "close_failed";
+      case ZMQ_EVENT_DISCONNECTED: return "disconnected";
+#ifdef ZMQ_EVENT_MONITOR_STOPPED
+      case ZMQ_EVENT_MONITOR_STOPPED: return "monitor_stopped";
+#endif
+#ifdef ZMQ_EVENT_HANDSHAKE_SUCCEEDED
+      case ZMQ_EVENT_HANDSHAKE_SUCCEEDED: return "handshake";
+#endif
+#ifdef ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL
+      case ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL: return "handshake_failed";
+#endif
+#ifdef ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL
+      case ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL: return "handshake_failed";
+#endif
+#ifdef ZMQ_EVENT_HANDSHAKE_FAILED_AUTH
+      case ZMQ_EVENT_HANDSHAKE_FAILED_AUTH: return "handshake_failed";
+#endif
+      default: return NULL;
+    }
+  }
+
+  //
+  // ## ConsumeEvents `ConsumeEvents(jsObj, emit)`
+  //
+  // Reads a batch of monitor events, emitting each on **jsObj** both as `'event'` and under its own name, as an
+  // Object with the `event` name, the `endpoint`, the event's `value` (a file descriptor, error or interval,
+  // depending on the event) and the monotonic `time` it was read at, in microseconds.
+  //
+  // Events ending a wait also carry the microseconds it took as `elapsed`: `'connected'` since the connection was
+  // first delayed, retried or lost, and `'handshake'` (or `'handshake_failed'`) since it was connected or accepted.
+  //
+  void Socket::ConsumeEvents(Handle<Object> jsObj, Handle<Function> emit) {
+    HandleScope scope;
+    zmq_msg_t part;
+
+    // An event handler may close the socket, which ends the batch.
+    for (int i = 0; i < FORWARD_BATCH_SIZE && socket; i++) {
+      assert(zmq_msg_init(&part) == 0);
+
+      if (RecvFrame(&part) == -1) {
+        zmq_msg_close(&part);
+        break;
+      }
+
+      // Timestamps are taken as the event is read, which is as close to when it happened as we can get.
+      uint64_t now = uv_hrtime();
+      bool more = zmq_msg_more(&part);
+      size_t size = zmq_msg_size(&part);
+      int event = 0;
+      int32_t value = 0;
+      std::string endpoint;
+      bool valid = false;
+
+      stats.messagesIn++;
+      stats.bytesIn += size;
+
+#if ZMQ_VERSION_MAJOR >= 4
+      // An event is two frames: a 16-bit event and a 32-bit value, followed by the endpoint.
+      if (more && size == 6) {
+        uint16_t id;
+        memcpy(&id, zmq_msg_data(&part), sizeof id);
+        memcpy(&value, (char*)zmq_msg_data(&part) + sizeof id, sizeof value);
+        event = id;
+
+        if (RecvFrame(&part) != -1) {
+          more = zmq_msg_more(&part);
+          endpoint.assign((const char*)zmq_msg_data(&part), zmq_msg_size(&part));
+          stats.bytesIn += zmq_msg_size(&part);
+          valid = true;
+        } else {
+          more = false;
+        }
+      }
+#else
+      // An event is a single zmq_event_t, and every kind starts with the endpoint and an int.
+      if (size == sizeof(zmq_event_t)) {
+        zmq_event_t data;
+        memcpy(&data, zmq_msg_data(&part), sizeof data);
+
+        event = data.event;
+        value = data.data.connected.fd;
+
+        if (data.data.connected.addr) {
+          endpoint.assign(data.data.connected.addr);
+        }
+
+        valid = true;
+      }
+#endif
+
+      // Anything else is dropped, frames and all.
+      while (more && socket && RecvFrame(&part) != -1) {
+        more = zmq_msg_more(&part);
+      }
+
+      zmq_msg_close(&part);
+
+      const char *name = valid ? monitorEventName(event) : NULL;
+
+      if (name == NULL) {
+        continue;
+      }
+
+      Local<Object> info = Object::New();
+      info->Set(String::NewSymbol("event"), String::New(name));
+      info->Set(String::NewSymbol("endpoint"), String::New(endpoint.data(), endpoint.size()));
+      info->Set(String::NewSymbol("value"), Integer::New(value));
+      info->Set(String::NewSymbol("time"), Number::New((double)(now / 1000)));
+
+      std::map<std::string, uint64_t>::iterator since = monitoring->since.find(endpoint);
+      bool waiting = since != monitoring->since.end();
+
+      switch (event) {
+        case ZMQ_EVENT_CONNECT_DELAYED:
+        case ZMQ_EVENT_CONNECT_RETRIED:
+        case ZMQ_EVENT_DISCONNECTED:
+          // Only the first of a run of retries starts the clock.
+          if (!waiting) {
+            monitoring->since[endpoint] = now;
+          }
+          break;
+        case ZMQ_EVENT_CONNECTED:
+          if (waiting) {
+            info->Set(String::NewSymbol("elapsed"), Number::New((double)((now - since->second) / 1000)));
+          }
+
+          // The handshake starts as soon as the connection is made.
+          monitoring->since[endpoint] = now;
+          break;
+        case ZMQ_EVENT_ACCEPTED:
+          monitoring->since[endpoint] = now;
+          break;
+        case ZMQ_EVENT_CLOSED:
+#ifdef ZMQ_EVENT_MONITOR_STOPPED
+        case ZMQ_EVENT_MONITOR_STOPPED:
+#endif
+          if (waiting) {
+            monitoring->since.erase(since);
+          }
+          break;
+        default:
+          // Every handshake event ends the handshake, successfully or not.
+          if (waiting && strncmp(name, "handshake", 9) == 0) {
+            info->Set(String::NewSymbol("elapsed"), Number::New((double)((now - since->second) / 1000)));
+            monitoring->since.erase(since);
+          }
+          break;
+      }
+
+      Handle<Value> args[2] = { String::New("event"), info };
+      emit->CallAsFunction(jsObj, 2, args);
+
+      if (socket) {
+        args[0] = String::New(name);
+        emit->CallAsFunction(jsObj, 2, args);
+      }
+    }
+
+    // We've just called recv, and are required to check ZMQ_EVENTS.
+    if (socket) {
+      ScheduleCheck();
+    }
+  }
+
   //
   // ## Check
   //
-  // A `uv_poll_cb` registered to facilitate generating `'readable'` and `'drain'` events.
+  // A `uv_poll_cb` registered to facilitate generating `'readable'` and `'drain'` events, by way of the Poller.
   //
   void Socket::Check(uv_poll_t* handle, int status, int events) {
     assert(handle);
@@ -644,22 +4468,35 @@ namespace zmqstream {
     Socket* self = (Socket*)handle->data;
     assert(self);
 
-    Socket::Check(self);
+    if (self->queueLatency && self->wakeNanos == 0) {
+      self->wakeNanos = uv_hrtime();
+    }
+
+    self->polled = true;
+    Poller::MarkDirty(self);
   }
 
   //
   // ## Check
   //
-  // A `uv_idle_cb` registered to facilitate generating `'readable'` and `'drain'` events.
+  // A `uv_async_cb` registered to facilitate generating `'readable'` and `'drain'` events for sockets owned by an
+  // IOThread.
   //
-  void Socket::Check(uv_idle_t* handle, int status) {
+  void Socket::Check(uv_async_t* handle, int status) {
     assert(handle);
 
-    uv_idle_stop(handle);
-
     Socket* self = (Socket*)handle->data;
     assert(self);
 
+    // The notification may have been sent just before the socket was closed.
+    if (self->socket == NULL) {
+      return;
+    }
+
+    if (self->queueLatency && self->wakeNanos == 0) {
+      self->wakeNanos = uv_hrtime();
+    }
+
     Socket::Check(self);
   }
 
@@ -673,38 +4510,152 @@ namespace zmqstream {
 
     assert(self->socket);
 
+    // A proxied socket belongs to another thread, and is checked again once it's taken back.
+    if (self->proxy) {
+      return;
+    }
+
     Handle<Value> jsObj = SOCKET_TO_THIS(self);
     assert(!jsObj.IsEmpty());
     if (!jsObj->IsObject()) {
       return;
     }
 
-    Handle<Value> emit = jsObj->ToObject()->Get(String::NewSymbol("emit"));
+    // `emit` is looked up once, rather than on every check. It only ever comes from the prototype in practice.
+    if (self->emitFunction.IsEmpty()) {
+      Handle<Value> found = jsObj->ToObject()->Get(emitSymbol);
 
-    if (!emit->IsFunction()) {
-      return;
+      if (!found->IsFunction()) {
+        return;
+      }
+
+      self->emitFunction = Persistent<Function>::New(Handle<Function>::Cast(found));
     }
 
-    int zmqEvents = 0;
-    size_t size = sizeof zmqEvents;
+    Handle<Function> emit = self->emitFunction;
 
-    if (zmq_getsockopt(self->socket, ZMQ_EVENTS, &zmqEvents, &size) < 0) {
+    int zmqEvents = self->Events();
+
+    if (zmqEvents < 0) {
       printf("Problem checking actual socket state.\n");
       return;
     }
 
-    if (self->shouldReadable && (zmqEvents & ZMQ_POLLIN)) {
+    // A stashed message is waiting to be read just the same as one ZeroMQ is still holding.
+    if (!self->stash.empty()) {
+      zmqEvents |= ZMQ_POLLIN;
+    }
+
+    // A forwarding socket's messages never reach JS, so it's forwarded rather than made `'readable'`. Forwarding
+    // schedules another check of its own.
+    if (self->forwarding && !self->forwarding->blocked && (zmqEvents & ZMQ_POLLIN)) {
+      self->Forward();
+    }
+
+    // A batch that was full before there was room for it is sent first, which is what lets writes through again.
+    if (self->coalesceStalled && (zmqEvents & ZMQ_POLLOUT) && self->FlushBatch() == 0) {
+      zmqEvents = self->Events();
+    }
+
+    // Compressed messages that were waiting for room are sent next, in the order they were written.
+    if (!self->compressJobs.empty() && self->compressJobs.front()->done && (zmqEvents & ZMQ_POLLOUT)) {
+      self->SendCompressed();
+      zmqEvents = self->Events();
+    }
+
+    // Messages queued while there was no room for them are sent next, in the order they were written.
+    if (!self->outbound.empty() && (zmqEvents & ZMQ_POLLOUT)) {
+      self->SendQueued();
+      zmqEvents = self->Events();
+    }
+
+    // A socket tracking its subscriptions reads them itself, so they're consumed rather than made `'readable'`.
+    if (self->subscriptions && (zmqEvents & ZMQ_POLLIN)) {
+      self->ConsumeSubscriptions(jsObj->ToObject(), emit);
+
+      if (self->socket == NULL) {
+        return;
+      }
+    }
+
+    // A monitor socket decodes its events itself, in the same way.
+    if (self->monitoring && (zmqEvents & ZMQ_POLLIN)) {
+      self->ConsumeEvents(jsObj->ToObject(), emit);
+
+      if (self->socket == NULL) {
+        return;
+      }
+    }
+
+    // Sockets forwarding here stopped reading while this one was full, and can pick up where they left off.
+    if (!self->forwardWaiters.empty() && (zmqEvents & ZMQ_POLLOUT)) {
+      std::vector<Socket*> waiters;
+      waiters.swap(self->forwardWaiters);
+
+      for (size_t i = 0; i < waiters.size(); i++) {
+        waiters[i]->forwarding->blocked = false;
+        Poller::MarkDirty(waiters[i]);
+      }
+    }
+
+    bool forwarding = self->forwarding && !self->forwarding->blocked;
+    bool consuming = self->subscriptions || self->monitoring;
+    bool readable = !self->forwarding && !consuming && self->shouldReadable && (zmqEvents & ZMQ_POLLIN);
+    bool drain = self->shouldDrain && !self->coalesceStalled && self->compressJobs.size() < MAX_COMPRESS_JOBS &&
+                 self->outbound.empty() && (zmqEvents & ZMQ_POLLOUT);
+    bool compressWaiting = !self->compressJobs.empty() && self->compressJobs.front()->done;
+
+    if (self->ioThread) {
+      self->stats.asyncChecks++;
+    } else if (self->polled) {
+      self->stats.pollChecks++;
+    } else {
+      self->stats.idleChecks++;
+    }
+
+    self->polled = false;
+
+    if (!readable && !drain && !forwarding) {
+      self->stats.emptyChecks++;
+    }
+
+    if (readable) {
       self->shouldReadable = false;
-      uv_poll_stop(&self->readableHandle);
-      Handle<Value> args[1] = { String::New("readable") };
-      emit->ToObject()->CallAsFunction(jsObj->ToObject(), 1, args);
+
+      // Checks not prompted by the fd (or the IOThread) are announced as soon as they're made.
+      if (self->queueLatency) {
+        self->readableNanos = self->wakeNanos ? self->wakeNanos : uv_hrtime();
+      }
     }
 
-    if (self->shouldDrain && (zmqEvents & ZMQ_POLLOUT)) {
+    self->wakeNanos = 0;
+
+    if (drain) {
       self->shouldDrain = false;
-      uv_poll_stop(&self->writableHandle);
-      Handle<Value> args[1] = { String::New("drain") };
-      emit->ToObject()->CallAsFunction(jsObj->ToObject(), 1, args);
+    }
+
+    // The fd only needs watching while an event is still expected. Handlers that expect another will restart it.
+    // A blocked forwarding socket isn't watched at all, which is what pushes back on its peers.
+    bool watchReadable = forwarding || consuming || (self->canRead && self->shouldReadable && !self->forwarding);
+
+    if (!watchReadable && !self->shouldDrain && !self->coalesceStalled && !compressWaiting &&
+        self->outbound.empty() && self->forwardWaiters.empty()) {
+      uv_poll_stop(self->pollHandle);
+    } else if ((forwarding || consuming || !self->forwardWaiters.empty()) && !self->ioThread) {
+      uv_poll_start(self->pollHandle, UV_READABLE, Check);
+    }
+
+    if (readable) {
+      self->stats.readableEmits++;
+      Handle<Value> args[1] = { readableSymbol };
+      emit->Call(jsObj->ToObject(), 1, args);
+    }
+
+    // The `'readable'` handler may well have closed the socket.
+    if (drain && self->socket) {
+      self->stats.drainEmits++;
+      Handle<Value> args[1] = { drainSymbol };
+      emit->Call(jsObj->ToObject(), 1, args);
     }
   }
 
@@ -716,14 +4667,31 @@ namespace zmqstream {
   void Socket::Initialize() {
     Local<FunctionTemplate> constructorTemplate(FunctionTemplate::New(New));
 
+    emitSymbol = Persistent<String>::New(String::NewSymbol("emit"));
+    readableSymbol = Persistent<String>::New(String::NewSymbol("readable"));
+    drainSymbol = Persistent<String>::New(String::NewSymbol("drain"));
+
     // ObjectWrap uses the first internal field to store the wrapped pointer.
     constructorTemplate->InstanceTemplate()->SetInternalFieldCount(1);
     constructorTemplate->SetClassName(String::NewSymbol("Socket"));
 
     // Add all prototype methods, getters and setters here.
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "read", Read);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "readFlat", ReadFlat);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "readInto", ReadInto);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "write", Write);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "writeMany", WriteMany);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "close", Close);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "forwardTo", ForwardTo);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "hasSubscribers", HasSubscribers);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "monitor", Monitor);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "readRequests", ReadRequests);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "reply", Reply);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "forget", Forget);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "latency", Latency);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "poolStats", PoolStats);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "stats", Stats);
+    NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "resetStats", ResetStats);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "set", SetOption);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "get", GetOption);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "connect", Connect);
@@ -731,18 +4699,99 @@ namespace zmqstream {
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "bind", Bind);
     NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "unbind", Unbind);
 
+    Socket::constructorTemplate = Persistent<FunctionTemplate>::New(constructorTemplate);
     constructor = Persistent<Function>::New(constructorTemplate->GetFunction());
   }
 
+  //
+  // ## HasInstance `HasInstance(value)`
+  //
+  // Returns true if **value** is a Socket.
+  //
+  bool Socket::HasInstance(Handle<Value> value) {
+    return value->IsObject() && constructorTemplate->HasInstance(value);
+  }
+
+  //
+  // ## ContextReferences `zmqstream._contextReferences()`
+  //
+  // Returns the number of references to the shared default context: one for the module itself, and one for each
+  // open Socket created within it. Internal, for the tests to check that sockets let go of it.
+  //
+  static Handle<Value> ContextReferences(const Arguments& args) {
+    HandleScope scope;
+
+    return scope.Close(Integer::New(ScopedContext::References()));
+  }
+
+  //
+  // ## TrainDictionary `zmqstream.trainDictionary(samples, size)`
+  //
+  // Trains a zstd dictionary of up to **size** bytes (64KB by default) from **samples**, an Array of Buffers that
+  // look like the frames to be compressed, and returns it as a Buffer for `compressDictionary`.
+  //
+  static Handle<Value> TrainDictionary(const Arguments& args) {
+    HandleScope scope;
+
+    if (!Compressor::Available(Compressor::ZSTD)) {
+      THROW("zstd compression was not built in (see zmqstream.Compression).");
+    }
+
+    if (args.Length() < 1 || !args[0]->IsArray()) {
+      THROW_TYPE("Samples must be an Array of Buffers.");
+    }
+
+    Local<Array> samples = Local<Array>::Cast(args[0]);
+    int32_t capacity = 64 * 1024;
+    std::string data;
+    std::vector<size_t> sizes;
+
+    if (args.Length() > 1 && !args[1]->IsUndefined()) {
+      capacity = args[1]->ToInteger()->Int32Value();
+    }
+
+    if (capacity <= 0) {
+      THROW_TYPE("Dictionary size must be positive.");
+    }
+
+    for (uint32_t i = 0; i < samples->Length(); i++) {
+      Local<Value> sample = samples->Get(i);
+
+      if (!Buffer::HasInstance(sample)) {
+        THROW_TYPE("Samples must be an Array of Buffers.");
+      }
+
+      data.append(Buffer::Data(sample->ToObject()), Buffer::Length(sample->ToObject()));
+      sizes.push_back(Buffer::Length(sample->ToObject()));
+    }
+
+    char *dictionary;
+    size_t size = sizes.empty() ? 0 : Compressor::TrainDictionary(data.data(), &sizes[0], sizes.size(), capacity,
+                                                                  &dictionary);
+
+    if (size == 0) {
+      THROW("Could not train a dictionary from those samples.");
+    }
+
+    Buffer *buffer = Buffer::New(dictionary, size);
+    free(dictionary);
+
+    return scope.Close(Local<Object>::New(buffer->handle_));
+  }
+
   //
   // ## InstallExports
   //
-  // Exports the Socket class within the module `target`.
+  // Exports the Socket, Context and Proxy classes within the module `target`.
   //
   void Socket::InstallExports(Handle<Object> target) {
     HandleScope scope;
 
     Initialize();
+    Context::Initialize();
+    Proxy::Initialize();
+    PinnedBuffer::Initialize();
+    Poller::Initialize();
 
     Local<Object> Type = Object::New();
     ZMQ_DEFINE_CONSTANT(Type, "REQ", ZMQ_REQ);
@@ -759,19 +4808,56 @@ namespace zmqstream {
     target->Set(String::NewSymbol("Type"), Type, static_cast<v8::PropertyAttribute>(v8::ReadOnly | v8::DontDelete));
 
     // TODO: While SetOption and GetOption technically support any ZMQ_* option, we only want to export those constants
-    // that make sense. For example, there's currently no way to set `io_threads`, so setting AFFINITY doesn't matter.
-    // However, setting IDENTITY, SUBSCRIBE, and UNSUBSCRIBE are _required_ in a lot of applications.
+    // that make sense. Setting IDENTITY, SUBSCRIBE, and UNSUBSCRIBE are _required_ in a lot of applications, and
+    // AFFINITY matters as soon as a Context has more than one I/O thread.
     Local<Object> Option = Object::New();
     ZMQ_DEFINE_CONSTANT(Option, "TYPE", ZMQ_TYPE);
     ZMQ_DEFINE_CONSTANT(Option, "IDENTITY", ZMQ_IDENTITY);
     ZMQ_DEFINE_CONSTANT(Option, "SUBSCRIBE", ZMQ_SUBSCRIBE);
     ZMQ_DEFINE_CONSTANT(Option, "UNSUBSCRIBE", ZMQ_UNSUBSCRIBE);
     ZMQ_DEFINE_CONSTANT(Option, "LINGER", ZMQ_LINGER);
+    ZMQ_DEFINE_CONSTANT(Option, "AFFINITY", ZMQ_AFFINITY);
     target->Set(String::NewSymbol("Option"), Option, static_cast<v8::PropertyAttribute>(v8::ReadOnly | v8::DontDelete));
 
+    // The compression codecs this build supports, for the `compress` option.
+    Local<Object> Compression = Object::New();
+    Compression->Set(String::NewSymbol("lz4"), Boolean::New(Compressor::Available(Compressor::LZ4)));
+    Compression->Set(String::NewSymbol("zstd"), Boolean::New(Compressor::Available(Compressor::ZSTD)));
+    target->Set(String::NewSymbol("Compression"), Compression,
+                static_cast<v8::PropertyAttribute>(v8::ReadOnly | v8::DontDelete));
+    NODE_SET_METHOD(target, "trainDictionary", TrainDictionary);
+    NODE_SET_METHOD(target, "_contextReferences", ContextReferences);
+
+    // The events `monitor` can watch for, combined with `|`.
+    Local<Object> Event = Object::New();
+    ZMQ_DEFINE_CONSTANT(Event, "CONNECTED", ZMQ_EVENT_CONNECTED);
+    ZMQ_DEFINE_CONSTANT(Event, "CONNECT_DELAYED", ZMQ_EVENT_CONNECT_DELAYED);
+    ZMQ_DEFINE_CONSTANT(Event, "CONNECT_RETRIED", ZMQ_EVENT_CONNECT_RETRIED);
+    ZMQ_DEFINE_CONSTANT(Event, "LISTENING", ZMQ_EVENT_LISTENING);
+    ZMQ_DEFINE_CONSTANT(Event, "BIND_FAILED", ZMQ_EVENT_BIND_FAILED);
+    ZMQ_DEFINE_CONSTANT(Event, "ACCEPTED", ZMQ_EVENT_ACCEPTED);
+    ZMQ_DEFINE_CONSTANT(Event, "ACCEPT_FAILED", ZMQ_EVENT_ACCEPT_FAILED);
+    ZMQ_DEFINE_CONSTANT(Event, "CLOSED", ZMQ_EVENT_CLOSED);
+    ZMQ_DEFINE_CONSTANT(Event, "CLOSE_FAILED", ZMQ_EVENT_CLOSE_FAILED);
+    ZMQ_DEFINE_CONSTANT(Event, "DISCONNECTED", ZMQ_EVENT_DISCONNECTED);
+#ifdef ZMQ_EVENT_MONITOR_STOPPED
+    ZMQ_DEFINE_CONSTANT(Event, "MONITOR_STOPPED", ZMQ_EVENT_MONITOR_STOPPED);
+#endif
+#ifdef ZMQ_EVENT_HANDSHAKE_SUCCEEDED
+    ZMQ_DEFINE_CONSTANT(Event, "HANDSHAKE_SUCCEEDED", ZMQ_EVENT_HANDSHAKE_SUCCEEDED);
+    ZMQ_DEFINE_CONSTANT(Event, "HANDSHAKE_FAILED_NO_DETAIL", ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL);
+    ZMQ_DEFINE_CONSTANT(Event, "HANDSHAKE_FAILED_PROTOCOL", ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL);
+    ZMQ_DEFINE_CONSTANT(Event, "HANDSHAKE_FAILED_AUTH", ZMQ_EVENT_HANDSHAKE_FAILED_AUTH);
+#endif
+    ZMQ_DEFINE_CONSTANT(Event, "ALL", ZMQ_EVENT_ALL);
+    target->Set(String::NewSymbol("Event"), Event, static_cast<v8::PropertyAttribute>(v8::ReadOnly | v8::DontDelete));
+
     // This has to be last, otherwise the properties won't show up on the object in JavaScript.
     target->Set(String::NewSymbol("Socket"), constructor);
     target->Set(String::NewSymbol("createSocket"), constructor);
+    target->Set(String::NewSymbol("Context"), Context::constructor);
+    target->Set(String::NewSymbol("Proxy"), Proxy::constructor);
+    target->Set(String::NewSymbol("proxy"), Proxy::constructor);
 
     int major, minor, patch;
     char version[100];
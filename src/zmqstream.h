@@ -2,13 +2,31 @@
 #define ZMQSTREAM_H
 
 #include <node.h>
+#include <zmq.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "coalesce.h"
+#include "compress.h"
+#include "identity.h"
+#include "iothread.h"
+#include "pool.h"
+#include "proxy.h"
+#include "stats.h"
+#include "trace.h"
+#include "trie.h"
 
 namespace zmqstream {
   //
   // ## ScopedContext
   //
-  // At the moment, there's a 1:1 relationship between Node processes and ZMQ contexts. This scope-based wrapper
-  // is used to ensure that global context is managed properly over the life of that process.
+  // The default ZMQ context is held by the process rather than by the module, so the native threads working on its
+  // behalf (`ioThread` sockets and proxies) share it, `inproc://` endpoints included. Loading the addon into more than
+  // one isolate isn't supported yet. It's created by the first reference and terminated once the last is released.
+  // Each ScopedContext holds a reference for as long as it's in scope, and each Socket created within the default
+  // context holds one until it's closed.
   //
   class ScopedContext {
     public:
@@ -16,6 +34,312 @@ namespace zmqstream {
 
       ScopedContext();
       ~ScopedContext();
+
+      //
+      // ## Acquire `Acquire()`
+      //
+      // Returns the shared context, creating it if there are no references to it yet, and adds a reference.
+      //
+      static void *Acquire();
+
+      //
+      // ## Release `Release()`
+      //
+      // Removes a reference to the shared context, terminating it if that was the last one.
+      //
+      static void Release();
+
+      //
+      // ## References `References()`
+      //
+      // Returns the number of references to the shared context.
+      //
+      static int References();
+
+    protected:
+      static uv_once_t lockOnce;
+      static uv_mutex_t lock;
+      static void *shared;
+      static int references;
+
+      static void InitLock();
+  };
+
+  //
+  // ## Context
+  //
+  // A ZMQ context, owning the I/O threads that handle its sockets' traffic. Sockets are created within the
+  // process-wide default context unless given a Context of their own, which is useful when a process needs more I/O
+  // threads than the default, or needs to pin sockets (see `ZMQ_AFFINITY`) and threads to specific cores.
+  //
+  class Context : public node::ObjectWrap {
+    public:
+      static v8::Persistent<v8::FunctionTemplate> constructorTemplate;
+      static v8::Persistent<v8::Function> constructor;
+
+      // The actual ZeroMQ context instance, or NULL once closed.
+      void *context;
+      // The number of open Sockets created within the context.
+      int sockets;
+
+      //
+      // ## Initialize
+      //
+      // Creates and populates the constructor Function and its prototype.
+      //
+      static void Initialize();
+
+      //
+      // ## HasInstance `HasInstance(value)`
+      //
+      // Returns true if **value** is a Context.
+      //
+      static bool HasInstance(v8::Handle<v8::Value> value);
+
+      virtual ~Context();
+
+    protected:
+      Context(void *context);
+
+      //
+      // ## Context(options)
+      //
+      // Creates a new ZMQ context, configured by **options**.
+      //
+      static v8::Handle<v8::Value> New(const v8::Arguments& args);
+
+      //
+      // ## Close `Close()`
+      //
+      // Terminates the underlying ZMQ context. Every Socket created within it must already be closed, as
+      // `zmq_ctx_destroy` would otherwise block until they are.
+      //
+      static v8::Handle<v8::Value> Close(const v8::Arguments& args);
+  };
+
+  //
+  // ## PinnedBuffer
+  //
+  // Keeps a Node Buffer alive for as long as ZeroMQ holds a pointer into its memory (see `zmq_msg_init_data`). ZeroMQ
+  // releases messages from its own I/O threads, so releases are queued and handed back to the main loop before the
+  // Buffer's persistent handle is disposed.
+  //
+  class PinnedBuffer {
+    public:
+      //
+      // ## Initialize
+      //
+      // Prepares the release queue and its `uv_async_t`. Must be called once from the main thread.
+      //
+      static void Initialize();
+
+      //
+      // ## InitMessage `InitMessage(msg, buffer)`
+      //
+      // Initializes **msg** over the memory of **buffer** without copying, pinning **buffer** until ZeroMQ is done
+      // with it. Returns the result of `zmq_msg_init_data`.
+      //
+      static int InitMessage(zmq_msg_t *msg, v8::Handle<v8::Object> buffer);
+
+    protected:
+      v8::Persistent<v8::Object> buffer;
+      PinnedBuffer *next;
+
+      // Releases queued by ZeroMQ, waiting to be disposed of on the main thread.
+      static PinnedBuffer *released;
+      static uv_mutex_t releasedLock;
+      static uv_async_t releasedHandle;
+
+      //
+      // ## Release
+      //
+      // A `zmq_free_fn` queueing the PinnedBuffer **hint** for disposal. Called from any thread.
+      //
+      static void Release(void *data, void *hint);
+
+      //
+      // ## Dispose
+      //
+      // A `uv_async_cb` disposing of every queued PinnedBuffer on the main thread.
+      //
+      static void Dispose(uv_async_t *handle, int status);
+  };
+
+  class Socket;
+
+  //
+  // ## Proxy
+  //
+  // Forwards messages between two Sockets (and copies them to an optional third) on a ProxyThread, so brokering runs
+  // at native speed without any message crossing into JS. The Sockets belong to the thread until the Proxy is
+  // terminated, and can't be used from JS in the meantime.
+  //
+  class Proxy : public node::ObjectWrap {
+    public:
+      static v8::Persistent<v8::Function> constructor;
+
+      //
+      // ## Initialize
+      //
+      // Creates and populates the constructor Function and its prototype.
+      //
+      static void Initialize();
+
+      //
+      // ## Terminate `Terminate()`
+      //
+      // Stops the thread, handing the Sockets back to JS. Terminating more than once is harmless.
+      //
+      void Terminate();
+
+      virtual ~Proxy();
+
+    protected:
+      ProxyThread *thread;
+      // True until the Proxy is terminated. The thread itself is kept around afterwards, for its counters.
+      bool running;
+      // The Sockets lent to the thread, kept alive for as long as it runs. `capture` may be empty.
+      v8::Persistent<v8::Object> frontend;
+      v8::Persistent<v8::Object> backend;
+      v8::Persistent<v8::Object> capture;
+
+      Proxy();
+
+      //
+      // ## Proxy(frontend, backend, options)
+      //
+      // Starts forwarding between the Sockets **frontend** and **backend**, copying every message to
+      // **options.capture**, if given.
+      //
+      static v8::Handle<v8::Value> New(const v8::Arguments& args);
+
+      //
+      // ## Pause `Pause()`
+      //
+      // Stops forwarding messages until `Resume` is called.
+      //
+      static v8::Handle<v8::Value> Pause(const v8::Arguments& args);
+
+      //
+      // ## Resume `Resume()`
+      //
+      // Resumes forwarding messages after `Pause`.
+      //
+      static v8::Handle<v8::Value> Resume(const v8::Arguments& args);
+
+      //
+      // ## Terminate `Terminate()`
+      //
+      // Stops forwarding messages for good, handing the Sockets back to JS.
+      //
+      static v8::Handle<v8::Value> Terminate(const v8::Arguments& args);
+
+      //
+      // ## Stats `Stats()`
+      //
+      // Returns the messages and bytes forwarded in each direction so far.
+      //
+      static v8::Handle<v8::Value> Stats(const v8::Arguments& args);
+  };
+
+  //
+  // ## Poller
+  //
+  // Tracks readiness for every Socket on the loop. Each Socket contributes a single `uv_poll_t` on its ZMQ_FD, and
+  // marks itself "dirty" whenever ZMQ_EVENTS may have changed: after a send or recv, or when its fd is signaled.
+  // Every dirty Socket is then checked in a single pass, right after the loop polls for I/O or right before it
+  // blocks, so the work done on each turn of the loop grows with the number of active sockets rather than the number
+  // of open ones, and a quiet loop never spins.
+  //
+  class Poller {
+    public:
+      //
+      // ## Initialize
+      //
+      // Prepares the shared loop handles. Must be called once from the main thread.
+      //
+      static void Initialize();
+
+      //
+      // ## MarkDirty `MarkDirty(socket)`
+      //
+      // Queues **socket** to have its ZMQ_EVENTS checked during the next pass. Marking a Socket more than once before
+      // that pass is free.
+      //
+      static void MarkDirty(Socket *socket);
+
+      //
+      // ## Remove `Remove(socket)`
+      //
+      // Forgets **socket**, which is about to be closed or destroyed.
+      //
+      static void Remove(Socket *socket);
+
+      //
+      // ## AddSpinner `AddSpinner(socket)`
+      //
+      // Busy polls **socket** (see `Spin`) until it's removed with `RemoveSpinner`.
+      //
+      static void AddSpinner(Socket *socket);
+      static void RemoveSpinner(Socket *socket);
+
+    protected:
+      // Active only while Sockets are dirty, which keeps the loop from blocking before they've been checked.
+      static uv_idle_t idleHandle;
+      // Always active, but unreferenced, running passes before and after the loop polls for I/O.
+      static uv_prepare_t prepareHandle;
+      static uv_check_t checkHandle;
+      // Sockets marked dirty since the last pass began.
+      static Socket *dirty;
+      // Sockets still to be checked by the pass in progress.
+      static Socket *checking;
+      // Sockets with `busyPollMicros`, and those taking part in the current busy poll.
+      static std::vector<Socket*> spinners;
+      static std::vector<Socket*> spinning;
+
+      //
+      // ## Run
+      //
+      // Checks every dirty Socket, if there are any.
+      //
+      static void Run();
+
+      //
+      // ## Wait
+      //
+      // A `uv_idle_cb` that does nothing, as `idleHandle` only has to be active.
+      //
+      static void Wait(uv_idle_t *handle, int status);
+
+      //
+      // ## RunBeforePoll
+      //
+      // A `uv_prepare_cb` running a pass just before the loop polls (and perhaps blocks) for I/O.
+      //
+      static void RunBeforePoll(uv_prepare_t *handle, int status);
+
+      //
+      // ## RunAfterPoll
+      //
+      // A `uv_check_cb` running a pass just after the loop has polled for I/O, and emitted whatever it found.
+      //
+      static void RunAfterPoll(uv_check_t *handle, int status);
+
+      //
+      // ## Spin `Spin()`
+      //
+      // Busy polls ZMQ_EVENTS on every spinner that's waiting to be readable and was read from or written to less
+      // than `busyPollMicros` ago, until one of them has a message or they've all run out of time. Sockets with a
+      // message are checked straight away, rather than once their fd has woken the loop up.
+      //
+      static void Spin();
+
+      //
+      // ## Unlink `Unlink(head, socket)`
+      //
+      // Removes **socket** from the list starting at **head**, returning true if it was found.
+      //
+      static bool Unlink(Socket **head, Socket *socket);
   };
 
   //
@@ -25,8 +349,16 @@ namespace zmqstream {
   // you can `connect`, `bind`, etc. just like a native ZMQ socket.
   //
   class Socket : public node::ObjectWrap {
+    friend class Poller;
+    friend class Proxy;
+
     public:
+      static v8::Persistent<v8::FunctionTemplate> constructorTemplate;
       static v8::Persistent<v8::Function> constructor;
+      // Strings used by every check, created once.
+      static v8::Persistent<v8::String> emitSymbol;
+      static v8::Persistent<v8::String> readableSymbol;
+      static v8::Persistent<v8::String> drainSymbol;
 
       //
       // ## Initialize
@@ -38,23 +370,31 @@ namespace zmqstream {
       //
       // ## InstallExports
       //
-      // Exports the Socket class within the module `target`.
+      // Exports the Socket, Context and Proxy classes within the module `target`.
       //
       static void InstallExports(v8::Handle<v8::Object> target);
 
+      //
+      // ## HasInstance `HasInstance(value)`
+      //
+      // Returns true if **value** is a Socket.
+      //
+      static bool HasInstance(v8::Handle<v8::Value> value);
+
       //
       // ## Check
       //
-      // A `uv_poll_cb` registered to facilitate generating `'readable'` and `'drain'` events.
+      // A `uv_poll_cb` registered to facilitate generating `'readable'` and `'drain'` events, by way of the Poller.
       //
       static void Check(uv_poll_t* handle, int status, int events);
 
       //
       // ## Check
       //
-      // A `uv_idle_cb` registered to facilitate generating `'readable'` and `'drain'` events.
+      // A `uv_async_cb` registered to facilitate generating `'readable'` and `'drain'` events for sockets owned by an
+      // IOThread.
       //
-      static void Check(uv_idle_t* handle, int status);
+      static void Check(uv_async_t* handle, int status);
 
       //
       // ## Check
@@ -65,6 +405,41 @@ namespace zmqstream {
 
       virtual ~Socket();
 
+      //
+      // ## ClosePollHandle
+      //
+      // A `uv_close_cb` freeing a Socket's `pollHandle`.
+      //
+      static void ClosePollHandle(uv_handle_t *handle);
+
+      //
+      // ## CloseTimerHandle
+      //
+      // A `uv_close_cb` freeing a Socket's `coalesceTimer`.
+      //
+      static void CloseTimerHandle(uv_handle_t *handle);
+
+      //
+      // ## FlushTimer
+      //
+      // A `uv_timer_cb` flushing a Socket's partial batch.
+      //
+      static void FlushTimer(uv_timer_t *handle, int status);
+
+      //
+      // ## RunCompressJob
+      //
+      // A `uv_work_cb` compressing a CompressJob's frames on libuv's threadpool.
+      //
+      static void RunCompressJob(uv_work_t *request);
+
+      //
+      // ## AfterCompressJob
+      //
+      // A `uv_after_work_cb` sending a CompressJob's message, and any queued behind it, once it's been compressed.
+      //
+      static void AfterCompressJob(uv_work_t *request, int status);
+
     protected:
       // The actual ZeroMQ socket instance.
       void *socket;
@@ -73,18 +448,449 @@ namespace zmqstream {
       // on the file descriptor", and that same file descriptor is signaled in an edge-triggered fashion by ZeroMQ, we
       // need a combination of approaches to integrate it with Libuv:
       //
-      // A pair of uv_poll handles are responsible for picking up on readability/writability tests out of band with send
-      // and recv calls.
-      uv_poll_t readableHandle;
-      uv_poll_t writableHandle;
-      // A uv_idle handle is responsible for queueing Check calls to be called "soon".
-      uv_idle_t idleHandle;
+      // A uv_poll handle is responsible for picking up on state changes out of band with send and recv calls. ZeroMQ
+      // only ever signals the fd as readable, whether the change was to POLLIN or POLLOUT, so one handle covers both
+      // and is only active while an event is expected.
+      uv_poll_t *pollHandle;
+      // The Poller is responsible for queueing Check calls to be called "soon", using these to track dirty Sockets.
+      bool dirty;
+      Socket *prevDirty;
+      Socket *nextDirty;
+      // A flag that is true when the pending check was triggered by the fd being signaled, rather than a send or recv.
+      bool polled;
       // A flag that is true when the application should expect a "drain" event.
       bool shouldDrain;
       // A flag that is true when the application should expect a "readable" event.
       bool shouldReadable;
+      // False for socket types that can't receive (PUSH and PUB), whose fd never needs watching for messages.
+      bool canRead;
+      // The socket's `emit`, looked up by its first check.
+      v8::Persistent<v8::Function> emitFunction;
+      // How long to busy poll for after each read or write (see `Poller::Spin`), and when the last of those was.
+      uint64_t busyPollNanos;
+      uint64_t lastActive;
+      // Received frames of at least this many bytes are handed to JS without being copied. Zero disables this.
+      size_t zeroCopyReads;
+      // Written frames of at least this many bytes are sent from the Buffer's own memory. Zero disables this.
+      size_t zeroCopyWrites;
+      // Received frames of up to `framePool->MaxFrameSize()` bytes are carved from this pool. NULL disables this.
+      FramePool *framePool;
+      // If the socket has been handed to a dedicated thread, that thread. NULL otherwise.
+      IOThread *ioThread;
+      // If the socket has been lent to a Proxy, that Proxy. NULL otherwise.
+      Proxy *proxy;
+
+      //
+      // ### Forwarding
+      //
+      // The destination and rules of a socket forwarding its messages natively (see `ForwardTo`).
+      //
+      struct Forwarding {
+        Socket *target;
+        // Receives a copy of every message forwarded, if it has room. May be NULL.
+        Socket *tee;
+        // Kept alive for as long as the socket forwards to them.
+        v8::Persistent<v8::Object> targetHandle;
+        v8::Persistent<v8::Object> teeHandle;
+        // Only messages whose first frame starts with `prefix` (and doesn't start with `drop`) are forwarded.
+        std::string prefix;
+        bool hasDrop;
+        std::string drop;
+        // True while `target` is full, in which case the socket isn't read from until it has room again.
+        bool blocked;
+      };
 
-      Socket(int type);
+      // If the socket is forwarding its messages, where to and how. NULL otherwise.
+      Forwarding *forwarding;
+      // The sockets forwarding to this one that are waiting for it to have room.
+      std::vector<Socket*> forwardWaiters;
+      // Packs written messages into batches, and is the reason received batches are unpacked. NULL disables both.
+      Coalescer *coalescer;
+      // Flushes a partial batch once it's waited `coalesceMillis`. Allocated separately, like `pollHandle`.
+      uv_timer_t *coalesceTimer;
+      uint64_t coalesceMillis;
+      // A flag that is true while a batch is waiting for room to be sent, during which writes are refused.
+      bool coalesceStalled;
+
+      //
+      // ### CompressJob
+      //
+      // A message written to a compressing socket that has to wait its turn to be sent: either because one of its
+      // frames is large enough to be compressed on libuv's threadpool, or because an earlier message is. Each frame
+      // is a copy, replaced by its compressed form if that's smaller. Both are released with `Compressor::Free`.
+      //
+      struct CompressJob {
+        struct Frame {
+          char *data;
+          size_t size;
+        };
+
+        uv_work_t request;
+        Socket *socket;
+        Compressor *compressor;
+        std::vector<Frame> frames;
+        // True once the frames have been compressed, and the message can be sent.
+        bool done;
+        // True once the socket has been closed while the job was on the threadpool, which then discards it.
+        bool orphaned;
+        // Compression counters, added to the socket's own once the job is done.
+        uint64_t frameBytes;
+        uint64_t compressedBytes;
+        uint64_t compressedFrames;
+        uint64_t nanos;
+
+        ~CompressJob();
+
+        //
+        // ## Compress `Compress(context)`
+        //
+        // Compresses each frame, given a **context** from `compressor` that only this thread is using.
+        //
+        void Compress(void *context);
+      };
+
+      // The most messages waiting in `compressJobs` before writes are refused.
+      static const size_t MAX_COMPRESS_JOBS = 64;
+
+      // Compresses written frames, and is the reason received frames are decompressed. NULL disables both.
+      Compressor *compressor;
+      // The main thread's scratch state for `compressor`.
+      void *compressContext;
+      // Messages with a frame of at least this many bytes are compressed on libuv's threadpool. Zero disables this.
+      size_t compressAsyncBytes;
+      // Messages waiting to be sent, in the order they were written. Only the first may be sent next.
+      std::deque<CompressJob*> compressJobs;
+
+      //
+      // ### QueuedMessage
+      //
+      // A message written while ZeroMQ had no room for it, waiting in `outbound` to be sent. Its frames are built
+      // up front, exactly as `SendMessage` would have sent them, so sending it later copies nothing.
+      //
+      struct QueuedMessage {
+        std::vector<zmq_msg_t> parts;
+        // The number of `parts` initialized so far, which are closed along with the message.
+        size_t ready;
+        // The bytes of every frame but the trace frame, as counted by `stats.bytesOut`.
+        size_t bytes;
+
+        ~QueuedMessage();
+      };
+
+      // Messages written while ZeroMQ had no room for them, in the order they were written (see `queueBytes`).
+      std::deque<QueuedMessage*> outbound;
+      size_t outboundBytes;
+      // The high-water marks of `outbound`, past which writes return false. Zero disables the queue altogether.
+      size_t queueBytes;
+      size_t queueMessages;
+      // The subscriptions of an XPUB socket, if it tracks them (see `trackSubscriptions`). NULL otherwise.
+      SubscriptionTrie *subscriptions;
+      // The interned identities of a ROUTER socket's peers, if it interns them (see `internIdentities`). NULL
+      // otherwise.
+      IdentityTable *peers;
+      // How long a tracing socket's messages took to arrive, and how long they waited to be read once they had (see
+      // `trace`). NULL unless tracing.
+      LatencyHistogram *transitLatency;
+      LatencyHistogram *queueLatency;
+      // When the socket last woke up to be checked, and when the wakeup that led to a pending `'readable'` happened.
+      // Zero if there's none.
+      uint64_t wakeNanos;
+      uint64_t readableNanos;
+      //
+      // ### Monitoring
+      //
+      // The state of a monitor socket (see `Monitor`), which decodes the events it receives rather than returning them.
+      //
+      struct Monitoring {
+        // When each endpoint started connecting (or reconnecting) or handshaking, for timing how long that took.
+        std::map<std::string, uint64_t> since;
+      };
+
+      // If this is a monitor socket, its state. NULL otherwise.
+      Monitoring *monitoring;
+      // The monitor socket watching this one, if any, kept alive for as long as this socket is open.
+      v8::Persistent<v8::Object> monitorHandle;
+      // The Context the socket was created in, if not the default one, kept alive for as long as the socket is open.
+      v8::Persistent<v8::Object> contextHandle;
+      // True while the socket holds a reference to the shared default context.
+      bool sharedContext;
+      // The frames of a message `ReadInto` received but had no room for, as received, which every read returns
+      // before anything else (see `RecvFrame`).
+      std::deque<zmq_msg_t> stash;
+      // Hot-path counters, exposed by `Stats`.
+      SocketStats stats;
+
+      Socket(void *context, int type);
+
+      //
+      // ## RecvFrame `RecvFrame(part)`
+      //
+      // Receives the next frame into **part** without blocking, either straight from the ZMQ socket or, for sockets
+      // owned by an IOThread, from its incoming Ring. Frames in `stash` come first. Behaves like `zmq_msg_recv`.
+      //
+      int RecvFrame(zmq_msg_t *part);
+
+      //
+      // ## SendFrame `SendFrame(part, flags)`
+      //
+      // Sends **part** without blocking, either straight to the ZMQ socket or, for sockets owned by an IOThread, to
+      // its outgoing Ring. Behaves like `zmq_msg_send`.
+      //
+      int SendFrame(zmq_msg_t *part, int flags);
+
+      //
+      // ## CompressFrame `CompressFrame(part, data, size)`
+      //
+      // Initializes **part** with the **size** bytes at **data**, compressed if that makes them smaller. Behaves like
+      // `zmq_msg_init_size`.
+      //
+      int CompressFrame(zmq_msg_t *part, const char *data, size_t size);
+
+      //
+      // ## DecompressFrame `DecompressFrame(part)`
+      //
+      // Replaces **part** with its decompressed form if it's a compressed frame. Corrupt frames are left as they are.
+      // The ZMQ_RCVMORE flag of **part** is lost, so it has to be read beforehand.
+      //
+      void DecompressFrame(zmq_msg_t *part);
+
+      //
+      // ## QueueCompressed `QueueCompressed(frames)`
+      //
+      // Queues **frames** as a CompressJob behind those already waiting. Behaves like `SendMessage`.
+      //
+      int QueueCompressed(v8::Handle<v8::Array> frames);
+
+      //
+      // ## SendCompressed `SendCompressed()`
+      //
+      // Sends every CompressJob that's done from the front of `compressJobs`, for as long as there is room. Returns
+      // 0 once none are left to send, or -1 if any could not be sent, including EAGAIN.
+      //
+      int SendCompressed();
+
+      //
+      // ## QueueMessage `QueueMessage(frames)`
+      //
+      // Sends **frames** if nothing is queued ahead of it and there's room, and queues it in `outbound` otherwise.
+      // Behaves like `SendMessage`, except that EAGAIN is never returned.
+      //
+      int QueueMessage(v8::Handle<v8::Array> frames);
+
+      //
+      // ## SendQueued `SendQueued()`
+      //
+      // Sends messages from the front of `outbound` for as long as there is room. Behaves like `SendCompressed`.
+      //
+      int SendQueued();
+
+      //
+      // ## QueueFull `QueueFull()`
+      //
+      // Returns true if `outbound` has reached either of its high-water marks.
+      //
+      bool QueueFull();
+
+      //
+      // ## RecordCompression `RecordCompression(job)`
+      //
+      // Adds the compression counters of **job** to the socket's own.
+      //
+      void RecordCompression(CompressJob *job);
+
+      //
+      // ## ScheduleCheck `ScheduleCheck()`
+      //
+      // Arranges for ZMQ_EVENTS to be checked "soon", as is required after every send and recv.
+      //
+      void ScheduleCheck();
+
+      //
+      // ## Waiting `Waiting()`
+      //
+      // Returns true if a check could do anything other than emit `'readable'`.
+      //
+      bool Waiting();
+
+      //
+      // ## Spinning `Spinning(now)`
+      //
+      // Returns true if the socket should be busy polled at **now**.
+      //
+      bool Spinning(uint64_t now);
+
+      //
+      // ## CheckAfterRecv `CheckAfterRecv(rc)`
+      //
+      // Schedules the check required after a read that ended with **rc**, unless it can't find anything new.
+      //
+      void CheckAfterRecv(int rc);
+
+      //
+      // ## CheckAfterSend `CheckAfterSend(rc)`
+      //
+      // Schedules the check required after a write that ended with **rc**, unless it can't find anything new.
+      //
+      void CheckAfterSend(int rc);
+
+      //
+      // ## WatchReadable `WatchReadable()`
+      //
+      // Arranges for `'readable'` to be emitted once there is something to read.
+      //
+      void WatchReadable();
+
+      //
+      // ## WatchWritable `WatchWritable()`
+      //
+      // Arranges for `'drain'` to be emitted once there is room to write.
+      //
+      void WatchWritable();
+
+      //
+      // ## HasPending `HasPending()`
+      //
+      // Returns true if the socket holds messages that haven't reached (or been read from) the ZMQ socket yet: a
+      // coalesced batch, compression jobs, its outbound queue, or frames `ReadInto` stashed.
+      //
+      bool HasPending();
+
+      //
+      // ## HandOff `HandOff(proxy)`
+      //
+      // Lends the socket to **proxy**, which will use it from another thread until `TakeBack` is called.
+      //
+      void HandOff(Proxy *proxy);
+
+      //
+      // ## TakeBack `TakeBack()`
+      //
+      // Reclaims the socket from its Proxy, resuming any events the application was waiting on.
+      //
+      void TakeBack();
+
+      //
+      // ## Events `Events()`
+      //
+      // Returns ZMQ_EVENTS for the socket, or its IOThread's equivalent. Returns -1 on failure.
+      //
+      int Events();
+
+      //
+      // ## Forward `Forward()`
+      //
+      // Moves a batch of messages from the socket to its forwarding target without creating any JS objects, stopping
+      // early (and blocking) if the target fills up.
+      //
+      void Forward();
+
+      //
+      // ## StopForwarding `StopForwarding()`
+      //
+      // Stops forwarding messages, if the socket is.
+      //
+      void StopForwarding();
+
+      //
+      // ## ConsumeSubscriptions `ConsumeSubscriptions(jsObj, emit)`
+      //
+      // Reads a batch of subscription messages into `subscriptions`, emitting `'subscribe'` and `'unsubscribe'` on
+      // **jsObj** whenever a topic gains its first subscriber or loses its last one. Other messages are dropped.
+      //
+      void ConsumeSubscriptions(v8::Handle<v8::Object> jsObj, v8::Handle<v8::Function> emit);
+
+      //
+      // ## ConsumeEvents `ConsumeEvents(jsObj, emit)`
+      //
+      // Reads a batch of monitor events, emitting each on **jsObj** both as `'event'` and under its own name.
+      //
+      void ConsumeEvents(v8::Handle<v8::Object> jsObj, v8::Handle<v8::Function> emit);
+
+      //
+      // ## CreateFrame `CreateFrame(part)`
+      //
+      // Creates a Node Buffer for the received frame **part**. Small frames are copied (into the FramePool, if there
+      // is one), leaving **part** untouched. Frames of at least `zeroCopyReads` bytes are moved into a heap-allocated
+      // message that the Buffer keeps alive, leaving **part** empty.
+      //
+      v8::Handle<v8::Object> CreateFrame(zmq_msg_t *part);
+
+      //
+      // ## CopyFrame `CopyFrame(data, size)`
+      //
+      // Creates a Node Buffer holding a copy of the **size** bytes at **data**, carved from the FramePool if there is
+      // one.
+      //
+      v8::Handle<v8::Object> CopyFrame(const char *data, size_t size);
+
+      //
+      // ## UnpackBatch `UnpackBatch(batch, messages)`
+      //
+      // Appends every message packed into the frame **batch** to **messages**, returning how many there were. Returns
+      // 0, leaving **messages** untouched, if **batch** is malformed.
+      //
+      uint32_t UnpackBatch(zmq_msg_t *batch, v8::Handle<v8::Array> messages);
+
+      //
+      // ## CoalesceMessage `CoalesceMessage(frames)`
+      //
+      // Adds **frames** to the current batch, flushing it if that makes it full. Behaves like `SendMessage`.
+      //
+      int CoalesceMessage(v8::Handle<v8::Array> frames);
+
+      //
+      // ## FlushBatch `FlushBatch()`
+      //
+      // Sends the current batch, if there is one. If the socket has no room for it, it's kept, the socket is marked
+      // as stalled, and -1 is returned with EAGAIN.
+      //
+      int FlushBatch();
+
+      //
+      // ## IsMessage `IsMessage(frames)`
+      //
+      // Returns true if every element of **frames** is a Buffer, and can therefore be sent with `SendMessage`.
+      //
+      static bool IsMessage(v8::Handle<v8::Array> frames);
+
+      //
+      // ## StripTrace `StripTrace(part)`
+      //
+      // Returns true if **part** is a trace frame and the socket is tracing, recording how long ago it was sent.
+      //
+      bool StripTrace(zmq_msg_t *part);
+
+      //
+      // ## RecordQueued `RecordQueued()`
+      //
+      // Records how long the messages about to be read waited since the wakeup that announced them, if tracing.
+      //
+      void RecordQueued();
+
+      //
+      // ## SendMessage `SendMessage(frames, envelope)`
+      //
+      // Sends **frames**, an already-validated Array of Buffers, to the ZMQ socket as a single multipart message. If
+      // **envelope** isn't NULL, it's sent first, as is, and closed (or sent) whatever happens.
+      //
+      // Returns 0 on success, or -1 if any frame could not be sent (see `zmq_msg_send`), including EAGAIN.
+      //
+      int SendMessage(v8::Handle<v8::Array> frames, zmq_msg_t *envelope = NULL);
+
+      //
+      // ## InitFrame `InitFrame(part, buffer)`
+      //
+      // Initializes **part** with the contents of **buffer**, compressed, pinned or copied as the socket is
+      // configured to. Behaves like `zmq_msg_init_size`.
+      //
+      int InitFrame(zmq_msg_t *part, v8::Handle<v8::Object> buffer);
+
+      //
+      // ## ReleaseFrame
+      //
+      // A `free_callback` for zero-copy Buffers, closing the message that backs them once they've been collected.
+      //
+      static void ReleaseFrame(char *data, void *hint);
 
       //
       // ## Socket(options)
@@ -120,6 +926,10 @@ namespace zmqstream {
       // Consumes a maximum of **size** messages of data from the ZMQ socket. If **size** is undefined, the entire
       // queue will be read and returned.
       //
+      // **size** may also be a budget Object with any of `maxMessages`, `maxBytes` and `maxMicros`, checked between
+      // messages. A read that stops short of the queue's end is then followed by another 'readable' event, on a later
+      // tick, so a deep queue never stalls the loop.
+      //
       // If there is no data to consume then null is returned, and a future 'readable' event will be emitted when more is
       // available.
       //
@@ -132,6 +942,31 @@ namespace zmqstream {
       //
       static v8::Handle<v8::Value> Read(const v8::Arguments& args);
 
+      //
+      // ## ReadFlat `ReadFlat(size)`
+      //
+      // Consumes a maximum of **size** messages (or a budget), exactly like `Read`, but packs every frame into a
+      // single Buffer rather than allocating one Buffer (and Array) per frame (and message).
+      //
+      // Returns an Object with `data`, the Buffer of every frame back to back, and `index`, a Uint32Array describing
+      // the batch. For each message in order, `index` holds its frame count followed by the offset and length of each
+      // frame within `data`. The number of messages is available as `messages`. Returns null if there is no data to
+      // consume, just like `Read`.
+      //
+      static v8::Handle<v8::Value> ReadFlat(const v8::Arguments& args);
+
+      //
+      // ## ReadInto `ReadInto(target, index, [offset])`
+      //
+      // Copies as many whole messages as fit into **target**, a Buffer, ArrayBuffer or typed array, starting
+      // **offset** bytes in, and describes them in **index**, a Uint32Array, exactly as `ReadFlat` would. Nothing is
+      // allocated at all.
+      //
+      // Returns the number of messages read, which is 0 if the next message didn't fit. It's kept, and returned by
+      // the next read. Returns null if there is no data to consume, just like `Read`.
+      //
+      static v8::Handle<v8::Value> ReadInto(const v8::Arguments& args);
+
       //
       // ## Write `Write(message)`
       //
@@ -147,6 +982,100 @@ namespace zmqstream {
       //
       static v8::Handle<v8::Value> Write(const v8::Arguments& args);
 
+      //
+      // ## WriteMany `WriteMany(messages)`
+      //
+      // Writes as many of **messages**, an Array of Messages, as the ZMQ socket will accept, in order.
+      //
+      // Every frame of every message is validated before anything is sent, and ZMQ_EVENTS is checked once for the
+      // whole batch rather than once per message.
+      //
+      // Returns the number of messages queued successfully. If that's fewer than `messages.length`, the buffer is full
+      // (see ZMQ_DONTWAIT/EAGAIN), and a `'drain'` event will be emitted when the rest can be tried again.
+      //
+      static v8::Handle<v8::Value> WriteMany(const v8::Arguments& args);
+
+      //
+      // ## ForwardTo `ForwardTo(target, options)`
+      //
+      // Forwards every message received from here on to the Socket **target** natively, during the checks that
+      // would otherwise emit `'readable'`, until called again with null. Supported options:
+      //
+      // - `prefix`: Only forward messages whose first frame starts with this Buffer or String.
+      // - `drop`: Drop messages whose first frame starts with this Buffer or String.
+      // - `tee`: Also send a copy of every forwarded message to this Socket, whenever it has room.
+      //
+      static v8::Handle<v8::Value> ForwardTo(const v8::Arguments& args);
+
+      //
+      // ## HasSubscribers `HasSubscribers(topic)`
+      //
+      // Returns true if any subscription of an XPUB socket tracking them (see `trackSubscriptions`) is a prefix of
+      // **topic**, a Buffer or String. Without **topic**, returns true if there are any subscriptions at all.
+      //
+      static v8::Handle<v8::Value> HasSubscribers(const v8::Arguments& args);
+
+      //
+      // ## ReadRequests `ReadRequests(size)`
+      //
+      // Consumes messages exactly like `Read`, but from a ROUTER socket interning its peers' identities (see
+      // `internIdentities`), returning each as an Object with the sender's `peer` handle and the rest of its `body`.
+      //
+      static v8::Handle<v8::Value> ReadRequests(const v8::Arguments& args);
+
+      //
+      // ## Reply `Reply(peer, frames)`
+      //
+      // Writes **frames** to **peer**, a handle returned by `ReadRequests`, reusing its interned identity. Behaves
+      // like `Write`.
+      //
+      static v8::Handle<v8::Value> Reply(const v8::Arguments& args);
+
+      //
+      // ## Forget `Forget(peer)`
+      //
+      // Forgets **peer**'s identity, so its handle can be reused. Returns false if there was no such peer.
+      //
+      static v8::Handle<v8::Value> Forget(const v8::Arguments& args);
+
+      //
+      // ## Latency `Latency(reset)`
+      //
+      // Returns percentiles of a tracing socket's latencies (see `trace`), resetting them afterwards if **reset** is
+      // true. Returns null unless tracing.
+      //
+      static v8::Handle<v8::Value> Latency(const v8::Arguments& args);
+
+      //
+      // ## Monitor `Monitor(events)`
+      //
+      // Starts monitoring the socket for the ZMQ_EVENT_* flags in **events** (all of them by default), returning a
+      // PAIR Socket that emits each event, named and timestamped, instead of `'readable'`. Called with false, stops
+      // monitoring.
+      //
+      static v8::Handle<v8::Value> Monitor(const v8::Arguments& args);
+
+      //
+      // ## PoolStats `PoolStats()`
+      //
+      // Returns the occupancy of the socket's frame pool (see `pooledReads`), or null if it doesn't have one.
+      //
+      static v8::Handle<v8::Value> PoolStats(const v8::Arguments& args);
+
+      //
+      // ## Stats `Stats()`
+      //
+      // Returns a snapshot of the socket's hot-path counters (see `SocketStats`). Available even once closed.
+      //
+      static v8::Handle<v8::Value> Stats(const v8::Arguments& args);
+
+      //
+      // ## ResetStats `ResetStats()`
+      //
+      // Zeroes the socket's hot-path counters.
+      //
+      static v8::Handle<v8::Value> ResetStats(const v8::Arguments& args);
+
       //
       // ## Connect `Connect(endpoint)`
       //
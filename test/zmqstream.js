@@ -61,10 +61,132 @@ describe('ZMQStream', function () {
       expect(zmqstream.Option.SUBSCRIBE, 'SUBSCRIBE').to.exist
       expect(zmqstream.Option.UNSUBSCRIBE, 'UNSUBSCRIBE').to.exist
       expect(zmqstream.Option.LINGER, 'LINGER').to.exist
+      expect(zmqstream.Option.AFFINITY, 'AFFINITY').to.exist
       // TODO: Support and test other options.
     })
   })
 
+  describe('Context', function () {
+    it('should exist', function () {
+      expect(zmqstream.Context).to.exist
+      expect(zmqstream.Context).to.be.a('function')
+    })
+
+    it('should apply ioThreads', function () {
+      var context = new zmqstream.Context({ ioThreads: 3 })
+
+      expect(context.ioThreads).to.equal(3)
+      context.close()
+    })
+
+    it('should create sockets that communicate within it', function () {
+      var context = new zmqstream.Context({ ioThreads: 2 })
+        , endpoint = getInprocEndpoint()
+        , sender = new zmqstream.Socket({ context: context })
+        , receiver = new zmqstream.Socket({ context: context })
+        , messages
+
+      receiver.bind(endpoint)
+      sender.connect(endpoint)
+      sender.write([new Buffer('one')])
+      messages = receiver.read()
+
+      expect(messages).to.have.length(1)
+      expect(messages[0][0].toString()).to.equal('one')
+
+      sender.close()
+      receiver.close()
+      context.close()
+    })
+
+    it('should refuse to create sockets once closed', function () {
+      var context = new zmqstream.Context()
+
+      context.close()
+
+      expect(function () {
+        zmqstream.Socket({ context: context })
+      }).to.throw('Context is closed')
+    })
+
+    it('should refuse to close while sockets are open', function () {
+      var context = new zmqstream.Context()
+        , socket = new zmqstream.Socket({ context: context })
+
+      expect(function () {
+        context.close()
+      }).to.throw(ReferenceError)
+
+      socket.close()
+      context.close()
+
+      expect(function () {
+        zmqstream.Socket({ context: context })
+      }).to.throw('Context is closed')
+    })
+
+    it('should reject invalid contexts', function () {
+      expect(function () {
+        zmqstream.Socket({ context: {} })
+      }).to.throw('Invalid context')
+    })
+  })
+
+  describe('_contextReferences', function () {
+    it('should count open sockets in the default context', function () {
+      var before = zmqstream._contextReferences()
+        , socket = new Socket()
+
+      expect(before).to.be.at.least(1)
+      expect(zmqstream._contextReferences()).to.equal(before + 1)
+
+      socket.close()
+      expect(zmqstream._contextReferences()).to.equal(before)
+    })
+
+    it('should not count sockets in other contexts', function () {
+      var before = zmqstream._contextReferences()
+        , context = new zmqstream.Context()
+        , socket = new Socket({ context: context })
+
+      expect(zmqstream._contextReferences()).to.equal(before)
+
+      socket.close()
+      context.close()
+    })
+
+    it('should only release a socket\'s reference once', function () {
+      var before = zmqstream._contextReferences()
+        , socket = new Socket()
+
+      socket.close()
+      socket.close()
+      expect(zmqstream._contextReferences()).to.equal(before)
+    })
+
+    it('should not take a reference for a socket with rejected options', function () {
+      var before = zmqstream._contextReferences()
+        , rejected = [
+          { type: zmqstream.Type.PUSH, pooledReads: 1024, poolSlabSize: 1024 }
+          , { type: zmqstream.Type.ROUTER, coalesce: true }
+          , { type: zmqstream.Type.PUSH, compress: 'gzip' }
+          , { type: zmqstream.Type.PUB, trackSubscriptions: true }
+          , { type: zmqstream.Type.XPUB, trackSubscriptions: true, internIdentities: true }
+          , { type: zmqstream.Type.PUSH, coalesce: true, trace: true }
+          , { type: zmqstream.Type.DEALER, busyPollMicros: 50, queueBytes: 1, ioThread: true }
+          , { type: zmqstream.Type.PUSH, busyPollMicros: 50, queueMessages: 1, coalesce: true }
+        ]
+
+      rejected.forEach(function (options) {
+        expect(function () {
+          new Socket(options)
+        }).to.throw(TypeError)
+      })
+
+      expect(zmqstream._contextReferences()).to.equal(before)
+    })
+  })
+
   describe('Socket', function () {
     it('should exist', function () {
       expect(zmqstream.Socket).to.exist
@@ -118,6 +240,26 @@ describe('ZMQStream', function () {
         this.socket.write([new Buffer('one'), new Buffer('two'), new Buffer('three')])
       })
 
+      it('should send large frames without copying when zeroCopyWrites is set', function () {
+        var socket = new Socket({ zeroCopyWrites: 64 })
+          , receiver = new Socket()
+          , endpoint = getInprocEndpoint()
+          , large = new Buffer(4096)
+          , messages
+
+        large.fill(9)
+        receiver.bind(endpoint)
+        socket.connect(endpoint)
+
+        expect(socket.write([new Buffer('small'), large])).to.be.true
+        messages = receiver.read()
+
+        expect(messages).to.have.length(1)
+        expect(messages[0][0].toString()).to.equal('small')
+        expect(messages[0][1]).to.have.length(4096)
+        expect(messages[0][1][4095]).to.equal(9)
+      })
+
       it('should throw if the Socket is closed', function () {
         var socket = new Socket({
           type: zmqstream.Type.REQ
@@ -131,6 +273,61 @@ describe('ZMQStream', function () {
       })
     })
 
+    describe('writeMany', function () {
+      beforeEach(function () {
+        this.socket = new Socket()
+        this.receiver = new Socket()
+
+        this.endpoint = getInprocEndpoint()
+
+        this.receiver.bind(this.endpoint)
+        this.socket.connect(this.endpoint)
+      })
+
+      it('should be callable without error with 0 messages', function () {
+        expect(this.socket.writeMany([])).to.equal(0)
+      })
+
+      it('should send every message in order', function () {
+        var messages
+
+        expect(this.socket.writeMany([
+          [new Buffer('one'), new Buffer('two')],
+          [new Buffer('three')]
+        ])).to.equal(2)
+
+        messages = this.receiver.read()
+
+        expect(messages).to.have.length(2)
+        expect(messages[0]).to.have.length(2)
+        expect(messages[0][1].toString()).to.equal('two')
+        expect(messages[1]).to.have.length(1)
+        expect(messages[1][0].toString()).to.equal('three')
+      })
+
+      it('should stop when the socket cannot accept more', function () {
+        // Without any peers, a PUSH socket can never accept a message.
+        var socket = new Socket({ type: zmqstream.Type.PUSH })
+          , messages = []
+          , i
+
+        for (i = 0; i < 10; i++) {
+          messages.push([new Buffer('message')])
+        }
+
+        expect(socket.writeMany(messages)).to.equal(0)
+      })
+
+      it('should throw without sending anything if any frame is not a Buffer', function () {
+        var socket = this.socket
+
+        expect(function () {
+          socket.writeMany([[new Buffer('one')], ['two']])
+        }).to.throw('non-Buffer')
+        expect(this.receiver.read()).to.be.null
+      })
+    })
+
     describe('read', function () {
       beforeEach(function () {
         var self = this
@@ -215,6 +412,117 @@ describe('ZMQStream', function () {
         expect(messages[1][2].toString()).to.equal('five')
       })
 
+      it('should receive large frames without copying when zeroCopyReads is set', function () {
+        var socket = new Socket({ zeroCopyReads: 64 })
+          , sender = new Socket()
+          , endpoint = getInprocEndpoint()
+          , large = new Buffer(4096)
+          , messages
+
+        large.fill(7)
+        sender.bind(endpoint)
+        socket.connect(endpoint)
+
+        sender.write([new Buffer('small'), large])
+        messages = socket.read()
+
+        expect(messages).to.have.length(1)
+        expect(messages[0]).to.have.length(2)
+        expect(messages[0][0].toString()).to.equal('small')
+        expect(messages[0][1]).to.be.an.instanceof(Buffer)
+        expect(messages[0][1]).to.have.length(4096)
+        expect(messages[0][1][0]).to.equal(7)
+        expect(messages[0][1][4095]).to.equal(7)
+      })
+
+      it('should keep messages whole when a large frame is not the last', function () {
+        var socket = new Socket({ zeroCopyReads: 64 })
+          , sender = new Socket()
+          , endpoint = getInprocEndpoint()
+          , large = new Buffer(4096)
+          , messages
+
+        large.fill(7)
+        sender.bind(endpoint)
+        socket.connect(endpoint)
+
+        sender.write([large, new Buffer('small')])
+        sender.write([new Buffer('next')])
+        messages = socket.read()
+
+        expect(messages).to.have.length(2)
+        expect(messages[0]).to.have.length(2)
+        expect(messages[0][0]).to.have.length(4096)
+        expect(messages[0][1].toString()).to.equal('small')
+        expect(messages[1]).to.have.length(1)
+        expect(messages[1][0].toString()).to.equal('next')
+      })
+
+      it('should carve small frames from a pool when pooledReads is set', function () {
+        var socket = new Socket({ pooledReads: 256 })
+          , sender = new Socket()
+          , endpoint = getInprocEndpoint()
+          , messages
+          , stats
+
+        sender.bind(endpoint)
+        socket.connect(endpoint)
+
+        expect(socket.poolStats().liveFrames).to.equal(0)
+
+        sender.write([new Buffer('identity'), new Buffer(''), new Buffer('body')])
+        messages = socket.read()
+
+        expect(messages[0]).to.have.length(3)
+        expect(messages[0][0].toString()).to.equal('identity')
+        expect(messages[0][1]).to.have.length(0)
+        expect(messages[0][2].toString()).to.equal('body')
+
+        stats = socket.poolStats()
+        expect(stats.slabs).to.equal(1)
+        expect(stats.liveFrames).to.equal(3)
+        expect(stats.liveBytes).to.equal(12)
+      })
+
+      it('should not report pool stats without pooledReads', function () {
+        expect(this.socket.poolStats()).to.be.null
+      })
+
+      it('should stop once a budget is spent', function () {
+        this.sender.write([new Buffer('one')])
+        this.sender.write([new Buffer('two'), new Buffer('three')])
+        this.sender.write([new Buffer('four')])
+        this.sender.write([new Buffer('five')])
+
+        expect(this.socket.read({ maxMessages: 1 })).to.have.length(1)
+        // The message that crosses maxBytes is still returned whole.
+        expect(this.socket.read({ maxBytes: 4 })).to.have.length(1)
+        expect(this.socket.read({ maxMicros: 1000000 })).to.have.length(2)
+      })
+
+      it('should emit readable again for whatever a budget left behind', function (done) {
+        var self = this
+          , reads = []
+
+        self.socket.on('readable', function onReadable() {
+          var messages = self.socket.read({ maxMessages: 2 })
+
+          reads.push(messages ? messages.length : 0)
+
+          if (reads.length === 3) {
+            self.socket.removeListener('readable', onReadable)
+            expect(reads).to.deep.equal([2, 2, 1])
+            done()
+          }
+        })
+
+        expect(self.socket.read()).to.be.null
+
+        for (var i = 0; i < 5; i++) {
+          self.sender.write([new Buffer(String(i))])
+        }
+      })
+
       it('should throw if the Socket is closed', function () {
         var socket = new Socket({
           type: zmqstream.Type.REQ
@@ -228,6 +536,1283 @@ describe('ZMQStream', function () {
       })
     })
 
+    describe('readFlat', function () {
+      beforeEach(function () {
+        this.socket = new Socket()
+        this.sender = new Socket()
+
+        this.endpoint = getInprocEndpoint()
+
+        this.sender.bind(this.endpoint)
+        this.socket.connect(this.endpoint)
+      })
+
+      it('should return null if there is nothing to read', function () {
+        expect(this.socket.readFlat()).to.be.null
+      })
+
+      it('should pack multiple messages into one Buffer with an index', function () {
+        var batch
+
+        this.sender.write([new Buffer('one'), new Buffer('two')])
+        this.sender.write([new Buffer('three')])
+        batch = this.socket.readFlat()
+
+        expect(batch).to.exist
+        expect(batch.messages).to.equal(2)
+        expect(batch.data).to.be.an.instanceof(Buffer)
+        expect(batch.data.toString()).to.equal('onetwothree')
+        expect(Array.prototype.slice.call(batch.index)).to.deep.equal([2, 0, 3, 3, 3, 1, 6, 5])
+      })
+
+      it('should respect size', function () {
+        var batch
+
+        this.sender.write([new Buffer('one')])
+        this.sender.write([new Buffer('two')])
+        batch = this.socket.readFlat(1)
+
+        expect(batch.messages).to.equal(1)
+        expect(batch.data.toString()).to.equal('one')
+      })
+
+      it('should accept a budget', function () {
+        var batch
+
+        this.sender.write([new Buffer('one')])
+        this.sender.write([new Buffer('two')])
+        batch = this.socket.readFlat({ maxBytes: 1 })
+
+        expect(batch.messages).to.equal(1)
+        expect(batch.data.toString()).to.equal('one')
+      })
+    })
+
+    describe('ioThread', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+      })
+
+      it('should receive messages on a background thread', function (done) {
+        var socket = new Socket({ ioThread: true })
+          , sender = new Socket()
+
+        socket.bind(this.endpoint)
+        sender.connect(this.endpoint)
+
+        expect(socket.read()).to.be.null
+
+        socket.once('readable', function () {
+          var messages = socket.read()
+
+          expect(messages).to.have.length(1)
+          expect(messages[0]).to.have.length(2)
+          expect(messages[0][0].toString()).to.equal('one')
+          expect(messages[0][1].toString()).to.equal('two')
+
+          socket.close()
+          done()
+        })
+
+        sender.write([new Buffer('one'), new Buffer('two')])
+      })
+
+      it('should send messages from a background thread', function (done) {
+        var socket = new Socket({ ioThread: true })
+          , receiver = new Socket()
+
+        receiver.bind(this.endpoint)
+        socket.connect(this.endpoint)
+
+        expect(receiver.read()).to.be.null
+
+        receiver.once('readable', function () {
+          var messages = receiver.read()
+
+          expect(messages).to.have.length(1)
+          expect(messages[0][0].toString()).to.equal('one')
+
+          socket.close()
+          done()
+        })
+
+        expect(socket.write([new Buffer('one')])).to.be.true
+      })
+
+      it('should refuse messages with more frames than its queue holds', function () {
+        var socket = new Socket({ ioThread: true, ioRingSize: 2 })
+
+        expect(socket.write([new Buffer('one'), new Buffer('two'), new Buffer('three')])).to.be.false
+
+        socket.close()
+      })
+    })
+
+    describe('events', function () {
+      it('should emit readable for every socket with something to read', function (done) {
+        var count = 50
+          , remaining = count
+          , i
+
+        function makePair() {
+          var endpoint = getInprocEndpoint()
+            , receiver = new Socket()
+            , sender = new Socket()
+
+          receiver.bind(endpoint)
+          sender.connect(endpoint)
+
+          expect(receiver.read()).to.be.null
+
+          receiver.once('readable', function () {
+            expect(receiver.read()).to.have.length(1)
+
+            if (--remaining === 0) {
+              done()
+            }
+          })
+
+          return sender
+        }
+
+        for (i = 0; i < count; i++) {
+          makePair().write([new Buffer('message')])
+        }
+      })
+
+      it('should emit drain once a full socket has room again', function (done) {
+        var endpoint = getInprocEndpoint()
+          , sender = new Socket({ type: zmqstream.Type.PUSH, highWaterMark: 1 })
+          , receiver = new Socket({ type: zmqstream.Type.PULL, highWaterMark: 1 })
+
+        receiver.bind(endpoint)
+        sender.connect(endpoint)
+
+        while (sender.write([new Buffer('message')])) {}
+
+        sender.once('drain', function () {
+          done()
+        })
+
+        receiver.read()
+      })
+    })
+
+    describe('stats', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.receiver = new Socket()
+        this.sender = new Socket()
+
+        this.receiver.bind(this.endpoint)
+        this.sender.connect(this.endpoint)
+      })
+
+      it('should count messages and bytes in and out', function () {
+        this.sender.write([new Buffer('one'), new Buffer('two')])
+        this.sender.write([new Buffer('three')])
+        this.receiver.read()
+
+        var sent = this.sender.stats()
+          , received = this.receiver.stats()
+
+        expect(sent.messagesOut).to.equal(2)
+        expect(sent.bytesOut).to.equal(11)
+        expect(received.messagesIn).to.equal(2)
+        expect(received.bytesIn).to.equal(11)
+      })
+
+      it('should bucket read batches by log2 of their size', function () {
+        var i
+
+        for (i = 0; i < 5; i++) {
+          this.sender.write([new Buffer('message')])
+        }
+
+        this.receiver.read(1)
+        this.receiver.read()
+        this.receiver.read()
+
+        var stats = this.receiver.stats()
+
+        expect(stats.readBatches).to.have.length(32)
+        expect(stats.readBatches[0]).to.equal(1)
+        expect(stats.readBatches[2]).to.equal(1)
+        expect(stats.emptyReads).to.equal(1)
+      })
+
+      it('should count writes refused with EAGAIN', function () {
+        var socket = new Socket({ type: zmqstream.Type.PUSH, highWaterMark: 1 })
+
+        socket.bind(getInprocEndpoint())
+        socket.write([new Buffer('message')])
+
+        expect(socket.stats().writeEagains).to.equal(1)
+      })
+
+      it('should not check send-only sockets after successful writes', function (done) {
+        var push = new Socket({ type: zmqstream.Type.PUSH })
+          , pull = new Socket({ type: zmqstream.Type.PULL })
+          , endpoint = getInprocEndpoint()
+          , i
+
+        pull.bind(endpoint)
+        push.connect(endpoint)
+
+        for (i = 0; i < 10; i++) {
+          push.write([new Buffer('message')])
+        }
+
+        setTimeout(function () {
+          expect(push.stats().idleChecks).to.equal(0)
+          push.close()
+          pull.close()
+          done()
+        }, 10)
+      })
+
+      it('should not check again once a read has drained the queue', function (done) {
+        var self = this
+
+        self.receiver.once('readable', function () {
+          expect(self.receiver.read()).to.have.length(1)
+
+          var checks = self.receiver.stats().idleChecks
+
+          setTimeout(function () {
+            expect(self.receiver.stats().idleChecks).to.equal(checks)
+            done()
+          }, 10)
+        })
+
+        self.sender.write([new Buffer('message')])
+      })
+
+      it('should reset every counter', function () {
+        this.sender.write([new Buffer('message')])
+        this.sender.resetStats()
+
+        expect(this.sender.stats().messagesOut).to.equal(0)
+        expect(this.sender.stats().bytesOut).to.equal(0)
+      })
+    })
+
+    describe('proxy', function () {
+      beforeEach(function () {
+        var frontendEndpoint = getInprocEndpoint()
+          , backendEndpoint = getInprocEndpoint()
+
+        this.frontend = new Socket({ type: zmqstream.Type.PULL })
+        this.backend = new Socket({ type: zmqstream.Type.PUSH })
+        this.client = new Socket({ type: zmqstream.Type.PUSH })
+        this.worker = new Socket({ type: zmqstream.Type.PULL })
+
+        this.frontend.bind(frontendEndpoint)
+        this.backend.bind(backendEndpoint)
+        this.client.connect(frontendEndpoint)
+        this.worker.connect(backendEndpoint)
+
+        expect(this.worker.read()).to.be.null
+      })
+
+      it('should forward messages between sockets', function (done) {
+        var self = this
+          , proxy = zmqstream.proxy(self.frontend, self.backend)
+
+        self.worker.once('readable', function () {
+          var messages = self.worker.read()
+
+          expect(messages).to.have.length(1)
+          expect(String(messages[0][1])).to.equal('two')
+          expect(proxy.stats().frontend).to.deep.equal({ messages: 1, bytes: 6 })
+
+          proxy.terminate()
+          done()
+        })
+
+        self.client.write([new Buffer('one'), new Buffer('two')])
+      })
+
+      it('should copy messages to a capture socket', function (done) {
+        var endpoint = getInprocEndpoint()
+          , capture = new Socket({ type: zmqstream.Type.PUSH })
+          , listener = new Socket({ type: zmqstream.Type.PULL })
+          , proxy
+
+        capture.bind(endpoint)
+        listener.connect(endpoint)
+        expect(listener.read()).to.be.null
+
+        proxy = zmqstream.proxy(this.frontend, this.backend, { capture: capture })
+
+        listener.once('readable', function () {
+          expect(String(listener.read()[0][0])).to.equal('message')
+          proxy.terminate()
+          done()
+        })
+
+        this.client.write([new Buffer('message')])
+      })
+
+      it('should hold messages while paused', function (done) {
+        var self = this
+          , proxy = zmqstream.proxy(self.frontend, self.backend)
+
+        proxy.pause()
+        expect(proxy.stats().paused).to.be.true
+
+        self.client.write([new Buffer('message')])
+
+        setTimeout(function () {
+          expect(proxy.stats().frontend.messages).to.equal(0)
+
+          self.worker.once('readable', function () {
+            expect(self.worker.read()).to.have.length(1)
+            proxy.terminate()
+            done()
+          })
+
+          proxy.resume()
+        }, 50)
+      })
+
+      it('should lend sockets until terminated', function () {
+        var self = this
+          , proxy = zmqstream.proxy(self.frontend, self.backend)
+
+        expect(function () {
+          self.frontend.read()
+        }).to.throw('in use by a proxy')
+
+        expect(function () {
+          zmqstream.proxy(self.frontend, self.worker)
+        }).to.throw('already in use')
+
+        proxy.terminate()
+
+        expect(self.frontend.read()).to.be.null
+        expect(proxy.stats().running).to.be.false
+      })
+
+      it('should throw if not given sockets', function () {
+        var self = this
+
+        expect(function () {
+          zmqstream.proxy(self.frontend)
+        }).to.throw('frontend and backend')
+
+        expect(function () {
+          zmqstream.proxy(self.frontend, self.frontend)
+        }).to.throw('only be used once')
+      })
+
+      it('should refuse sockets with messages still pending', function () {
+        var self = this
+          , push = new Socket({ type: zmqstream.Type.PUSH, coalesce: true, coalesceMessages: 8 })
+
+        push.bind(getInprocEndpoint())
+        push.write([new Buffer('early')])
+
+        expect(function () {
+          zmqstream.proxy(self.frontend, push)
+        }).to.throw('pending')
+
+        // Nothing was lent, so both sockets are still usable.
+        expect(self.frontend.read()).to.be.null
+        push.close()
+      })
+    })
+
+    describe('forwardTo', function () {
+      beforeEach(function () {
+        var sourceEndpoint = getInprocEndpoint()
+
+        this.targetEndpoint = getInprocEndpoint()
+        this.source = new Socket({ type: zmqstream.Type.PULL })
+        this.target = new Socket({ type: zmqstream.Type.PUSH })
+        this.client = new Socket({ type: zmqstream.Type.PUSH })
+        this.worker = new Socket({ type: zmqstream.Type.PULL })
+
+        this.source.bind(sourceEndpoint)
+        this.target.bind(this.targetEndpoint)
+        this.client.connect(sourceEndpoint)
+      })
+
+      it('should forward messages to another socket', function (done) {
+        var self = this
+
+        self.worker.connect(self.targetEndpoint)
+        expect(self.worker.read()).to.be.null
+
+        self.source.forwardTo(self.target)
+
+        self.worker.once('readable', function () {
+          var messages = self.worker.read()
+
+          expect(messages).to.have.length(1)
+          expect(String(messages[0][1])).to.equal('two')
+          expect(self.source.stats().forwarded).to.equal(1)
+          done()
+        })
+
+        self.client.write([new Buffer('one'), new Buffer('two')])
+      })
+
+      it('should apply prefix and drop rules to the first frame', function (done) {
+        var self = this
+
+        self.worker.connect(self.targetEndpoint)
+        expect(self.worker.read()).to.be.null
+
+        self.source.forwardTo(self.target, { prefix: 'a:', drop: new Buffer('a:drop') })
+
+        self.worker.once('readable', function () {
+          var messages = self.worker.read()
+
+          expect(messages).to.have.length(1)
+          expect(String(messages[0][0])).to.equal('a:keep')
+          expect(self.source.stats().filtered).to.equal(2)
+          done()
+        })
+
+        self.client.write([new Buffer('b:other')])
+        self.client.write([new Buffer('a:drop')])
+        self.client.write([new Buffer('a:keep')])
+      })
+
+      it('should copy forwarded messages to a tee', function (done) {
+        var endpoint = getInprocEndpoint()
+          , tee = new Socket({ type: zmqstream.Type.PUSH })
+          , listener = new Socket({ type: zmqstream.Type.PULL })
+
+        tee.bind(endpoint)
+        listener.connect(endpoint)
+        this.worker.connect(this.targetEndpoint)
+        expect(listener.read()).to.be.null
+
+        this.source.forwardTo(this.target, { tee: tee })
+
+        listener.once('readable', function () {
+          expect(String(listener.read()[0][0])).to.equal('message')
+          done()
+        })
+
+        this.client.write([new Buffer('message')])
+      })
+
+      it('should stop reading while the target is full', function (done) {
+        var self = this
+
+        self.source.forwardTo(self.target)
+        self.client.write([new Buffer('message')])
+
+        // With no peers, the PUSH target has no room for anything.
+        setTimeout(function () {
+          expect(self.source.stats().forwarded).to.equal(0)
+
+          self.worker.connect(self.targetEndpoint)
+          expect(self.worker.read()).to.be.null
+
+          self.worker.once('readable', function () {
+            expect(self.worker.read()).to.have.length(1)
+            done()
+          })
+        }, 50)
+      })
+
+      it('should make messages readable again once stopped', function (done) {
+        var self = this
+
+        self.source.forwardTo(self.target)
+        self.source.forwardTo(null)
+        expect(self.source.read()).to.be.null
+
+        self.source.once('readable', function () {
+          expect(self.source.read()).to.have.length(1)
+          done()
+        })
+
+        self.client.write([new Buffer('message')])
+      })
+
+      it('should throw if given something other than a Socket', function () {
+        var self = this
+
+        expect(function () {
+          self.source.forwardTo({})
+        }).to.throw('No Socket')
+
+        expect(function () {
+          self.source.forwardTo(self.source)
+        }).to.throw('itself')
+      })
+
+      it('should refuse targets and tees that hold written messages back', function () {
+        var self = this
+          , codec = zmqstream.Compression.lz4 ? 'lz4' : zmqstream.Compression.zstd ? 'zstd' : null
+          , holding = [
+            { type: zmqstream.Type.PUSH, coalesce: true }
+            , { type: zmqstream.Type.PUSH, queueMessages: 3 }
+          ]
+
+        if (codec) {
+          holding.push({ type: zmqstream.Type.PUSH, compress: codec })
+        }
+
+        holding.forEach(function (options) {
+          var socket = new Socket(options)
+
+          expect(function () {
+            self.source.forwardTo(socket)
+          }).to.throw(TypeError)
+
+          expect(function () {
+            self.source.forwardTo(self.target, { tee: socket })
+          }).to.throw(TypeError)
+
+          socket.close()
+        })
+      })
+    })
+
+    describe('coalesce', function () {
+      beforeEach(function () {
+        var endpoint = getInprocEndpoint()
+
+        this.push = new Socket({ type: zmqstream.Type.PUSH, coalesce: true, coalesceMessages: 3 })
+        this.pull = new Socket({ type: zmqstream.Type.PULL, coalesce: true })
+
+        this.push.bind(endpoint)
+        this.pull.connect(endpoint)
+        expect(this.pull.read()).to.be.null
+      })
+
+      it('should deliver coalesced messages individually', function (done) {
+        var self = this
+
+        self.pull.once('readable', function () {
+          var messages = self.pull.read()
+
+          expect(messages).to.have.length(3)
+          expect(String(messages[0][0])).to.equal('one')
+          expect(messages[1]).to.have.length(2)
+          expect(String(messages[1][1])).to.equal('three')
+          expect(String(messages[2][0])).to.equal('four')
+          expect(self.pull.stats().messagesIn).to.equal(3)
+          done()
+        })
+
+        expect(self.push.write([new Buffer('one')])).to.be.true
+        expect(self.push.write([new Buffer('two'), new Buffer('three')])).to.be.true
+        expect(self.push.write([new Buffer('four')])).to.be.true
+      })
+
+      it('should flush a partial batch once its timer expires', function (done) {
+        var self = this
+
+        self.pull.once('readable', function () {
+          var messages = self.pull.read()
+
+          expect(messages).to.have.length(1)
+          expect(String(messages[0][0])).to.equal('alone')
+          done()
+        })
+
+        self.push.write([new Buffer('alone')])
+      })
+
+      it('should unpack batches in readFlat', function (done) {
+        var self = this
+
+        self.pull.once('readable', function () {
+          var batch = self.pull.readFlat()
+
+          expect(batch.messages).to.equal(3)
+          expect(batch.index).to.have.length(3 + 4 * 2)
+          expect(batch.data.toString()).to.equal('onetwothreefour')
+          done()
+        })
+
+        self.push.write([new Buffer('one')])
+        self.push.write([new Buffer('two'), new Buffer('three')])
+        self.push.write([new Buffer('four')])
+      })
+
+      it('should be rejected by socket types with envelopes', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.ROUTER, coalesce: true })
+        }).to.throw(TypeError)
+      })
+    })
+
+    describe('compress', function () {
+      var codec = zmqstream.Compression.lz4 ? 'lz4' : zmqstream.Compression.zstd ? 'zstd' : null
+        , describeCodec = codec ? describe : describe.skip
+
+      function repetitive(size) {
+        var json = JSON.stringify({ symbol: 'ACME', side: 'buy', price: 101.25 })
+          , text = ''
+
+        while (text.length < size) {
+          text += json
+        }
+
+        return new Buffer(text.slice(0, size))
+      }
+
+      it('should reject unknown codecs', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.PUSH, compress: 'gzip' })
+        }).to.throw(TypeError)
+      })
+
+      describeCodec('with a codec', function () {
+        beforeEach(function () {
+          var endpoint = getInprocEndpoint()
+
+          this.push = new Socket({ type: zmqstream.Type.PUSH, compress: codec, compressAsyncBytes: 32 * 1024 })
+          this.pull = new Socket({ type: zmqstream.Type.PULL, compress: codec })
+
+          this.push.bind(endpoint)
+          this.pull.connect(endpoint)
+          expect(this.pull.read()).to.be.null
+        })
+
+        it('should compress and decompress frames', function (done) {
+          var self = this
+            , frame = repetitive(4096)
+
+          self.pull.once('readable', function () {
+            var messages = self.pull.read()
+              , sent = self.push.stats()
+              , received = self.pull.stats()
+
+            expect(messages).to.have.length(1)
+            expect(String(messages[0][0])).to.equal('small')
+            expect(messages[0][1].toString()).to.equal(frame.toString())
+            expect(sent.compressedFrames).to.equal(1)
+            expect(sent.compressRatio).to.be.above(1)
+            expect(received.decompressedFrames).to.equal(1)
+            done()
+          })
+
+          self.push.write([new Buffer('small'), frame])
+        })
+
+        it('should keep messages in order around large frames compressed off the main thread', function (done) {
+          var self = this
+            , large = repetitive(64 * 1024)
+            , messages = []
+
+          self.pull.on('readable', function onReadable() {
+            var batch
+
+            while ((batch = self.pull.read())) {
+              messages = messages.concat(batch)
+            }
+
+            if (messages.length < 3) {
+              return
+            }
+
+            self.pull.removeListener('readable', onReadable)
+            expect(String(messages[0][0])).to.equal('first')
+            expect(messages[1][0].length).to.equal(large.length)
+            expect(String(messages[2][0])).to.equal('last')
+            expect(self.push.stats().compressOffloaded).to.equal(1)
+            done()
+          })
+
+          self.push.write([new Buffer('first')])
+          expect(self.push.write([large])).to.be.true
+          self.push.write([new Buffer('last')])
+        })
+
+        it('should read frames from peers that do not compress', function (done) {
+          var self = this
+            , endpoint = getInprocEndpoint()
+            , plain = new Socket({ type: zmqstream.Type.PUSH })
+            , frame = repetitive(4096)
+
+          plain.bind(endpoint)
+          self.pull.connect(endpoint)
+
+          self.pull.once('readable', function () {
+            var messages = self.pull.read()
+
+            expect(messages[0][0].toString()).to.equal(frame.toString())
+            expect(self.pull.stats().decompressedFrames).to.equal(0)
+            done()
+          })
+
+          plain.write([frame])
+        })
+
+        it('should leave frames claiming an impossible size as they are', function (done) {
+          var self = this
+            , endpoint = getInprocEndpoint()
+            , plain = new Socket({ type: zmqstream.Type.PUSH })
+            , frame = new Buffer([0xff, 0x5a, 0x43, codec === 'lz4' ? 1 : 2, 0xff, 0xff, 0xff, 0xff, 0])
+
+          plain.bind(endpoint)
+          self.pull.connect(endpoint)
+
+          self.pull.once('readable', function () {
+            var messages = self.pull.read()
+
+            expect(messages[0][0].toString('hex')).to.equal(frame.toString('hex'))
+            expect(self.pull.stats().decompressedFrames).to.equal(0)
+            done()
+          })
+
+          plain.write([frame])
+        })
+      })
+    })
+
+    describe('trackSubscriptions', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.pub = new Socket({ type: zmqstream.Type.XPUB, trackSubscriptions: true })
+        this.sub = new Socket({ type: zmqstream.Type.SUB })
+
+        this.pub.bind(this.endpoint)
+        this.sub.connect(this.endpoint)
+      })
+
+      it('should match topics against subscribed prefixes', function (done) {
+        var self = this
+
+        expect(self.pub.hasSubscribers()).to.be.false
+
+        self.pub.once('subscribe', function (topic) {
+          expect(String(topic)).to.equal('news.')
+          expect(self.pub.hasSubscribers()).to.be.true
+          expect(self.pub.hasSubscribers(new Buffer('news.sports'))).to.be.true
+          expect(self.pub.hasSubscribers('news.')).to.be.true
+          expect(self.pub.hasSubscribers(new Buffer('news'))).to.be.false
+          expect(self.pub.hasSubscribers(new Buffer('weather'))).to.be.false
+          done()
+        })
+
+        self.sub.set(zmqstream.Option.SUBSCRIBE, 'news.')
+      })
+
+      it('should emit unsubscribe once the last subscriber leaves', function (done) {
+        var self = this
+
+        self.pub.once('subscribe', function () {
+          self.pub.once('unsubscribe', function (topic) {
+            expect(String(topic)).to.equal('news.')
+            expect(self.pub.hasSubscribers(new Buffer('news.sports'))).to.be.false
+            done()
+          })
+
+          self.sub.set(zmqstream.Option.UNSUBSCRIBE, 'news.')
+        })
+
+        self.sub.set(zmqstream.Option.SUBSCRIBE, 'news.')
+      })
+
+      it('should refuse to be read from', function () {
+        var self = this
+
+        expect(function () {
+          self.pub.read()
+        }).to.throw('subscriptions')
+      })
+
+      it('should only be supported by XPUB sockets', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.PUB, trackSubscriptions: true })
+        }).to.throw(TypeError)
+
+        expect(function () {
+          new Socket({ type: zmqstream.Type.XPUB }).hasSubscribers()
+        }).to.throw(TypeError)
+      })
+    })
+
+    describe('internIdentities', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.router = new Socket({ type: zmqstream.Type.ROUTER, internIdentities: true })
+        this.dealer = new Socket({ type: zmqstream.Type.DEALER })
+        this.other = new Socket({ type: zmqstream.Type.DEALER })
+
+        this.router.bind(this.endpoint)
+        this.dealer.connect(this.endpoint)
+        this.other.connect(this.endpoint)
+      })
+
+      it('should read requests with a handle per peer', function (done) {
+        var self = this
+          , requests = []
+
+        self.router.on('readable', function onReadable() {
+          var batch = self.router.readRequests()
+
+          if (batch) {
+            requests = requests.concat(batch)
+          }
+
+          if (requests.length < 3) {
+            return
+          }
+
+          self.router.removeListener('readable', onReadable)
+
+          expect(String(requests[0].body[0])).to.equal('one')
+          expect(requests[0].peer).to.be.a('number')
+          expect(requests.filter(function (request) {
+            return request.peer === requests[0].peer
+          })).to.have.length(2)
+          expect(self.router.stats().peers).to.equal(2)
+          done()
+        })
+
+        self.dealer.write([new Buffer('one')])
+        self.other.write([new Buffer('two')])
+        self.dealer.write([new Buffer('three')])
+      })
+
+      it('should reply to the peer a handle was read from', function (done) {
+        var self = this
+
+        self.router.once('readable', function () {
+          var request = self.router.readRequests(1)[0]
+
+          expect(self.router.reply(request.peer, [new Buffer('pong')])).to.be.true
+        })
+
+        self.dealer.once('readable', function () {
+          expect(String(self.dealer.read()[0][0])).to.equal('pong')
+          done()
+        })
+
+        self.dealer.write([new Buffer('ping')])
+      })
+
+      it('should refuse to reply to forgotten peers', function (done) {
+        var self = this
+
+        self.router.once('readable', function () {
+          var request = self.router.readRequests(1)[0]
+
+          expect(self.router.forget(request.peer)).to.be.true
+          expect(self.router.forget(request.peer)).to.be.false
+          expect(function () {
+            self.router.reply(request.peer, [new Buffer('pong')])
+          }).to.throw(ReferenceError)
+          done()
+        })
+
+        self.dealer.write([new Buffer('ping')])
+      })
+
+      it('should only be supported by ROUTER sockets', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.DEALER, internIdentities: true })
+        }).to.throw(TypeError)
+
+        expect(function () {
+          new Socket({ type: zmqstream.Type.ROUTER }).readRequests()
+        }).to.throw(TypeError)
+      })
+    })
+
+    describe('trace', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.push = new Socket({ type: zmqstream.Type.PUSH, trace: true })
+        this.pull = new Socket({ type: zmqstream.Type.PULL, trace: true })
+
+        this.pull.bind(this.endpoint)
+        this.push.connect(this.endpoint)
+      })
+
+      it('should strip trace frames and record latencies', function (done) {
+        var self = this
+          , messages = []
+
+        self.pull.on('readable', function onReadable() {
+          messages = messages.concat(self.pull.read() || [])
+
+          if (messages.length < 3) {
+            return
+          }
+
+          self.pull.removeListener('readable', onReadable)
+
+          messages.forEach(function (message) {
+            expect(message).to.have.length(1)
+          })
+
+          var latency = self.pull.latency()
+
+          expect(latency.transit.count).to.equal(3)
+          expect(latency.transit.p99).to.be.at.least(latency.transit.p50)
+          expect(latency.transit.max).to.be.at.least(latency.transit.p99)
+          expect(latency.queued.count).to.be.at.least(1)
+          done()
+        })
+
+        self.push.write([new Buffer('one')])
+        self.push.write([new Buffer('two')])
+        self.push.write([new Buffer('three')])
+      })
+
+      it('should reset latencies when asked to', function (done) {
+        var self = this
+
+        self.pull.once('readable', function () {
+          self.pull.read()
+
+          expect(self.pull.latency(true).transit.count).to.equal(1)
+          expect(self.pull.latency().transit.count).to.equal(0)
+          done()
+        })
+
+        self.push.write([new Buffer('one')])
+      })
+
+      it('should send trace frames other sockets can see', function (done) {
+        var plain = new Socket({ type: zmqstream.Type.PULL })
+          , tracer = new Socket({ type: zmqstream.Type.PUSH, trace: true })
+          , endpoint = getInprocEndpoint()
+
+        plain.bind(endpoint)
+        tracer.connect(endpoint)
+
+        plain.once('readable', function () {
+          var message = plain.read()[0]
+
+          expect(message).to.have.length(2)
+          expect(message[1]).to.have.length(11)
+          plain.close()
+          tracer.close()
+          done()
+        })
+
+        tracer.write([new Buffer('one')])
+      })
+
+      it('should not be combined with coalesce', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.PUSH, trace: true, coalesce: true })
+        }).to.throw(TypeError)
+
+        expect(new Socket().latency()).to.be.null
+      })
+    })
+
+    describe('busyPollMicros', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.router = new Socket({ type: zmqstream.Type.ROUTER })
+        this.dealer = new Socket({ type: zmqstream.Type.DEALER, busyPollMicros: 1000 })
+
+        this.router.bind(this.endpoint)
+        this.dealer.connect(this.endpoint)
+      })
+
+      afterEach(function () {
+        this.router.close()
+        this.dealer.close()
+      })
+
+      it('should busy poll for replies after a write', function (done) {
+        var self = this
+
+        self.router.on('readable', function () {
+          var messages = self.router.read()
+
+          if (messages) {
+            self.router.write(messages[0])
+          }
+        })
+
+        self.dealer.once('readable', function () {
+          var stats = self.dealer.stats()
+
+          expect(String(self.dealer.read()[0][0])).to.equal('ping')
+          expect(stats.busyPolls).to.be.at.least(1)
+          expect(stats.busyPollHits).to.be.at.most(stats.busyPolls)
+          expect(stats.busyPollMicros).to.be.above(0)
+          done()
+        })
+
+        expect(self.dealer.read()).to.be.null
+        self.dealer.write([new Buffer('ping')])
+      })
+
+      it('should not be combined with ioThread', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.DEALER, busyPollMicros: 100, ioThread: true })
+        }).to.throw(TypeError)
+      })
+    })
+
+    describe('queueMessages', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.pull = new Socket({ type: zmqstream.Type.PULL })
+        this.push = new Socket({ type: zmqstream.Type.PUSH, queueMessages: 3 })
+      })
+
+      afterEach(function () {
+        this.pull.close()
+        this.push.close()
+      })
+
+      it('should queue writes with no room, returning false at the high-water mark', function () {
+        var stats
+
+        expect(this.push.write([new Buffer('one')])).to.be.true
+        expect(this.push.write([new Buffer('two')])).to.be.true
+        expect(this.push.write([new Buffer('three')])).to.be.false
+
+        stats = this.push.stats()
+        expect(stats.queuedMessages).to.equal(3)
+        expect(stats.outboundMessages).to.equal(3)
+        expect(stats.outboundBytes).to.equal(11)
+        expect(stats.messagesOut).to.equal(0)
+      })
+
+      it('should send queued messages in order, then drain', function (done) {
+        var self = this
+          , received = []
+
+        self.pull.on('readable', function () {
+          var messages = self.pull.read()
+
+          if (messages) {
+            received = received.concat(messages.map(function (message) {
+              return String(message[0])
+            }))
+          }
+
+          if (received.length === 3) {
+            expect(received).to.deep.equal(['one', 'two', 'three'])
+            done()
+          }
+        })
+
+        self.push.once('drain', function () {
+          expect(self.push.stats().outboundMessages).to.equal(0)
+          expect(self.push.stats().messagesOut).to.equal(3)
+        })
+
+        self.push.writeMany([[new Buffer('one')], [new Buffer('two')], [new Buffer('three')]])
+        self.pull.bind(self.endpoint)
+        self.push.connect(self.endpoint)
+      })
+
+      it('should return the number of messages accepted from writeMany', function (done) {
+        var self = this
+
+        self.push.once('drain', function () {
+          expect(self.push.stats().messagesOut).to.equal(3)
+          done()
+        })
+
+        expect(self.push.writeMany([[new Buffer('one')], [new Buffer('two')]])).to.equal(2)
+        expect(self.push.writeMany([[new Buffer('three')]])).to.equal(1)
+        expect(self.push.stats().outboundMessages).to.equal(3)
+
+        self.pull.bind(self.endpoint)
+        self.push.connect(self.endpoint)
+      })
+
+      it('should honor queueBytes', function () {
+        var push = new Socket({ type: zmqstream.Type.PUSH, queueBytes: 4 })
+
+        expect(push.write([new Buffer('one')])).to.be.true
+        expect(push.write([new Buffer('two')])).to.be.false
+        push.close()
+      })
+
+      it('should not be combined with coalesce or ioThread', function () {
+        expect(function () {
+          new Socket({ type: zmqstream.Type.PUSH, queueMessages: 3, coalesce: true })
+        }).to.throw(TypeError)
+
+        expect(function () {
+          new Socket({ type: zmqstream.Type.PUSH, queueBytes: 1024, ioThread: true })
+        }).to.throw(TypeError)
+      })
+    })
+
+    describe('readInto', function () {
+      beforeEach(function () {
+        this.endpoint = getInprocEndpoint()
+        this.receiver = new Socket()
+        this.sender = new Socket()
+
+        this.receiver.bind(this.endpoint)
+        this.sender.connect(this.endpoint)
+      })
+
+      afterEach(function () {
+        this.receiver.close()
+        this.sender.close()
+      })
+
+      it('should return null if there is nothing to read', function () {
+        expect(this.receiver.readInto(new Buffer(64), new Uint32Array(16))).to.be.null
+      })
+
+      it('should copy messages into the target, describing them in the index', function () {
+        var target = new Buffer(64)
+          , index = new Uint32Array(16)
+
+        this.sender.write([new Buffer('one'), new Buffer('two')])
+        this.sender.write([new Buffer('three')])
+
+        expect(this.receiver.readInto(target, index)).to.equal(2)
+        expect(Array.prototype.slice.call(index, 0, 8)).to.deep.equal([2, 0, 3, 3, 3, 1, 6, 5])
+        expect(target.toString('utf8', 0, 11)).to.equal('onetwothree')
+        expect(this.receiver.stats().messagesIn).to.equal(2)
+      })
+
+      it('should start at the offset given', function () {
+        var target = new Buffer(64)
+          , index = new Uint32Array(16)
+
+        this.sender.write([new Buffer('one')])
+
+        expect(this.receiver.readInto(target, index, 10)).to.equal(1)
+        expect(Array.prototype.slice.call(index, 0, 3)).to.deep.equal([1, 10, 3])
+        expect(target.toString('utf8', 10, 13)).to.equal('one')
+      })
+
+      it('should read into an ArrayBuffer', function () {
+        var target = new ArrayBuffer(16)
+          , index = new Uint32Array(4)
+
+        this.sender.write([new Buffer('one')])
+
+        expect(this.receiver.readInto(target, index)).to.equal(1)
+        expect(new Uint8Array(target)[0]).to.equal('o'.charCodeAt(0))
+      })
+
+      it('should stop at the first message that does not fit, keeping it for the next read', function () {
+        var target = new Buffer(8)
+          , index = new Uint32Array(16)
+          , messages
+
+        this.sender.write([new Buffer('hello')])
+        this.sender.write([new Buffer('world')])
+        this.sender.write([new Buffer('again')])
+
+        expect(this.receiver.readInto(target, index)).to.equal(1)
+        expect(target.toString('utf8', 0, 5)).to.equal('hello')
+
+        expect(this.receiver.readInto(target, index, 5)).to.equal(0)
+
+        expect(this.receiver.readInto(target, index)).to.equal(1)
+        expect(target.toString('utf8', 0, 5)).to.equal('world')
+
+        this.receiver.readInto(new Buffer(2), index)
+        messages = this.receiver.read()
+
+        expect(messages).to.have.length(1)
+        expect(String(messages[0][0])).to.equal('again')
+      })
+
+      it('should stop once the index is full', function () {
+        var index = new Uint32Array(3)
+
+        this.sender.write([new Buffer('one')])
+        this.sender.write([new Buffer('two')])
+
+        expect(this.receiver.readInto(new Buffer(64), index)).to.equal(1)
+        expect(this.receiver.readInto(new Buffer(64), index)).to.equal(1)
+        expect(this.receiver.readInto(new Buffer(64), index)).to.be.null
+      })
+
+      it('should reject an index that is not a Uint32Array', function () {
+        var receiver = this.receiver
+
+        expect(function () {
+          receiver.readInto(new Buffer(64), [])
+        }).to.throw(TypeError)
+
+        expect(function () {
+          receiver.readInto(new Buffer(64), new Uint32Array(4), 65)
+        }).to.throw(RangeError)
+      })
+    })
+
+    describe('monitor', function () {
+      beforeEach(function () {
+        this.endpoint = 'tcp://127.0.0.1:' + (20000 + Math.floor(Math.random() * 10000))
+        this.pull = new Socket({ type: zmqstream.Type.PULL })
+        this.push = new Socket({ type: zmqstream.Type.PUSH })
+      })
+
+      afterEach(function () {
+        this.pull.close()
+        this.push.close()
+      })
+
+      it('should emit listening and accepted with timestamps', function (done) {
+        var self = this
+          , monitor = self.pull.monitor()
+
+        monitor.once('listening', function (event) {
+          expect(event.event).to.equal('listening')
+          expect(event.endpoint).to.equal(self.endpoint)
+          expect(event.time).to.be.a('number')
+
+          monitor.once('accepted', function (accepted) {
+            expect(accepted.time).to.be.at.least(event.time)
+            monitor.close()
+            done()
+          })
+
+          self.push.connect(self.endpoint)
+        })
+
+        self.pull.bind(self.endpoint)
+      })
+
+      it('should emit every event as event too', function (done) {
+        var self = this
+          , monitor = self.push.monitor(zmqstream.Event.CONNECTED)
+
+        monitor.once('event', function (event) {
+          expect(event.event).to.equal('connected')
+          expect(event.endpoint).to.equal(self.endpoint)
+          monitor.close()
+          done()
+        })
+
+        self.pull.bind(self.endpoint)
+        self.push.connect(self.endpoint)
+      })
+
+      it('should refuse to be read from', function () {
+        var monitor = this.pull.monitor()
+
+        expect(function () {
+          monitor.read()
+        }).to.throw('monitor')
+
+        this.pull.monitor(false)
+      })
+
+      it('should throw if the socket is closed', function () {
+        var self = this
+
+        self.pull.close()
+
+        expect(function () {
+          self.pull.monitor()
+        }).to.throw(ReferenceError)
+      })
+    })
+
     describe('bind', function () {
       beforeEach(function () {
         this.socket = new Socket()